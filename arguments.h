@@ -0,0 +1,60 @@
+#ifndef ARGUMENTS_H
+#define ARGUMENTS_H
+
+//////////////////////////////////////////////////////////////////////////////
+// Numbers on the drivers' command lines. parse_number reads all of s as a
+// number of the type of out, and is false (leaving out alone) if s is
+// empty, has anything else in it, or is out of range, so the driver can
+// print its usage line instead of throwing out of std::stoi.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+
+namespace cfg {
+    inline bool parse_number(const char* s, long& out) {
+        char* end;
+        errno = 0;
+        long n = std::strtol(s, &end, 10);
+        if (end == s || *end || errno) { return false; }
+        out = n;
+        return true;
+    }
+
+    inline bool parse_number(const char* s, int& out) {
+        long n;
+        if (!parse_number(s, n) || n < INT_MIN || n > INT_MAX) { return false; }
+        out = n;
+        return true;
+    }
+
+    // strtoull takes "-1" as the biggest number there is, so no signs.
+    inline bool parse_number(const char* s, unsigned long long& out) {
+        if (*s == '-' || *s == '+') { return false; }
+        char* end;
+        errno = 0;
+        unsigned long long n = std::strtoull(s, &end, 10);
+        if (end == s || *end || errno) { return false; }
+        out = n;
+        return true;
+    }
+
+    inline bool parse_number(const char* s, unsigned long& out) {
+        unsigned long long n;
+        if (!parse_number(s, n) || n > ULONG_MAX) { return false; }
+        out = n;
+        return true;
+    }
+
+    inline bool parse_number(const char* s, double& out) {
+        char* end;
+        errno = 0;
+        double n = std::strtod(s, &end);
+        if (end == s || *end || errno) { return false; }
+        out = n;
+        return true;
+    }
+}
+
+#endif
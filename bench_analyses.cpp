@@ -0,0 +1,115 @@
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include "cfg.h"
+#include "measure.h"
+#include "arguments.h"
+#include "synthetic.h"
+#include "first.h"
+#include "reduce.h"
+#include "left_recursion.h"
+#include "ll1.h"
+#include "lr0.h"
+#include "lalr.h"
+#include "lr_table.h"
+#include "cyk.h"
+
+// Times each analysis and transformation on synthetic grammars (synthetic.h)
+// of growing size. Usage:
+//   ./bench_analyses [-n repeats] [-s step,step,...] [nonterminals...]
+// Steps are parse nullable min_yield reduce left_recursion first follow
+// predict ll1 lr0 lalr cnf, all by default. Each line is tab separated, for diffing between
+// builds:
+//   step nonterminals productions ms ns_per_production peak_rss_kb
+// ms is the best of the repeats. Every step runs in a process of its own,
+// so peak_rss_kb is what that step and the ones it needs got up to.
+
+using namespace std;
+using namespace cfg;
+
+const char* const all_steps = "parse,nullable,min_yield,reduce,left_recursion,first,follow,predict,ll1,lr0,lalr,cnf";
+
+// What a step's child sends back.
+struct step_result {
+    double productions, ms;
+};
+
+// Gets whatever step needs ready, then times it; < 0 if there's no such step.
+double time_step(const string& step, const grammar& g, int repeats) {
+    if (step == "parse") {
+        stringstream text;
+        text << g;
+        auto s = text.str();
+        return best_ms(repeats, [&]() { parse_grammar(s.data(), s.data() + s.size()); });
+    }
+    if (step == "nullable") { return best_ms(repeats, [&]() { compute_nullable(g); }); }
+    if (step == "min_yield") { return best_ms(repeats, [&]() { compute_min_yield(g); }); }
+    if (step == "reduce") { return best_ms(repeats, [&]() { reduce(g); }); }
+    if (step == "left_recursion") { return best_ms(repeats, [&]() { remove_left_recursion(g); }); }
+    if (step == "first") { return best_ms(repeats, [&]() { compute_first_sets(g); }); }
+    if (step == "cnf") { return best_ms(repeats, [&]() { cnf_grammar cnf(g); }); }
+
+    auto F = compute_first_sets(g);
+    if (step == "follow") { return best_ms(repeats, [&]() { compute_follow_sets(g, F); }); }
+    auto FOLLOW = compute_follow_sets(g, F);
+    if (step == "predict") { return best_ms(repeats, [&]() { compute_predict_sets(g, F, FOLLOW); }); }
+    if (step == "ll1") { return best_ms(repeats, [&]() { ll1_parser parser(g); }); }
+
+    auto Gprime = augment(g);
+    if (step == "lr0") { return best_ms(repeats, [&]() { lr0_automaton automaton(Gprime); }); }
+    lr0_automaton automaton(Gprime);
+    if (step == "lalr") { return best_ms(repeats, [&]() { build_lalr_table(g, automaton); }); }
+    return -1;
+}
+
+int main(int argc, char* argv[]) {
+    int repeats = 3;
+    string steps = all_steps;
+    int arg = 1;
+    auto usage = [&]() {
+        cerr << "usage: " << argv[0] << " [-n repeats] [-s step,step,...] [nonterminals...]" << endl;
+        return 2;
+    };
+    for (; arg + 1 < argc; arg += 2) {
+        string flag = argv[arg];
+        if (flag == "-n") {
+            if (!parse_number(argv[arg + 1], repeats)) { return usage(); }
+        }
+        else if (flag == "-s") { steps = argv[arg + 1]; }
+        else { break; }
+    }
+    vector<int> sizes;
+    for (; arg < argc; ++arg) {
+        int size;
+        if (!parse_number(argv[arg], size)) { return usage(); }
+        sizes.push_back(size);
+    }
+    if (sizes.empty()) { sizes = {500, 1000, 2000, 4000}; }
+
+    cout << "step\tnonterminals\tproductions\tms\tns_per_production\tpeak_rss_kb" << endl;
+    stringstream step_list(steps);
+    string step;
+    while (getline(step_list, step, ',')) {
+        for (auto size : sizes) {
+            synthetic_options options;
+            options.nonterminals = size;
+            step_result result;
+            long peak_rss_kb = 0;
+            bool ok = in_child([&]() {
+                auto g = synthetic_grammar(options);
+                return step_result{double(g.size()), time_step(step, g, repeats)};
+            }, result, peak_rss_kb);
+            if (!ok) {
+                cerr << step << " failed at " << size << " nonterminals" << endl;
+                return 1;
+            }
+            if (result.ms < 0) {
+                cerr << "no step called " << step << "; there's " << all_steps << endl;
+                return 2;
+            }
+            cout << step << "\t" << size << "\t" << result.productions << "\t" << result.ms << "\t"
+                 << result.ms * 1e6 / result.productions << "\t" << peak_rss_kb << endl;
+        }
+    }
+}
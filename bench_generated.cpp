@@ -0,0 +1,86 @@
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "cfg.h"
+#include "mapped_file.h"
+#include "arguments.h"
+#include "first.h"
+#include "ll1.h"
+#include "lr0.h"
+#include "lalr.h"
+#include "lr_table.h"
+#include "lr_parser.h"
+#include "generated/calc_rd.h"
+#include "generated/calc_lr.h"
+
+// Recognizes the tokens on stdin repeatedly with the table-driven LL(1) and
+// LALR(1) parsers and with the ones parsergen wrote for the calc grammar,
+// and reports the throughput of each.
+// Usage: ./bench_generated [-b repeats] inputs/calc.cfg < tokens
+// The grammar has to be the one the parsers were generated from.
+
+using namespace std;
+using namespace cfg;
+
+int main(int argc, char* argv[]) {
+    long repeats = 100000;
+    int arg = 1;
+    if (argc == 4 && string(argv[1]) == "-b" && parse_number(argv[2], repeats)) {
+        arg = 3;
+    }
+    if (arg != argc - 1) {
+        cerr << "usage: " << argv[0] << " [-b repeats] grammar.cfg < tokens" << endl;
+        return 2;
+    }
+    mapped_file file(argv[arg]);
+    if (!file) {
+        cerr << "can't open " << argv[arg] << endl;
+        return 2;
+    }
+    auto G = parse_grammar(file.begin(), file.end());
+    bool same = G.size() == calc_lr::production_count && G.terminal_count() == calc_lr::terminal_count;
+    for (int t = 0; same && t < G.terminal_count(); ++t) {
+        same = G.name_of(G.nonterminal_count() + t) == calc_lr::terminal_names[t];
+    }
+    if (!same) {
+        cerr << argv[arg] << " isn't the grammar the parsers were generated from" << endl;
+        return 2;
+    }
+
+    grammar_analysis A(G);
+    ll1_parser ll1(A);
+    auto Gprime = augment(G);
+    lr0_automaton automaton(Gprime);
+    lr_parser lr(build_lalr_table(G, automaton));
+
+    vector<symbol_id> tokens;
+    string bad;
+    if (!read_tokens(G, cin, tokens, &bad)) {
+        cerr << "unknown token " << bad << endl;
+        return 1;
+    }
+    span<symbol_id> input{tokens.data(), tokens.data() + tokens.size()};
+    vector<int> indices;
+    for (auto x : tokens) {
+        indices.push_back(G.terminal_index(x));
+    }
+
+    bool all_accepted = true;
+    auto bench = [&](const char* what, auto recognize) {
+        auto start = chrono::steady_clock::now();
+        long accepted = 0;
+        for (long r = 0; r < repeats; ++r) {
+            accepted += recognize();
+        }
+        chrono::duration<double> took = chrono::steady_clock::now() - start;
+        cout << what << ": " << accepted << "/" << repeats << " accepted, "
+             << tokens.size() * repeats / took.count() / 1e6 << " million tokens/s" << endl;
+        all_accepted = all_accepted && accepted == repeats;
+    };
+    bench("LL(1) table", [&]() { return ll1.recognize(input); });
+    bench("recursive descent", [&]() { return calc_rd::recognize(indices.data(), indices.size()); });
+    bench("LALR(1) table", [&]() { return lr.recognize(input); });
+    bench("direct-coded LALR(1)", [&]() { return calc_lr::recognize(indices.data(), indices.size()); });
+    return all_accepted ? 0 : 1;
+}
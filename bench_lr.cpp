@@ -0,0 +1,66 @@
+#include <string>
+#include <iostream>
+#include "cfg.h"
+#include "mapped_file.h"
+#include "arguments.h"
+#include "measure.h"
+#include "lr0.h"
+#include "lr1.h"
+#include "lalr.h"
+#include "lr_table.h"
+
+// Compares LALR(1) against Pager's LR(1) on each grammar file given:
+// state counts, conflicts and build times. Usage:
+//   ./bench_lr [-n repeats] grammar.cfg...
+// Each line is tab separated, so it's easy to feed to other tools:
+//   grammar productions lalr_states lalr_conflicts lalr_ms lr1_states lr1_conflicts lr1_ms
+
+using namespace std;
+using namespace cfg;
+
+int main(int argc, char* argv[]) {
+    int repeats = 5;
+    int first = 1;
+    if (argc > 2 && string(argv[1]) == "-n") {
+        if (!parse_number(argv[2], repeats)) {
+            cerr << "usage: " << argv[0] << " [-n repeats] grammar.cfg..." << endl;
+            return 2;
+        }
+        first = 3;
+    }
+
+    cout << "grammar\tproductions\tlalr_states\tlalr_conflicts\tlalr_ms"
+         << "\tlr1_states\tlr1_conflicts\tlr1_ms" << endl;
+    for (int i = first; i < argc; ++i) {
+        mapped_file file(argv[i]);
+        if (!file) {
+            cerr << "can't open " << argv[i] << endl;
+            return 1;
+        }
+        auto G = parse_grammar(file.begin(), file.end());
+        if (G.size() == 0) {
+            cerr << argv[i] << ": empty grammar" << endl;
+            return 1;
+        }
+        auto Gprime = augment(G);
+
+        int lalr_states = 0, lalr_conflicts = 0;
+        double lalr_ms = best_ms(repeats, [&]() {
+            lr0_automaton automaton(Gprime);
+            auto table = build_lalr_table(G, automaton);
+            lalr_states = table.state_count();
+            lalr_conflicts = table.conflicts().size();
+        });
+        int lr1_states = 0, lr1_conflicts = 0;
+        double lr1_ms = best_ms(repeats, [&]() {
+            lr1_automaton automaton(Gprime);
+            auto table = build_lr1_table(G, automaton);
+            lr1_states = table.state_count();
+            lr1_conflicts = table.conflicts().size();
+        });
+
+        cout << argv[i] << "\t" << G.size()
+             << "\t" << lalr_states << "\t" << lalr_conflicts << "\t" << lalr_ms
+             << "\t" << lr1_states << "\t" << lr1_conflicts << "\t" << lr1_ms << endl;
+    }
+}
@@ -0,0 +1,145 @@
+#ifndef BIGINT_H
+#define BIGINT_H
+
+//////////////////////////////////////////////////////////////////////////////
+// Just enough arbitrary precision arithmetic for counting derivations:
+// unsigned integers of any size, with +, -, * and comparisons, printing in
+// decimal, and picking one uniformly at random below a bound.
+//
+// The number is a little endian vector of 32 bit limbs with no leading
+// zeros (so zero has none), and the arithmetic is the schoolbook kind,
+// carrying in 64 bits. Counting adds up a lot of products, many of them
+// zero, so add_product does that without making a temporary.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <iostream>
+#include <algorithm>
+
+namespace cfg {
+    class bigint {
+        std::vector<std::uint32_t> limbs;
+
+        void trim() {
+            while (limbs.size() && limbs.back() == 0) { limbs.pop_back(); }
+        }
+
+        public:
+        bigint(std::uint64_t v = 0) {
+            for (; v; v >>= 32) { limbs.push_back(std::uint32_t(v)); }
+        }
+
+        bool is_zero() const { return limbs.empty(); }
+        int bit_length() const {
+            if (limbs.empty()) { return 0; }
+            return 32 * (limbs.size() - 1) + (32 - __builtin_clz(limbs.back()));
+        }
+
+        bigint& operator+=(const bigint& b) {
+            if (limbs.size() < b.limbs.size()) { limbs.resize(b.limbs.size(), 0); }
+            std::uint64_t carry = 0;
+            for (size_t i = 0; i < limbs.size() && (carry || i < b.limbs.size()); ++i) {
+                carry += std::uint64_t(limbs[i]) + (i < b.limbs.size() ? b.limbs[i] : 0);
+                limbs[i] = std::uint32_t(carry);
+                carry >>= 32;
+            }
+            if (carry) { limbs.push_back(std::uint32_t(carry)); }
+            return *this;
+        }
+
+        // Only for b <= *this.
+        bigint& operator-=(const bigint& b) {
+            assert(!(*this < b));
+            std::int64_t borrow = 0;
+            for (size_t i = 0; i < limbs.size() && (borrow || i < b.limbs.size()); ++i) {
+                std::int64_t d = std::int64_t(limbs[i]) - (i < b.limbs.size() ? b.limbs[i] : 0) - borrow;
+                borrow = d < 0;
+                limbs[i] = std::uint32_t(d + (borrow << 32));
+            }
+            trim();
+            return *this;
+        }
+
+        // *this += a * b
+        bigint& add_product(const bigint& a, const bigint& b) {
+            if (a.is_zero() || b.is_zero()) { return *this; }
+            size_t n = a.limbs.size() + b.limbs.size();
+            if (limbs.size() < n) { limbs.resize(n, 0); }
+            for (size_t i = 0; i < a.limbs.size(); ++i) {
+                std::uint64_t carry = 0;
+                size_t j = 0;
+                for (; j < b.limbs.size(); ++j) {
+                    carry += std::uint64_t(a.limbs[i]) * b.limbs[j] + limbs[i+j];
+                    limbs[i+j] = std::uint32_t(carry);
+                    carry >>= 32;
+                }
+                for (size_t k = i + j; carry; ++k) {
+                    if (k == limbs.size()) { limbs.push_back(0); }
+                    carry += limbs[k];
+                    limbs[k] = std::uint32_t(carry);
+                    carry >>= 32;
+                }
+            }
+            trim();
+            return *this;
+        }
+
+        friend bigint operator+(bigint a, const bigint& b) { return a += b; }
+        friend bigint operator-(bigint a, const bigint& b) { return a -= b; }
+        friend bigint operator*(const bigint& a, const bigint& b) { return bigint().add_product(a, b); }
+
+        friend bool operator==(const bigint& a, const bigint& b) { return a.limbs == b.limbs; }
+        friend bool operator!=(const bigint& a, const bigint& b) { return !(a == b); }
+        friend bool operator<(const bigint& a, const bigint& b) {
+            if (a.limbs.size() != b.limbs.size()) { return a.limbs.size() < b.limbs.size(); }
+            return std::lexicographical_compare(a.limbs.rbegin(), a.limbs.rend(), b.limbs.rbegin(), b.limbs.rend());
+        }
+
+        // In decimal, nine digits at a time.
+        std::string to_string() const {
+            if (is_zero()) { return "0"; }
+            std::vector<std::uint32_t> n(limbs.rbegin(), limbs.rend());
+            std::vector<std::uint32_t> chunks;
+            while (n.size()) {
+                std::uint64_t rest = 0;
+                for (auto& d : n) {
+                    rest = rest << 32 | d;
+                    d = std::uint32_t(rest / 1000000000);
+                    rest %= 1000000000;
+                }
+                chunks.push_back(rest);
+                n.erase(n.begin(), std::find_if(n.begin(), n.end(), [](std::uint32_t d) { return d != 0; }));
+            }
+            std::string s = std::to_string(chunks.back());
+            for (auto it = std::next(chunks.rbegin()); it != chunks.rend(); ++it) {
+                std::string digits = std::to_string(*it);
+                s += std::string(9 - digits.size(), '0') + digits;
+            }
+            return s;
+        }
+
+        // Uniform in [0, bound), bound > 0: random bits of the right
+        // length until one is small enough, which takes two tries on
+        // average at worst.
+        template <typename RNG>
+        static bigint random_below(const bigint& bound, RNG& rng) {
+            assert(!bound.is_zero());
+            int bits = bound.bit_length();
+            bigint r;
+            do {
+                r.limbs.assign((bits + 31) / 32, 0);
+                for (auto& l : r.limbs) { l = std::uint32_t(rng()); }
+                if (bits % 32) { r.limbs.back() &= (std::uint32_t(1) << (bits % 32)) - 1; }
+                r.trim();
+            } while (!(r < bound));
+            return r;
+        }
+    };
+
+    inline std::ostream& operator<<(std::ostream& o, const bigint& n) { return o << n.to_string(); }
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef BITSET_H
+#define BITSET_H
+
+//////////////////////////////////////////////////////////////////////////////
+// Dense bitsets for the set-heavy analyses (FIRST, FOLLOW, lookaheads...).
+//
+// A bit_matrix is a stack of fixed-width bitsets, one per row, stored back
+// to back in a single array. For FIRST/FOLLOW a row is a symbol and a column
+// is a terminal index. Keeping every row the same width means unions and
+// "did anything change?" checks are straight-line loops over whole words,
+// which we do two words at a time with SSE2 where it's available.
+//
+// The free functions in cfg::bits work on raw word arrays, so callers can
+// keep scratch rows (like the FOLLOW "trailer") outside of any matrix.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+#include <vector>
+#include <cassert>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace cfg {
+    namespace bits {
+        typedef std::uint64_t word;
+        const int word_bits = 64;
+
+        inline int words_for(int width) { return (width + word_bits - 1) / word_bits; }
+
+        // d |= s over n words, returning whether d changed.
+        inline bool or_words(word* d, const word* s, int n) {
+            int k = 0;
+            word changed = 0;
+#if defined(__SSE2__)
+            __m128i diff = _mm_setzero_si128();
+            for (; k + 2 <= n; k += 2) {
+                __m128i dv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d + k));
+                __m128i sv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + k));
+                __m128i nv = _mm_or_si128(dv, sv);
+                diff = _mm_or_si128(diff, _mm_xor_si128(nv, dv));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(d + k), nv);
+            }
+            changed = _mm_movemask_epi8(_mm_cmpeq_epi8(diff, _mm_setzero_si128())) != 0xFFFF;
+#endif
+            for (; k < n; ++k) {
+                word nw = d[k] | s[k];
+                changed |= nw ^ d[k];
+                d[k] = nw;
+            }
+            return changed != 0;
+        }
+
+        // Does d & s have any bit set?
+        inline bool intersects(const word* d, const word* s, int n) {
+            for (int k = 0; k < n; ++k) {
+                if (d[k] & s[k]) { return true; }
+            }
+            return false;
+        }
+
+        inline bool test(const word* d, int b) { return (d[b / word_bits] >> (b % word_bits)) & 1; }
+        // Returns whether the bit was newly set.
+        inline bool set(word* d, int b) {
+            word mask = word(1) << (b % word_bits);
+            bool was = d[b / word_bits] & mask;
+            d[b / word_bits] |= mask;
+            return !was;
+        }
+
+        // Call f(i) for every bit i set in d, in increasing order.
+        template <typename F>
+        void for_each(const word* d, int n, F f) {
+            for (int k = 0; k < n; ++k) {
+                for (word w = d[k]; w; w &= w - 1) {
+                    f(k * word_bits + __builtin_ctzll(w));
+                }
+            }
+        }
+
+        inline int count(const word* d, int n) {
+            int c = 0;
+            for (int k = 0; k < n; ++k) { c += __builtin_popcountll(d[k]); }
+            return c;
+        }
+    }
+
+    class bit_matrix {
+        int rows_ = 0;
+        int width_ = 0;
+        int words_ = 0;
+        std::vector<bits::word> data;
+        public:
+        bit_matrix() {}
+        bit_matrix(int rows, int width):
+            rows_(rows), width_(width), words_(bits::words_for(width)),
+            data(size_t(rows) * words_, 0) {}
+
+        int rows() const { return rows_; }
+        int width() const { return width_; }
+        int words_per_row() const { return words_; }
+
+        bits::word* row(int r) { return data.data() + size_t(r) * words_; }
+        const bits::word* row(int r) const { return data.data() + size_t(r) * words_; }
+
+        bool test(int r, int b) const { assert(b < width_); return bits::test(row(r), b); }
+        bool set(int r, int b) { assert(b < width_); return bits::set(row(r), b); }
+
+        // row r |= from's row s, which must be the same width.
+        // Returns whether row r changed.
+        bool or_row(int r, const bit_matrix& from, int s) {
+            assert(from.words_ == words_);
+            return bits::or_words(row(r), from.row(s), words_);
+        }
+        bool or_row(int r, int s) { return or_row(r, *this, s); }
+        bool or_into(int r, const bits::word* s) { return bits::or_words(row(r), s, words_); }
+
+        bool intersects(int r, const bit_matrix& other, int s) const {
+            return bits::intersects(row(r), other.row(s), words_);
+        }
+        int count(int r) const { return bits::count(row(r), words_); }
+
+        template <typename F>
+        void for_each(int r, F f) const { bits::for_each(row(r), words_, f); }
+
+        bool operator==(const bit_matrix& m) const {
+            return rows_ == m.rows_ && width_ == m.width_ && data == m.data;
+        }
+        bool operator!=(const bit_matrix& m) const { return !(*this == m); }
+    };
+}
+
+#endif
@@ -9,86 +9,263 @@
 #include <iterator>
 #include <algorithm>
 #include <set>
+#include <cstring>
+#include <cstdint>
+
+#include "stats.h"
 
 using namespace std;
 
-// This is a non-exposed helper function.
-template<class S>
-vector<S> tokenize(S s) {
-    stringstream strstr(s);
-    // use stream iterators to copy the stream to the vector as whitespace separated strings
-    istream_iterator<S> it(strstr);
-    return vector<S>(it, istream_iterator<S>());
+// These are non-exposed helpers for parse_grammar.
+namespace {
+    // Whitespace as isspace has it, newlines included.
+    inline bool is_space(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+    inline uint64_t load_word(const char* s, size_t n) {
+        uint64_t w = 0;
+        memcpy(&w, s, n);
+        return w;
+    }
+    // Whether any byte of w is below '!', as all whitespace is. That lets
+    // us skip over the inside of a symbol eight bytes at a time.
+    inline bool any_below_bang(uint64_t w) {
+        return (w - 0x2121212121212121ull) & ~w & 0x8080808080808080ull;
+    }
+
+    // The low bits of a hash pick the slot, so mix the high ones down.
+    inline uint64_t finish_hash(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        return h ^ (h >> 33);
+    }
+
+    // A word at a time too.
+    size_t hash_bytes(const char* s, size_t n) {
+        uint64_t h = n * 0x9e3779b97f4a7c15ull;
+        for (; n >= 8; s += 8, n -= 8) {
+            h = (h ^ load_word(s, 8)) * 0xff51afd7ed558ccdull;
+            h ^= h >> 32;
+        }
+        if (n) {
+            h = (h ^ load_word(s, n)) * 0xff51afd7ed558ccdull;
+        }
+        return finish_hash(h);
+    }
+
+    // Open addressing from the symbols' text to IDs in order of first
+    // appearance. Each slot has some bits of the hash along with the ID, and
+    // the text of each symbol gets copied next to the others', so a lookup
+    // touches two places that are probably in cache instead of going back
+    // to wherever the symbol first was in the input.
+    class symbol_table {
+        struct slot {
+            uint32_t tag;
+            uint32_t id;  // ID + 1, or 0 if empty
+        };
+        vector<slot> slots;
+        vector<uint32_t> tags;
+
+        void grow() {
+            slots.assign(slots.size() * 2, slot{0, 0});
+            size_t mask = slots.size() - 1;
+            for (uint32_t id = 0; id < tags.size(); ++id) {
+                size_t i = hashes[id] & mask;
+                while (slots[i].id) { i = (i + 1) & mask; }
+                slots[i] = {tags[id], id + 1};
+            }
+        }
+        vector<size_t> hashes;
+
+        public:
+        string text;
+        vector<uint32_t> starts;  // into text, with one more on the end
+
+        symbol_table(): slots(1024, slot{0, 0}), starts(1, 0) {}
+        size_t size() const { return tags.size(); }
+
+        uint32_t intern(const char* s, size_t n) {
+            size_t h = hash_bytes(s, n);
+            uint32_t tag = h >> 32;
+            size_t mask = slots.size() - 1;
+            for (size_t i = h & mask; ; i = (i + 1) & mask) {
+                slot here = slots[i];
+                if (here.id == 0) {
+                    uint32_t id = tags.size();
+                    slots[i] = {tag, id + 1};
+                    tags.push_back(tag);
+                    hashes.push_back(h);
+                    text.append(s, n);
+                    starts.push_back(text.size());
+                    if (2 * tags.size() > slots.size()) { grow(); }
+                    return id;
+                }
+                uint32_t id = here.id - 1;
+                if (here.tag == tag && starts[id+1] - starts[id] == n && memcmp(&text[starts[id]], s, n) == 0) {
+                    return id;
+                }
+            }
+        }
+    };
+
+    size_t hash_ids(cfg::symbol_id lhs, const cfg::symbol_id* first, const cfg::symbol_id* last) {
+        // Multiplying the LHS in first, or A -> B and C -> D collide
+        // whenever A ^ B == C ^ D, as chains of unit productions keep doing.
+        size_t h = lhs * 0xff51afd7ed558ccdull;
+        for (; first != last; ++first) { h = (h ^ *first) * 0x9e3779b97f4a7c15ull; }
+        return finish_hash(h);
+    }
 }
 
 // Here are the implementations of the exposed methods.
 namespace cfg {
-    production grammar::operator[](const int i) const {
-        auto finder = prods.begin();
-        advance(finder, i);
-        return *finder;
-    }
     int grammar::index_of(const production& p) const {
-        int i = 0;
-        for (auto&& q : prods) {
-            if (q == p) { return i; }
-            ++i;
+        auto A = id_of(p.lhs);
+        if (A == no_symbol) { return -1; }
+        vector<symbol_id> rhs;
+        for (auto&& s : p.rhs) {
+            rhs.push_back(id_of(s));
+            if (rhs.back() == no_symbol) { return -1; }
+        }
+        return indices[find_slot(A, rhs.data(), rhs.data() + rhs.size())] - 1;
+    }
+
+    size_t grammar::find_slot(symbol_id lhs, const symbol_id* first, const symbol_id* last) const {
+        size_t mask = indices.size() - 1;
+        for (size_t i = hash_ids(lhs, first, last) & mask; ; i = (i + 1) & mask) {
+            int p = indices[i] - 1;
+            if (p < 0) { return i; }
+            auto rhs = rhs_ids(p);
+            if (lhs_ids[p] == lhs && equal(rhs.begin(), rhs.end(), first, last)) { return i; }
         }
-        return -1;
+    }
+
+    size_t production_hash::operator()(const production& p) const {
+        std::hash<symbol> h;
+        size_t ret = h(p.lhs);
+        for (auto&& s : p.rhs) {
+            ret = ret * 31 + h(s);
+        }
+        return ret;
     }
 
     // This exploits the fact that productions are ordered.
     // The start symbol is always just the first nonterminal
-    // we see.
+    // we see, so there has to be one.
     symbol grammar::start_symbol() const {
+        assert(!prods.empty());
         return prods.begin()->lhs;
     }
 
-    // Essentially we filter over the productions of the grammar.
-    sequence<production> grammar::productions_from_nonterminal(const symbol lhs) const {
+    production_view grammar::productions_from_nonterminal(const symbol& lhs) const {
         assert(is_nonterminal(lhs));
-        sequence<production> ret_val = {};
-
-        copy_if(prods.begin(), prods.end(), back_inserter(ret_val),
-                [&](const production& p) { return p.lhs == lhs; });
-
-        return ret_val;
+        return {production_indices(id_of(lhs)), prods.data()};
     }
 
+    // Symbols that don't appear in the grammar at all are considered
+    // terminals, as they never appear as a LHS.
     bool grammar::is_nonterminal(const symbol& s) const {
-        return any_of(prods.begin(), prods.end(),
-                [&](const production &p) { return p.lhs == s; });
+        auto i = id_of(s);
+        return i != no_symbol && is_nonterminal(i);
     }
     bool grammar::is_terminal(const symbol& s) const {
         return !is_nonterminal(s);
     }
 
+    symbol_id grammar::id_of(const symbol& s) const {
+        auto it = ids.find(s);
+        if (it == ids.end()) { return no_symbol; }
+        return it->second;
+    }
+
+    // Assign the dense IDs. Two passes: all the LHS first, so that
+    // nonterminals occupy a prefix of the ID space, then whatever's left
+    // over in the RHS are the terminals.
+    void grammar::intern() {
+        auto add = [&](const symbol& s) {
+            if (ids.emplace(s, names.size()).second) { names.push_back(s); }
+        };
+        for (auto&& p : prods) { add(p.lhs); }
+        nonterminals = names.size();
+        for (auto&& p : prods) {
+            for (auto&& s : p.rhs) { add(s); }
+        }
+
+        lhs_ids.reserve(prods.size());
+        rhs_offsets.reserve(prods.size() + 1);
+        rhs_offsets.push_back(0);
+        for (auto&& p : prods) {
+            lhs_ids.push_back(ids[p.lhs]);
+            for (auto&& s : p.rhs) { rhs_symbols.push_back(ids[s]); }
+            rhs_offsets.push_back(rhs_symbols.size());
+        }
+        index();
+    }
+
+    void grammar::index() {
+        nonterminal_bits.assign(names.size(), false);
+        terminal_bits.assign(names.size(), true);
+        for (int i = 0; i < nonterminals; ++i) {
+            nonterminal_bits[i] = true;
+            terminal_bits[i] = false;
+        }
+
+        // A counting sort of the production indices by LHS.
+        lhs_offsets.assign(nonterminals + 1, 0);
+        for (auto A : lhs_ids) { ++lhs_offsets[A+1]; }
+        for (int A = 0; A < nonterminals; ++A) { lhs_offsets[A+1] += lhs_offsets[A]; }
+        by_lhs.resize(prods.size());
+        auto fill = lhs_offsets;
+        for (int i = 0; i < size(); ++i) { by_lhs[fill[lhs_ids[i]]++] = i; }
+
+        // Duplicate productions map to their first index, so they don't
+        // go in at all.
+        size_t slots = 16;
+        while (slots < 2 * prods.size()) { slots *= 2; }
+        indices.assign(slots, 0);
+        for (int i = 0; i < size(); ++i) {
+            auto rhs = rhs_ids(i);
+            auto slot = find_slot(lhs_ids[i], rhs.begin(), rhs.end());
+            if (indices[slot] == 0) { indices[slot] = i + 1; }
+        }
+    }
+
+    struct grammar::interned {
+        vector<symbol> names;
+        int nonterminals = 0;
+        vector<symbol_id> lhs_ids;
+        vector<symbol_id> rhs_symbols;
+        vector<uint32_t> rhs_offsets;
+
+        sequence<production> productions() const {
+            sequence<production> prods;
+            prods.reserve(lhs_ids.size());
+            for (size_t i = 0; i < lhs_ids.size(); ++i) {
+                sequence<symbol> rhs;
+                rhs.reserve(rhs_offsets[i+1] - rhs_offsets[i]);
+                for (auto j = rhs_offsets[i]; j < rhs_offsets[i+1]; ++j) { rhs.push_back(names[rhs_symbols[j]]); }
+                prods.emplace_back(names[lhs_ids[i]], move(rhs));
+            }
+            return prods;
+        }
+    };
+
+    grammar::grammar(interned&& in):
+        prods(in.productions()), names(move(in.names)), nonterminals(in.nonterminals),
+        lhs_ids(move(in.lhs_ids)), rhs_symbols(move(in.rhs_symbols)), rhs_offsets(move(in.rhs_offsets)) {
+        ids.reserve(names.size());
+        for (symbol_id i = 0; i < names.size(); ++i) { ids.emplace(names[i], i); }
+        index();
+    }
+
     set<symbol> grammar::all_symbols() const {
-        set<symbol> ret;
-        for_each(prods.begin(), prods.end(), [&ret](const production& p) {
-            ret.insert(p.lhs);
-            for_each(p.rhs.begin(), p.rhs.end(), [&ret](const symbol& s) {
-                ret.insert(s);
-            });
-        });
-        return ret;
+        return set<symbol>(names.begin(), names.end());
     }
     
     set<symbol> grammar::all_nonterminals() const {
-        auto all_syms = all_symbols();
-        set<symbol> ret;
-        for_each(all_syms.begin(), all_syms.end(), [&](const symbol& s) {
-            if (is_nonterminal(s)) { ret.insert(s); }
-        });
-        return ret;
+        return set<symbol>(names.begin(), names.begin() + nonterminals);
     }
     set<symbol> grammar::all_terminals() const {
-        auto all_syms = all_symbols();
-        set<symbol> ret;
-        for_each(all_syms.begin(), all_syms.end(), [&](const symbol& s) {
-            if (is_terminal(s)) { ret.insert(s); }
-        });
-        return ret;
+        return set<symbol>(names.begin() + nonterminals, names.end());
     }
     const sequence<production>& grammar::all_productions() const {
         return prods;
@@ -100,19 +277,75 @@ namespace cfg {
     // to be in. It's pretty simple, and counts on everything
     // being whitespace delimited.
     grammar read_grammar(istream& input) {
-        sequence<production> production_list = {};
-
-        string line;
-        while(getline(input, line)) {
-            vector<symbol> tokens = tokenize(line);
-            if (tokens.size() == 0) { continue; }
-            production new_prod{
-                *tokens.begin(), // lhs
-                sequence<symbol>{next(tokens.begin()), tokens.end()} // rhs
-            };
-            production_list.push_back(new_prod);
-        }
-        return grammar{production_list};
+        string text{istreambuf_iterator<char>(input), istreambuf_iterator<char>()};
+        return parse_grammar(text.data(), text.data() + text.size());
+    }
+
+    // One pass over the text, interning as we go. The IDs here are in
+    // order of first appearance, so at the end they get renumbered to put
+    // the nonterminals first, in order of first appearance as a LHS.
+    grammar parse_grammar(const char* first, const char* last) {
+        CFG_PHASE("parse_grammar");
+        symbol_table table;
+        grammar::interned in;
+        vector<uint32_t> lhs_order;
+        vector<bool> is_lhs;
+        in.rhs_offsets.push_back(0);
+
+        const char* s = first;
+        while (s < last) {
+            // One line.
+            int tokens = 0;
+            while (true) {
+                while (s < last && *s != '\n' && is_space(*s)) { ++s; }
+                if (s == last || *s == '\n') {
+                    s += s < last;
+                    break;
+                }
+                const char* t = s;
+                while (s + 8 <= last && !any_below_bang(load_word(s, 8))) { s += 8; }
+                while (s < last && !is_space(*s)) { ++s; }
+                uint32_t id = table.intern(t, s - t);
+                if (tokens++ == 0) {
+                    if (id >= is_lhs.size()) { is_lhs.resize(table.size(), false); }
+                    if (!is_lhs[id]) {
+                        is_lhs[id] = true;
+                        lhs_order.push_back(id);
+                    }
+                    in.lhs_ids.push_back(id);
+                }
+                else { in.rhs_symbols.push_back(id); }
+            }
+            if (tokens) { in.rhs_offsets.push_back(in.rhs_symbols.size()); }
+        }
+
+        vector<symbol_id> renumber(table.size(), no_symbol);
+        symbol_id next_id = 0;
+        for (auto id : lhs_order) { renumber[id] = next_id++; }
+        in.nonterminals = next_id;
+        for (auto& r : renumber) {
+            if (r == no_symbol) { r = next_id++; }
+        }
+        in.names.resize(table.size());
+        for (size_t id = 0; id < table.size(); ++id) {
+            in.names[renumber[id]].assign(table.text, table.starts[id], table.starts[id+1] - table.starts[id]);
+        }
+        for (auto& A : in.lhs_ids) { A = renumber[A]; }
+        for (auto& x : in.rhs_symbols) { x = renumber[x]; }
+        return grammar(move(in));
+    }
+
+    bool read_tokens(const grammar& g, istream& in, vector<symbol_id>& tokens, string* bad) {
+        string name;
+        while (in >> name) {
+            auto id = g.id_of(name);
+            if (id == no_symbol || !g.is_terminal(id)) {
+                if (bad) { *bad = name; }
+                return false;
+            }
+            tokens.push_back(id);
+        }
+        return true;
     }
 
     // Because we insert whitespace here, we should be able to read
@@ -2,10 +2,15 @@
 #define CFG_H
 
 #include <string>
-#include <list>
+#include <vector>
+#include <iterator>
+#include <unordered_map>
 #include <initializer_list>
 #include <iostream>
 #include <set>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
 
 //////////////////////////////////////////////////////////////////////////////
 // This modules present a basic CFG representation in the namespace "cfg".
@@ -19,17 +24,51 @@
 //      ordered sequence of productions---ordered because it is useful in
 //      certain situations.
 //
-// 
+// When a grammar is built it also interns every symbol into a dense
+// integer ID space (symbol_id). Nonterminals get the IDs [0, N) in order
+// of their first appearance as a LHS (so the start symbol is always 0),
+// and terminals get [N, N+T) in order of first appearance. The analyses
+// use these IDs to index flat vectors instead of string-keyed maps.
+//
+// The interned productions are stored CSR-style: all the RHS symbol IDs
+// live in one flat array, production i owning [rhs_offsets[i],
+// rhs_offsets[i+1]). Likewise the production indices are grouped by LHS,
+// so each nonterminal owns a contiguous range of them.
+//
+// Grammars are read by one pass over the whole text (parse_grammar), which
+// interns each symbol straight out of the text as it goes and only makes a
+// string once per distinct symbol. The drivers map the file in first
+// (mapped_file.h), so nothing is copied on the way in either.
 //////////////////////////////////////////////////////////////////////////////
 
 namespace cfg {
     // A symbol is just a basic string.
     typedef std::string symbol;
 
+    // The interned form of a symbol, relative to one grammar.
+    typedef std::uint32_t symbol_id;
+    const symbol_id no_symbol = UINT32_MAX;
+
     // This is a helper type: we just want an ordered sequence
-    // of objects. Probably not very efficient, but for now
-    // the input I care about is very small.
-    template <typename T> using sequence = std::list<T>;
+    // of objects. It used to be a list, but everything wants
+    // random access (and the cache-friendliness) of a vector.
+    template <typename T> using sequence = std::vector<T>;
+
+    // A read-only view of a contiguous run of T's, for handing out
+    // pieces of the grammar's flat arrays without copying.
+    template <typename T> class span {
+        const T* first;
+        const T* last;
+        public:
+        span(const T* first, const T* last): first(first), last(last) {}
+        const T* begin() const { return first; }
+        const T* end() const { return last; }
+        std::reverse_iterator<const T*> rbegin() const { return std::reverse_iterator<const T*>(last); }
+        std::reverse_iterator<const T*> rend() const { return std::reverse_iterator<const T*>(first); }
+        size_t size() const { return last - first; }
+        bool empty() const { return first == last; }
+        const T& operator[](size_t i) const { return first[i]; }
+    };
 
     // A production has two fields, lhs -> {rhs}.
     // We make the fields const so that we can make them public without
@@ -57,6 +96,7 @@ namespace cfg {
             production(const std::initializer_list<symbol>& l):
                 lhs(*l.begin()), rhs(next(l.begin()), l.end()) {}
             production(const symbol& s, const sequence<symbol>& seq): lhs(s), rhs(seq) {}
+            production(const symbol& s, sequence<symbol>&& seq): lhs(s), rhs(std::move(seq)) {}
 
             bool operator<(const production& p) const {
                 if (lhs < p.lhs) { return true; }
@@ -67,6 +107,35 @@ namespace cfg {
 
     std::ostream& operator<<(std::ostream& o, const production& p);
 
+    // The productions at a run of indices, looked up as they're read:
+    // a span of indices and the productions they index, nothing copied.
+    class production_view {
+        span<int> indices;
+        const production* prods;
+        public:
+        class iterator {
+            const int* i;
+            const production* prods;
+            public:
+            iterator(const int* i, const production* prods): i(i), prods(prods) {}
+            const production& operator*() const { return prods[*i]; }
+            const production* operator->() const { return &prods[*i]; }
+            iterator& operator++() { ++i; return *this; }
+            bool operator==(const iterator& it) const { return i == it.i; }
+            bool operator!=(const iterator& it) const { return i != it.i; }
+        };
+        production_view(span<int> indices, const production* prods): indices(indices), prods(prods) {}
+        iterator begin() const { return {indices.begin(), prods}; }
+        iterator end() const { return {indices.end(), prods}; }
+        size_t size() const { return indices.size(); }
+        bool empty() const { return indices.empty(); }
+        const production& operator[](size_t i) const { return prods[indices[i]]; }
+    };
+
+    struct production_hash {
+        size_t operator()(const production& p) const;
+    };
+
     // The fields here are const for the same reason as in a production.
     // There's a good number of helper functions to both formalize extra info
     // about the grammar (e.g., what defines the start symbol?) and to help
@@ -74,18 +143,25 @@ namespace cfg {
     class grammar{
         public:
         const sequence<production> prods;
-        grammar(sequence<production>& prods): prods(prods) {}
+        grammar(sequence<production>& prods): prods(prods) { intern(); }
 
         // Allows a succinct way of writing grammars in-code.
-        grammar(const std::initializer_list<production>& lst): prods(lst.begin(), lst.end()) {}
+        grammar(const std::initializer_list<production>& lst): prods(lst.begin(), lst.end()) { intern(); }
 
-        // Maps interegers to productions and back again.
-        production operator[](const int i) const;
+        // Maps interegers to productions and back again, in O(1).
+        const production& operator[](const int i) const { return prods[i]; }
         int index_of(const production& p) const;
 
-        // Reasons about symbols and nonterminals.
+        // Reasons about symbols and nonterminals. Only a grammar with
+        // productions has a start symbol.
         symbol start_symbol() const;
-        sequence<production> productions_from_nonterminal(const symbol lhs) const;
+        // The productions of lhs, in grammar order, viewed through
+        // production_indices.
+        production_view productions_from_nonterminal(const symbol& lhs) const;
+        // The indices of all productions with LHS lhs, in grammar order.
+        span<int> production_indices(symbol_id lhs) const {
+            return {by_lhs.data() + lhs_offsets[lhs], by_lhs.data() + lhs_offsets[lhs+1]};
+        }
         int size() const { return prods.size(); }
 
         // A nonterminal is any symbol that appears as a LHS in a production,
@@ -93,16 +169,70 @@ namespace cfg {
         bool is_nonterminal(const symbol& p) const;
         bool is_terminal(const symbol& p) const;
 
-        // pretty inefficient!
+        // These just copy out of the interned symbol table.
         std::set<symbol> all_symbols() const;
         std::set<symbol> all_nonterminals() const;
         std::set<symbol> all_terminals() const;
         const sequence<production>& all_productions() const;
+
+        // The interned view of the grammar. These are all O(1).
+        int symbol_count() const { return names.size(); }
+        int nonterminal_count() const { return nonterminals; }
+        int terminal_count() const { return symbol_count() - nonterminals; }
+        // no_symbol if s never appears in the grammar.
+        symbol_id id_of(const symbol& s) const;
+        const symbol& name_of(symbol_id i) const { return names[i]; }
+        bool is_nonterminal(symbol_id i) const { return nonterminal_bits[i]; }
+        bool is_terminal(symbol_id i) const { return terminal_bits[i]; }
+        // Terminals numbered from 0, for indexing terminal-only tables.
+        int terminal_index(symbol_id i) const { return i - nonterminals; }
+        symbol_id terminal_id(int t) const { return t + nonterminals; }
+        symbol_id lhs_id(int i) const { return lhs_ids[i]; }
+        span<symbol_id> rhs_ids(int i) const {
+            return {rhs_symbols.data() + rhs_offsets[i], rhs_symbols.data() + rhs_offsets[i+1]};
+        }
+        int rhs_size(int i) const { return rhs_offsets[i+1] - rhs_offsets[i]; }
+
+        private:
+        // What parse_grammar has already worked out.
+        struct interned;
+        explicit grammar(interned&& in);
+        friend grammar parse_grammar(const char* first, const char* last);
+
+        void intern();
+        // Everything else, from the interned productions.
+        void index();
+
+        std::vector<symbol> names;
+        std::unordered_map<symbol, symbol_id> ids;
+        int nonterminals = 0;
+        // Precomputed classification, indexed by symbol_id.
+        std::vector<bool> nonterminal_bits;
+        std::vector<bool> terminal_bits;
+        std::vector<symbol_id> lhs_ids;
+        std::vector<symbol_id> rhs_symbols;
+        std::vector<std::uint32_t> rhs_offsets;
+        // Production indices grouped by LHS, and each nonterminal's
+        // [lhs_offsets[A], lhs_offsets[A+1]) range into it.
+        std::vector<int> by_lhs;
+        std::vector<std::uint32_t> lhs_offsets;
+        // Open addressing on a hash of the symbol IDs: production index
+        // + 1, or 0 for an empty slot.
+        std::vector<int> indices;
+        // The slot production i is in, or would be in if it's a duplicate.
+        std::size_t find_slot(symbol_id lhs, const symbol_id* first, const symbol_id* last) const;
     };
 
     std::ostream& operator<<(std::ostream& o, const grammar& g);
     // We don't use the >> operator because a grammar is all-const.
     grammar read_grammar(std::istream& o);
+    // The grammar in the text [first, last), one production per line: the
+    // LHS and then the RHS, separated by whitespace. Blank lines don't count.
+    grammar parse_grammar(const char* first, const char* last);
+    // Reads whitespace separated terminal names of g as input for the
+    // parsers. On an unknown name, returns false with the name in *bad.
+    bool read_tokens(const grammar& g, std::istream& in, std::vector<symbol_id>& tokens,
+                     std::string* bad = nullptr);
 };
 
 #endif
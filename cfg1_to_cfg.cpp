@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <iterator>
 #include <tuple>
+#include <set>
 
 #include "cfg.h"
 
@@ -30,8 +31,6 @@ string closure_command = "*";
 std::string production_operator = "=>";
 
 
-sequence<production> initial_grammar;
-
 // This is the main processing: create new productions
 // based on the * operator.
 sequence<production> seq_from_star(production transition) {
@@ -52,7 +51,7 @@ sequence<production> seq_from_star(production transition) {
 
   return {{transition.lhs, new_rhs},
           {new_nonterm, {old_nonterm, new_nonterm}},
-          {new_nonterm, {}}};
+          {new_nonterm, sequence<symbol>()}};
 
 }
 
@@ -79,6 +78,7 @@ production remove_escapes(production p) {
 }
 
 grammar parse_cfg1_file(std::istream& in) {
+  sequence<production> initial_grammar;
   string line;
   string word;
   while (getline(in, line)) {
@@ -115,12 +115,13 @@ grammar parse_cfg1_file(std::istream& in) {
   }
 
   sequence<production> new_grammar;
+  set<production> added;
   for (auto&& p : initial_grammar) {
     if (find(begin(p.rhs), end(p.rhs), closure_command) != end(p.rhs)) {
       for (auto&& r : seq_from_star(p)) {
         // don't add a redundant production (comes up when element* is
         // used in multiple productions)
-        if (find(begin(new_grammar), end(new_grammar), r) == end(new_grammar)) {
+        if (added.insert(r).second) {
           new_grammar.push_back(remove_escapes(r));
         }
       }
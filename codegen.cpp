@@ -0,0 +1,289 @@
+#include "codegen.h"
+
+#include <map>
+#include <vector>
+#include <string>
+#include <cctype>
+#include <cstdint>
+
+using namespace std;
+
+namespace cfg {
+    namespace {
+        // name as a string literal.
+        string quoted(const string& name) {
+            string s = "\"";
+            for (char c : name) {
+                if (c == '"' || c == '\\' || c == '?') { s += '\\'; }
+                s += c;
+            }
+            return s + "\"";
+        }
+
+        // name for inside /* */.
+        string commented(const string& name) {
+            string s;
+            for (size_t i = 0; i < name.size(); ++i) {
+                s += name[i];
+                if (name[i] == '*' && i + 1 < name.size() && name[i+1] == '/') { s += ' '; }
+                if (name[i] == '/' && i + 1 < name.size() && name[i+1] == '*') { s += ' '; }
+            }
+            return s;
+        }
+
+        string production_comment(const grammar& g, int p) {
+            string s = "/* " + commented(g.name_of(g.lhs_id(p))) + " ->";
+            for (auto x : g.rhs_ids(p)) {
+                s += " " + commented(g.name_of(x));
+            }
+            return s + " */";
+        }
+
+        // Everything both kinds of parser start with.
+        void write_prologue(ostream& o, const grammar& g, const string& name, const char* what) {
+            string guard = name;
+            for (auto& c : guard) { c = toupper(static_cast<unsigned char>(c)); }
+            guard += "_H";
+
+            o << "// " << what << " for a grammar of " << g.size() << " productions,\n"
+              << "// written by parsergen. Don't edit it, regenerate it.\n"
+              << "#ifndef " << guard << "\n"
+              << "#define " << guard << "\n\n"
+              << "#include <vector>\n"
+              << "#include <cstddef>\n\n"
+              << "namespace " << name << " {\n";
+
+            int N = g.nonterminal_count(), T = g.terminal_count();
+            o << "    constexpr int terminal_count = " << T << ";\n"
+              << "    constexpr int production_count = " << g.size() << ";\n"
+              << "    // By terminal index, and then the end of input.\n"
+              << "    constexpr const char* terminal_names[terminal_count + 1] = {\n";
+            for (int t = 0; t < T; ++t) {
+                o << "        " << quoted(g.name_of(N + t)) << ",\n";
+            }
+            o << "        \"end of input\"\n"
+              << "    };\n"
+              << "    // The nonterminal each production is for, numbered from 0 in\n"
+              << "    // order of appearance, and how many symbols it has on the right.\n"
+              << "    constexpr int rule_lhs[production_count] = {";
+            for (int p = 0; p < g.size(); ++p) {
+                o << (p % 16 ? " " : "\n        ") << g.lhs_id(p) << ",";
+            }
+            o << "\n    };\n"
+              << "    constexpr int rule_length[production_count] = {";
+            for (int p = 0; p < g.size(); ++p) {
+                o << (p % 16 ? " " : "\n        ") << g.rhs_size(p) << ",";
+            }
+            o << "\n    };\n\n";
+        }
+
+        void write_epilogue(ostream& o) {
+            o << "    inline bool recognize(const int* tokens, std::size_t n, std::size_t* error_at = nullptr) {\n"
+              << "        return parse(tokens, n, [](int) {}, error_at);\n"
+              << "    }\n"
+              << "}\n\n"
+              << "#endif\n";
+        }
+
+        // The column of the current token, as the generated code works it
+        // out: -1 for anything that isn't a terminal index.
+        const char* const current_column =
+            "i == n ? terminal_count : unsigned(tokens[i]) < unsigned(terminal_count) ? tokens[i] : -1";
+    }
+
+    string identifier_for(const string& name) {
+        string s;
+        for (char c : name) {
+            s += isalnum(static_cast<unsigned char>(c)) ? c : '_';
+        }
+        if (s.empty() || isdigit(static_cast<unsigned char>(s[0]))) { s = "_" + s; }
+        return s;
+    }
+
+    bool generate_recursive_descent(ostream& o, const ll1_parser& parser, const string& name) {
+        if (parser.conflicts().size()) { return false; }
+        auto& g = parser.g;
+        const symbol_id N = g.nonterminal_count();
+        const int columns = parser.terminal_columns();
+        write_prologue(o, g, name, "A recursive descent parser");
+
+        o << "    namespace detail {\n"
+          << "        template <typename Expanded>\n"
+          << "        struct parser {\n"
+          << "            const int* tokens;\n"
+          << "            std::size_t n, i;\n"
+          << "            Expanded& expanded;\n\n"
+          << "            int peek() const {\n"
+          << "                return " << current_column << ";\n"
+          << "            }\n"
+          << "            bool match(int t) {\n"
+          << "                if (peek() != t) { return false; }\n"
+          << "                ++i;\n"
+          << "                return true;\n"
+          << "            }\n";
+
+        for (symbol_id A = 0; A < N; ++A) {
+            // The columns each production is predicted at, in production
+            // order.
+            map<int, vector<int>> predicted;
+            for (int t = 0; t < columns; ++t) {
+                int p = parser.predict(A, t);
+                if (p >= 0) { predicted[p].push_back(t); }
+            }
+            o << "\n            // " << quoted(g.name_of(A)) << "\n"
+              << "            bool parse_" << A << "() {\n"
+              << "                switch (peek()) {\n";
+            for (auto&& e : predicted) {
+                int p = e.first;
+                o << "                    ";
+                for (auto t : e.second) {
+                    o << "case " << t << ": ";
+                }
+                o << production_comment(g, p) << "\n"
+                  << "                        expanded(" << p << ");\n"
+                  << "                        return ";
+                if (!g.rhs_size(p)) { o << "true"; }
+                bool first = true;
+                for (auto x : g.rhs_ids(p)) {
+                    if (!first) { o << " && "; }
+                    first = false;
+                    if (x < N) { o << "parse_" << x << "()"; }
+                    else { o << "match(" << x - N << ")"; }
+                }
+                o << ";\n";
+            }
+            o << "                    default:\n"
+              << "                        return false;\n"
+              << "                }\n"
+              << "            }\n";
+        }
+        o << "        };\n"
+          << "    }\n\n";
+
+        o << "    // Calls expanded(p) for each production p of the leftmost\n"
+          << "    // derivation, as it goes.\n"
+          << "    template <typename Expanded>\n"
+          << "    inline bool parse(const int* tokens, std::size_t n, Expanded expanded, std::size_t* error_at = nullptr) {\n"
+          << "        detail::parser<Expanded> p{tokens, n, 0, expanded};\n"
+          << "        if (p.parse_0() && p.i == n) { return true; }\n"
+          << "        if (error_at) { *error_at = p.i; }\n"
+          << "        return false;\n"
+          << "    }\n\n";
+        write_epilogue(o);
+        return true;
+    }
+
+    void generate_direct_lr(ostream& o, const lr_parser& parser, const string& name) {
+        auto& g = parser.g;
+        const symbol_id N = g.nonterminal_count();
+        const int columns = g.terminal_count() + 1;
+        const int states = parser.action_table().bases().size();
+        auto& action_defaults = parser.action_table().default_values();
+        auto& goto_defaults = parser.goto_table().default_values();
+        write_prologue(o, g, name, "A direct-coded LALR(1) parser");
+
+        // Work out what gets jumped to first, so every label we write is
+        // used.
+        vector<bool> entered(states, false), reduced(g.size(), false), went_to(N, false);
+        for (int s = 0; s < states; ++s) {
+            for (int t = 0; t < columns; ++t) {
+                auto a = parser.action(s, t);
+                if (a > 0) { entered[a - 1] = true; }
+                else if (a < 0 && a != lr_parser::accept_code) { reduced[-a - 1] = true; }
+            }
+        }
+        for (int p = 0; p < g.size(); ++p) {
+            if (reduced[p]) { went_to[g.lhs_id(p)] = true; }
+        }
+        for (symbol_id A = 0; A < N; ++A) {
+            if (!went_to[A]) { continue; }
+            for (int s = 0; s < states; ++s) {
+                int target = parser.go_to(s, A);
+                if (target >= 0) { entered[target] = true; }
+            }
+        }
+
+        auto jump = [&](int32_t a) {
+            if (a > 0) { return "++i; t = next(); goto state_" + to_string(a - 1) + ";"; }
+            if (a == lr_parser::accept_code) { return string("return true;"); }
+            if (a < 0) { return "goto reduce_" + to_string(-a - 1) + ";"; }
+            return string("goto fail;");
+        };
+
+        o << "    // Calls reduced(p) for each production p it reduces by: a\n"
+          << "    // rightmost derivation, backwards.\n"
+          << "    template <typename Reduced>\n"
+          << "    inline bool parse(const int* tokens, std::size_t n, Reduced reduced, std::size_t* error_at = nullptr) {\n"
+          << "        std::vector<int> stack;\n"
+          << "        stack.reserve(256);\n"
+          << "        std::size_t i = 0;\n"
+          << "        auto next = [&]() {\n"
+          << "            return " << current_column << ";\n"
+          << "        };\n"
+          << "        int t = next();\n";
+
+        for (int s = 0; s < states; ++s) {
+            o << "\n";
+            if (entered[s]) { o << "    state_" << s << ":\n"; }
+            o << "        stack.push_back(" << s << ");\n"
+              << "        switch (t) {\n";
+            // Group the columns by what they do, leaving out the default.
+            int32_t fallback = action_defaults[s];
+            map<int32_t, vector<int>> by_action;
+            for (int t = 0; t < columns; ++t) {
+                auto a = parser.action(s, t);
+                if (a != fallback) { by_action[a].push_back(t); }
+            }
+            // An invalid token fails right away even where there's a
+            // default reduction, as in lr_parser.
+            if (fallback < 0) { by_action[0].push_back(-1); }
+            for (auto&& e : by_action) {
+                o << "            ";
+                for (auto t : e.second) {
+                    o << "case " << t << ": ";
+                }
+                o << jump(e.first) << "\n";
+            }
+            o << "            default: " << jump(fallback) << "\n"
+              << "        }\n";
+        }
+
+        for (int p = 0; p < g.size(); ++p) {
+            if (!reduced[p]) { continue; }
+            o << "\n    reduce_" << p << ": " << production_comment(g, p) << "\n";
+            if (g.rhs_size(p)) {
+                o << "        stack.resize(stack.size() - " << g.rhs_size(p) << ");\n";
+            }
+            o << "        reduced(" << p << ");\n"
+              << "        goto goto_" << g.lhs_id(p) << ";\n";
+        }
+
+        for (symbol_id A = 0; A < N; ++A) {
+            if (!went_to[A]) { continue; }
+            int fallback = goto_defaults[A];
+            o << "\n    goto_" << A << ": /* " << commented(g.name_of(A)) << " */\n"
+              << "        switch (stack.back()) {\n";
+            map<int, vector<int>> by_target;
+            for (int s = 0; s < states; ++s) {
+                int target = parser.go_to(s, A);
+                if (target >= 0 && target != fallback) { by_target[target].push_back(s); }
+            }
+            for (auto&& e : by_target) {
+                o << "            ";
+                for (auto s : e.second) {
+                    o << "case " << s << ": ";
+                }
+                o << "goto state_" << e.first << ";\n";
+            }
+            // Only states with a GOTO on A are ever uncovered here.
+            o << "            default: goto state_" << (fallback >= 0 ? fallback : by_target.begin()->first) << ";\n"
+              << "        }\n";
+        }
+
+        o << "\n    fail:\n"
+          << "        if (error_at) { *error_at = i; }\n"
+          << "        return false;\n"
+          << "    }\n\n";
+        write_epilogue(o);
+    }
+}
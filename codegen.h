@@ -0,0 +1,60 @@
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+//////////////////////////////////////////////////////////////////////////////
+// Parser generators: instead of a table and an interpreter for it, write out
+// C++ that is the parser for one grammar, for the compiler to make the most
+// of. Each comes out as a header with no dependencies on anything here, in a
+// namespace of its own:
+//
+//   terminal_count, production_count, terminal_names, rule_lhs,
+//   rule_length   constexpr tables, so a caller can map its tokens and
+//                 make sense of the productions it gets back
+//   parse(tokens, n, callback, &error_at)
+//   recognize(tokens, n, &error_at)
+//
+// Tokens are terminal indices of g (ID minus nonterminal_count()), without
+// an end marker; anything else is an error. On failure error_at is the index
+// of the token we choked on, the same one ll1_parser or lr_parser would say.
+//
+//   recursive descent   From the LL(1) table: a function per nonterminal,
+//                       switching on the current token to the code for the
+//                       production its PREDICT set picks, which calls or
+//                       matches each symbol of the right hand side in turn.
+//                       The callback gets each production as it's expanded,
+//                       so a leftmost derivation, as ll1_parser::parse. A
+//                       grammar with LL(1) conflicts is refused: we'd have
+//                       to pick one production and left recursion would
+//                       recurse forever.
+//   direct-coded LR     From the LALR(1) tables as lr_parser packs them
+//                       (default reductions and all): a label per state,
+//                       which pushes the state and switches on the token to
+//                       a goto for each shift and reduction. A reduction
+//                       pops its right hand side and switches on the state
+//                       it uncovered to the GOTO target. No table lookups
+//                       left, just jumps (Pennello, "Very fast LR parsing",
+//                       SIGPLAN '86). The callback gets each reduction, so
+//                       a reverse rightmost derivation, as lr_parser::parse.
+//                       Conflicts are resolved as the table resolved them.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <string>
+#include <iostream>
+
+#include "cfg.h"
+#include "ll1.h"
+#include "lr_parser.h"
+
+namespace cfg {
+    // Writes out the recursive descent parser for the grammar parser was
+    // built from, in namespace name. Returns false (writing nothing) if the
+    // grammar isn't LL(1).
+    bool generate_recursive_descent(std::ostream& o, const ll1_parser& parser, const std::string& name);
+    // Writes out the direct-coded LR parser for the tables in parser.
+    void generate_direct_lr(std::ostream& o, const lr_parser& parser, const std::string& name);
+
+    // name made into a C++ identifier, for a namespace.
+    std::string identifier_for(const std::string& name);
+}
+
+#endif
@@ -0,0 +1,115 @@
+#include <chrono>
+#include <string>
+#include <memory>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <unistd.h>
+#include "cfg.h"
+#include "mapped_file.h"
+#include "arguments.h"
+#include "compiled.h"
+
+// Recognizes the tokens on stdin with the grammar in the given file, by
+// LALR(1) or with -l by LL(1), using its compiled form in grammar.cfg.bin.
+// That gets (re)built first if it's missing, from another version of the
+// format, or was compiled from different text than the grammar has now.
+// Usage: ./compile_driver [-l] [-b repeats] grammar.cfg < tokens
+// How long it took to get the tables ready goes to stderr; with -b we then
+// recognize the input that many times and report the throughput.
+
+using namespace std;
+using namespace cfg;
+
+int main(int argc, char* argv[]) {
+    auto start = chrono::steady_clock::now();
+    bool ll1 = false;
+    long repeats = 0;
+    int arg = 1;
+    for (; arg < argc - 1; ++arg) {
+        string flag = argv[arg];
+        if (flag == "-l") { ll1 = true; }
+        else if (flag == "-b" && arg + 1 < argc - 1 && parse_number(argv[arg + 1], repeats)) { ++arg; }
+        else { break; }
+    }
+    if (arg != argc - 1) {
+        cerr << "usage: " << argv[0] << " [-l] [-b repeats] grammar.cfg < tokens" << endl;
+        return 2;
+    }
+    mapped_file source(argv[arg]);
+    if (!source) {
+        cerr << "can't open " << argv[arg] << endl;
+        return 2;
+    }
+    auto hash = content_hash(source.begin(), source.end());
+    string path = string(argv[arg]) + ".bin";
+
+    unique_ptr<mapped_file> file(new mapped_file(path));
+    unique_ptr<compiled_grammar> compiled(new compiled_grammar(file->begin(), file->end()));
+    bool rebuilt = false;
+    if (!*file || !*compiled || compiled->source_hash() != hash) {
+        // Written beside it and renamed into place, so another run never
+        // maps a half written file.
+        auto G = parse_grammar(source.begin(), source.end());
+        if (G.size() == 0) {
+            cerr << argv[arg] << ": empty grammar" << endl;
+            return 2;
+        }
+        string temporary = path + ".tmp" + to_string(getpid());
+        ofstream out(temporary, ios::binary);
+        bool written = write_compiled_grammar(out, G, hash);
+        out.close();
+        if (!written || !out || rename(temporary.c_str(), path.c_str()) != 0) {
+            remove(temporary.c_str());
+            cerr << "can't write " << path << endl;
+            return 2;
+        }
+        file.reset(new mapped_file(path));
+        compiled.reset(new compiled_grammar(file->begin(), file->end()));
+        rebuilt = true;
+    }
+    if (!*compiled) {
+        cerr << path << " didn't read back" << endl;
+        return 2;
+    }
+    chrono::duration<double> ready = chrono::steady_clock::now() - start;
+    cerr << (rebuilt ? "compiled " : "loaded ") << path << " in " << ready.count() * 1e6 << " us" << endl;
+    if ((ll1 && compiled->ll1_conflicts()) || (!ll1 && compiled->lr_conflicts())) {
+        cerr << "the grammar isn't " << (ll1 ? "LL(1)" : "LALR(1)") << "; conflicts went the default way" << endl;
+    }
+
+    vector<symbol_id> tokens;
+    string name;
+    while (cin >> name) {
+        auto x = compiled->id_of(name);
+        if (x == no_symbol || !compiled->is_terminal(x)) {
+            cerr << "unknown token " << name << endl;
+            return 1;
+        }
+        tokens.push_back(x);
+    }
+    span<symbol_id> input{tokens.data(), tokens.data() + tokens.size()};
+    auto recognize = [&](size_t* error_at) {
+        return ll1 ? compiled->ll1_recognize(input, error_at) : compiled->lr_recognize(input, error_at);
+    };
+
+    if (repeats > 0) {
+        start = chrono::steady_clock::now();
+        long accepted = 0;
+        for (long r = 0; r < repeats; ++r) {
+            accepted += recognize(nullptr);
+        }
+        chrono::duration<double> took = chrono::steady_clock::now() - start;
+        cout << accepted << "/" << repeats << " accepted, "
+             << tokens.size() * repeats / took.count() / 1e6 << " million tokens/s" << endl;
+        return accepted == repeats ? 0 : 1;
+    }
+
+    size_t error_at = 0;
+    if (!recognize(&error_at)) {
+        cout << "syntax error at token " << error_at << endl;
+        return 1;
+    }
+    cout << "accepted" << endl;
+}
@@ -0,0 +1,425 @@
+#include "compiled.h"
+#include "first.h"
+#include "ll1.h"
+#include "lr0.h"
+#include "lalr.h"
+#include "lr_table.h"
+#include "lr_parser.h"
+
+#include <memory>
+#include <vector>
+#include <cstring>
+#include <cassert>
+
+using namespace std;
+
+namespace cfg {
+    namespace {
+        const char magic[8] = {'c', 'f', 'g', 'b', 'i', 'n', '\r', '\n'};
+        // Reads back as something else on a machine of the other endianness.
+        const uint32_t byte_order = 0x01020304;
+
+        enum section {
+            name_offsets_section, name_text_section, name_slots_section,
+            lhs_ids_section, rhs_offsets_section, rhs_symbols_section,
+            by_lhs_section, lhs_offsets_section,
+            nullable_section, first_section, follow_section, predict_section,
+            ll1_section,
+            action_base_section, action_defaults_section, action_entries_section,
+            goto_base_section, goto_defaults_section, goto_entries_section,
+            section_count
+        };
+
+        const uint32_t ll1_conflict_flag = 1, lr_conflict_flag = 2;
+
+        uint64_t mix(uint64_t h) {
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            return h ^ (h >> 33);
+        }
+    }
+
+    struct compiled_grammar::header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint64_t source_hash;
+        uint64_t file_size;
+        uint32_t symbols;
+        uint32_t nonterminals;
+        uint32_t productions;
+        uint32_t words;
+        uint32_t lr_states;
+        uint32_t flags;
+        struct {
+            uint64_t offset;
+            uint64_t bytes;
+        } sections[section_count];
+    };
+
+    // A word at a time, with a proper mix at the end.
+    uint64_t content_hash(const char* first, const char* last) {
+        uint64_t h = uint64_t(last - first) * 0x9e3779b97f4a7c15ull;
+        for (; last - first >= 8; first += 8) {
+            uint64_t w;
+            memcpy(&w, first, 8);
+            h = (h ^ w) * 0xff51afd7ed558ccdull;
+            h ^= h >> 32;
+        }
+        if (first != last) {
+            uint64_t w = 0;
+            memcpy(&w, first, last - first);
+            h = (h ^ w) * 0xff51afd7ed558ccdull;
+        }
+        return mix(h);
+    }
+
+    bool write_compiled_grammar(ostream& o, const grammar& g, uint64_t source_hash) {
+        const int N = g.nonterminal_count();
+        const int columns = g.terminal_count() + 1;
+
+        grammar_analysis A(g);
+        const auto& F = A.first();
+        const auto& FOLLOW = A.follow();
+        const auto& PREDICT = A.predict();
+        ll1_parser ll1(A);
+        auto augmented = augment(g);
+        lr0_automaton automaton(augmented);
+        auto table = build_lalr_table(g, automaton);
+        lr_parser lr(table);
+
+        vector<uint32_t> name_offsets(1, 0);
+        string name_text;
+        for (symbol_id x = 0; x < symbol_id(g.symbol_count()); ++x) {
+            name_text += g.name_of(x);
+            name_offsets.push_back(name_text.size());
+        }
+        size_t slots = 16;
+        while (slots < 2 * size_t(g.symbol_count())) { slots *= 2; }
+        vector<uint32_t> name_slots(slots, 0);
+        for (symbol_id x = 0; x < symbol_id(g.symbol_count()); ++x) {
+            auto& s = g.name_of(x);
+            size_t i = content_hash(s.data(), s.data() + s.size()) & (slots - 1);
+            while (name_slots[i]) { i = (i + 1) & (slots - 1); }
+            name_slots[i] = x + 1;
+        }
+
+        vector<symbol_id> lhs_ids, rhs_symbols;
+        vector<uint32_t> rhs_offsets(1, 0);
+        for (int p = 0; p < g.size(); ++p) {
+            lhs_ids.push_back(g.lhs_id(p));
+            auto rhs = g.rhs_ids(p);
+            rhs_symbols.insert(rhs_symbols.end(), rhs.begin(), rhs.end());
+            rhs_offsets.push_back(rhs_symbols.size());
+        }
+        vector<int32_t> by_lhs;
+        vector<uint32_t> lhs_offsets(1, 0);
+        for (symbol_id B = 0; B < symbol_id(N); ++B) {
+            auto ps = g.production_indices(B);
+            by_lhs.insert(by_lhs.end(), ps.begin(), ps.end());
+            lhs_offsets.push_back(by_lhs.size());
+        }
+
+        vector<uint8_t> nullable(F.nullable.begin(), F.nullable.end());
+        int words = F.first.words_per_row();
+        assert(FOLLOW.words_per_row() == words && PREDICT.words_per_row() == words);
+        auto rows = [&](const bit_matrix& m) {
+            return vector<bits::word>(m.row(0), m.row(0) + size_t(m.rows()) * words);
+        };
+        vector<bits::word> first_rows = rows(F.first), follow_rows = rows(FOLLOW), predict_rows = rows(PREDICT);
+
+        vector<int32_t> ll1_table;
+        for (symbol_id B = 0; B < symbol_id(N); ++B) {
+            for (int t = 0; t < columns; ++t) { ll1_table.push_back(ll1.predict(B, t)); }
+        }
+
+        compiled_grammar::header h;
+        memset(&h, 0, sizeof h);
+        memcpy(h.magic, magic, sizeof magic);
+        h.version = compiled_grammar::version;
+        h.byte_order = byte_order;
+        h.source_hash = source_hash;
+        h.symbols = g.symbol_count();
+        h.nonterminals = N;
+        h.productions = g.size();
+        h.words = words;
+        h.lr_states = table.state_count();
+        h.flags = (ll1.conflicts().size() ? ll1_conflict_flag : 0) | (table.conflicts().size() ? lr_conflict_flag : 0);
+
+        // Lay the sections out after the header, each on an 8 byte boundary.
+        const void* data[section_count];
+        auto place = [&](section s, const void* p, size_t bytes) {
+            data[s] = p;
+            h.sections[s].bytes = bytes;
+        };
+        auto& actions = lr.action_table();
+        auto& gotos = lr.goto_table();
+        place(name_offsets_section, name_offsets.data(), name_offsets.size() * 4);
+        place(name_text_section, name_text.data(), name_text.size());
+        place(name_slots_section, name_slots.data(), name_slots.size() * 4);
+        place(lhs_ids_section, lhs_ids.data(), lhs_ids.size() * 4);
+        place(rhs_offsets_section, rhs_offsets.data(), rhs_offsets.size() * 4);
+        place(rhs_symbols_section, rhs_symbols.data(), rhs_symbols.size() * 4);
+        place(by_lhs_section, by_lhs.data(), by_lhs.size() * 4);
+        place(lhs_offsets_section, lhs_offsets.data(), lhs_offsets.size() * 4);
+        place(nullable_section, nullable.data(), nullable.size());
+        place(first_section, first_rows.data(), first_rows.size() * sizeof(bits::word));
+        place(follow_section, follow_rows.data(), follow_rows.size() * sizeof(bits::word));
+        place(predict_section, predict_rows.data(), predict_rows.size() * sizeof(bits::word));
+        place(ll1_section, ll1_table.data(), ll1_table.size() * 4);
+        place(action_base_section, actions.bases().data(), actions.bases().size() * 4);
+        place(action_defaults_section, actions.default_values().data(), actions.default_values().size() * 4);
+        place(action_entries_section, actions.slots().data(), actions.slots().size() * sizeof(packed_table::entry));
+        place(goto_base_section, gotos.bases().data(), gotos.bases().size() * 4);
+        place(goto_defaults_section, gotos.default_values().data(), gotos.default_values().size() * 4);
+        place(goto_entries_section, gotos.slots().data(), gotos.slots().size() * sizeof(packed_table::entry));
+        static_assert(sizeof(packed_table::entry) == 8, "entries are (check, value) pairs");
+
+        auto aligned = [](uint64_t n) { return (n + 7) & ~uint64_t(7); };
+        uint64_t offset = aligned(sizeof h);
+        for (int s = 0; s < section_count; ++s) {
+            h.sections[s].offset = offset;
+            offset = aligned(offset + h.sections[s].bytes);
+        }
+        h.file_size = offset;
+
+        const char zeros[8] = {};
+        o.write(reinterpret_cast<const char*>(&h), sizeof h);
+        o.write(zeros, aligned(sizeof h) - sizeof h);
+        for (int s = 0; s < section_count; ++s) {
+            auto bytes = h.sections[s].bytes;
+            o.write(static_cast<const char*>(data[s]), bytes);
+            o.write(zeros, aligned(bytes) - bytes);
+        }
+        return bool(o);
+    }
+
+    compiled_grammar::compiled_grammar(const char* first, const char* last) {
+        size_t size = last - first;
+        if (size < sizeof(header) || reinterpret_cast<uintptr_t>(first) % 8) { return; }
+        head = reinterpret_cast<const header*>(first);
+        if (memcmp(head->magic, magic, sizeof magic) || head->version != version
+            || head->byte_order != byte_order || head->file_size != size) {
+            return;
+        }
+        symbols = head->symbols;
+        nonterminals = head->nonterminals;
+        productions = head->productions;
+        words = head->words;
+        if (nonterminals > symbols || words != int(bits::words_for(symbols - nonterminals + 1))) { return; }
+
+        // Every section has to be inside the file, aligned, and the size
+        // the counts say.
+        auto at = [&](section s, uint64_t bytes) -> const char* {
+            auto& where = head->sections[s];
+            if (where.offset % 8 || where.offset > size || where.bytes > size - where.offset) { return nullptr; }
+            if (bytes != where.bytes) { return nullptr; }
+            return first + where.offset;
+        };
+        auto entries_of = [&](section s) -> const char* {
+            auto bytes = head->sections[s].bytes;
+            return bytes % 8 ? nullptr : at(s, bytes);
+        };
+        uint64_t S = symbols, N = nonterminals, P = productions, W = words, states = head->lr_states;
+        name_offsets = reinterpret_cast<const uint32_t*>(at(name_offsets_section, (S + 1) * 4));
+        if (!name_offsets) { return; }
+        name_text = at(name_text_section, name_offsets[S]);
+        auto slot_bytes = head->sections[name_slots_section].bytes;
+        name_mask = slot_bytes / 4 - 1;
+        if (slot_bytes < 4 || (slot_bytes / 4) & name_mask) { return; }
+        name_slots = reinterpret_cast<const uint32_t*>(at(name_slots_section, slot_bytes));
+        lhs_ids = reinterpret_cast<const symbol_id*>(at(lhs_ids_section, P * 4));
+        rhs_offsets = reinterpret_cast<const uint32_t*>(at(rhs_offsets_section, (P + 1) * 4));
+        if (!rhs_offsets) { return; }
+        rhs_symbols = reinterpret_cast<const symbol_id*>(at(rhs_symbols_section, uint64_t(rhs_offsets[P]) * 4));
+        by_lhs = reinterpret_cast<const int32_t*>(at(by_lhs_section, P * 4));
+        lhs_offsets = reinterpret_cast<const uint32_t*>(at(lhs_offsets_section, (N + 1) * 4));
+        nullable_bytes = reinterpret_cast<const uint8_t*>(at(nullable_section, S));
+        first_rows = reinterpret_cast<const bits::word*>(at(first_section, S * W * sizeof(bits::word)));
+        follow_rows = reinterpret_cast<const bits::word*>(at(follow_section, S * W * sizeof(bits::word)));
+        predict_rows = reinterpret_cast<const bits::word*>(at(predict_section, P * W * sizeof(bits::word)));
+        ll1_table = reinterpret_cast<const int32_t*>(at(ll1_section, N * (S - N + 1) * 4));
+        action.base = reinterpret_cast<const int32_t*>(at(action_base_section, states * 4));
+        action.defaults = reinterpret_cast<const int32_t*>(at(action_defaults_section, states * 4));
+        action.entries = reinterpret_cast<const int32_t*>(entries_of(action_entries_section));
+        go_to.base = reinterpret_cast<const int32_t*>(at(goto_base_section, N * 4));
+        go_to.defaults = reinterpret_cast<const int32_t*>(at(goto_defaults_section, N * 4));
+        go_to.entries = reinterpret_cast<const int32_t*>(entries_of(goto_entries_section));
+
+        if (!(name_text && name_slots && lhs_ids && rhs_symbols && by_lhs && lhs_offsets && nullable_bytes
+              && first_rows && follow_rows && predict_rows && ll1_table
+              && action.base && action.defaults && action.entries && go_to.base && go_to.defaults && go_to.entries)) {
+            return;
+        }
+
+        // The sizes are right, but everything we'd index with has to be in
+        // range too, or a corrupt file is an out of bounds read rather than
+        // something to rebuild. Once here, so nothing else has to check.
+        auto increasing = [](const uint32_t* offsets, uint64_t n, uint64_t last) {
+            if (offsets[0] != 0 || offsets[n] != last) { return false; }
+            for (uint64_t i = 0; i < n; ++i) {
+                if (offsets[i] > offsets[i+1]) { return false; }
+            }
+            return true;
+        };
+        auto all_below = [](auto values, uint64_t n, int64_t low, int64_t high) {
+            for (uint64_t i = 0; i < n; ++i) {
+                if (int64_t(values[i]) < low || int64_t(values[i]) >= high) { return false; }
+            }
+            return true;
+        };
+        if (!increasing(name_offsets, S, name_offsets[S]) || !increasing(rhs_offsets, P, rhs_offsets[P])
+            || !increasing(lhs_offsets, N, P)) {
+            return;
+        }
+        // An empty slot, too, or a lookup of something missing never ends.
+        uint64_t used = 0;
+        for (uint64_t i = 0; i <= name_mask; ++i) {
+            if (name_slots[i] > S) { return; }
+            used += name_slots[i] != 0;
+        }
+        if (used >= uint64_t(name_mask) + 1) { return; }
+        if (!all_below(lhs_ids, P, 0, N) || !all_below(rhs_symbols, rhs_offsets[P], 0, S)
+            || !all_below(by_lhs, P, 0, P) || !all_below(ll1_table, N * (S - N + 1), -1, P)) {
+            return;
+        }
+
+        // Every base[row] + column has to land in the entries, and every
+        // value be a state or production there is: a shift to state s is
+        // s + 1 and a reduction by p is -(p + 1) (lr_parser.cpp).
+        auto table_fits = [&](const packed_view& t, section entries, uint64_t rows, uint64_t columns,
+                              bool (*valid)(int32_t, uint64_t, uint64_t)) {
+            uint64_t count = head->sections[entries].bytes / 8;
+            for (uint64_t r = 0; r < rows; ++r) {
+                if (t.base[r] < 0 || t.base[r] + columns > count || !valid(t.defaults[r], states, P)) { return false; }
+            }
+            for (uint64_t e = 0; e < count; ++e) {
+                if (t.entries[2*e] >= 0 && !valid(t.entries[2*e + 1], states, P)) { return false; }
+            }
+            return true;
+        };
+        auto valid_action = [](int32_t a, uint64_t states, uint64_t P) {
+            return a == lr_parser::accept_code || (a >= 0 && uint64_t(a) <= states)
+                || (a < 0 && uint64_t(-int64_t(a)) <= P);
+        };
+        auto valid_goto = [](int32_t s, uint64_t states, uint64_t) {
+            return s >= -1 && s < int64_t(states);
+        };
+        if (states == 0 || !table_fits(action, action_entries_section, states, S - N + 1, valid_action)
+            || !table_fits(go_to, goto_entries_section, N, states, valid_goto)) {
+            return;
+        }
+        ok = true;
+    }
+
+    uint64_t compiled_grammar::source_hash() const { return head->source_hash; }
+    bool compiled_grammar::ll1_conflicts() const { return head->flags & ll1_conflict_flag; }
+    bool compiled_grammar::lr_conflicts() const { return head->flags & lr_conflict_flag; }
+    int compiled_grammar::lr_state_count() const { return head->lr_states; }
+
+    span<char> compiled_grammar::name_of(symbol_id x) const {
+        return {name_text + name_offsets[x], name_text + name_offsets[x+1]};
+    }
+
+    symbol_id compiled_grammar::id_of(const char* name, size_t length) const {
+        for (size_t i = content_hash(name, name + length) & name_mask; ; i = (i + 1) & name_mask) {
+            if (name_slots[i] == 0) { return no_symbol; }
+            auto s = name_of(name_slots[i] - 1);
+            if (s.size() == length && memcmp(s.begin(), name, length) == 0) { return name_slots[i] - 1; }
+        }
+    }
+
+    // As ll1_parser::run.
+    bool compiled_grammar::ll1_recognize(span<symbol_id> input, size_t* error_at) const {
+        const symbol_id N = nonterminals;
+        const int end = terminal_count();
+        vector<symbol_id> stack;
+        stack.reserve(64);
+        stack.push_back(0);
+
+        unique_ptr<ll1_loop_guard> guard;
+        if (ll1_conflicts()) { guard.reset(new ll1_loop_guard(N)); }
+
+        size_t i = 0, n = input.size();
+        auto fail = [&]() {
+            if (error_at) { *error_at = i; }
+            return false;
+        };
+        while (stack.size()) {
+            auto X = stack.back();
+            stack.pop_back();
+            if (X >= N) {
+                if (i == n || input[i] != X) { return fail(); }
+                ++i;
+                if (guard) { guard->matched(); }
+                continue;
+            }
+            unsigned t = i < n ? input[i] - N : end;
+            if (t > unsigned(end)) { return fail(); }
+            int p = ll1_predict(X, t);
+            if (p < 0) { return fail(); }
+            if (guard && !guard->expanding(X, stack.size())) { return fail(); }
+            auto rhs = rhs_ids(p);
+            for (auto it = rhs.rbegin(); it != rhs.rend(); ++it) { stack.push_back(*it); }
+        }
+        if (i != n) { return fail(); }
+        return true;
+    }
+
+    // As lr_parser::run.
+    bool compiled_grammar::lr_recognize(span<symbol_id> input, size_t* error_at) const {
+        const symbol_id N = nonterminals;
+        const unsigned end = terminal_count();
+        vector<int> states;
+        states.reserve(256);
+        states.push_back(0);
+
+        size_t i = 0, n = input.size();
+        for (;;) {
+            unsigned t = i < n ? input[i] - N : end;
+            if (i < n ? t >= end : false) { break; }
+            auto a = lr_action(states.back(), t);
+            if (a > 0) {
+                states.push_back(a - 1);
+                ++i;
+            }
+            else if (a == lr_parser::accept_code) {
+                if (i == n) { return true; }
+                break;
+            }
+            else if (a < 0) {
+                // The tables are only known to be in range, not to agree
+                // with the grammar, so a pop too far or a missing goto is
+                // a syntax error.
+                int p = -a - 1;
+                if (size_t(rhs_size(p)) >= states.size()) { break; }
+                states.resize(states.size() - rhs_size(p));
+                int next = lr_goto(states.back(), lhs_id(p));
+                if (next < 0) { break; }
+                states.push_back(next);
+            }
+            else {
+                break;
+            }
+        }
+        if (error_at) { *error_at = i; }
+        return false;
+    }
+
+    grammar compiled_grammar::to_grammar() const {
+        auto name = [&](symbol_id x) {
+            auto s = name_of(x);
+            return symbol(s.begin(), s.end());
+        };
+        sequence<production> prods;
+        prods.reserve(productions);
+        for (int p = 0; p < productions; ++p) {
+            sequence<symbol> rhs;
+            for (auto x : rhs_ids(p)) { rhs.push_back(name(x)); }
+            prods.emplace_back(name(lhs_id(p)), move(rhs));
+        }
+        return grammar(prods);
+    }
+}
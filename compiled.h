@@ -0,0 +1,136 @@
+#ifndef COMPILED_H
+#define COMPILED_H
+
+//////////////////////////////////////////////////////////////////////////////
+// Compiled grammars: a grammar and everything we work out about it, written
+// to one binary file that the next process can map in and use as it is.
+//
+// The file is a fixed header followed by sections, each an array of plain
+// integers at an 8 byte aligned offset, so reading one is a pointer into the
+// mapping and nothing gets parsed, copied or allocated:
+//
+//   the interned grammar  names (offsets into one run of text) and an open
+//                         addressing table from name to ID, LHS IDs, the
+//                         CSR right hand sides, productions grouped by LHS
+//   the analyses          nullable, and FIRST/FOLLOW/PREDICT as bit_matrix
+//                         rows (first.h)
+//   LL(1)                 the dense predict table (ll1.h)
+//   LALR(1)               the packed ACTION and GOTO tables (lr_parser.h)
+//
+// The header starts with a magic string and a format version, which goes up
+// whenever the layout changes, and a byte order mark; a file from another
+// version or another kind of machine is simply not valid and gets rebuilt.
+// It also carries a hash of the text the grammar was read from, so a tool
+// can tell whether the compiled file is still up to date with its source
+// without reading the grammar at all (see compile_driver).
+//////////////////////////////////////////////////////////////////////////////
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+#include "cfg.h"
+#include "bitset.h"
+
+namespace cfg {
+    // A 64 bit hash of the bytes [first, last), for keying compiled files.
+    std::uint64_t content_hash(const char* first, const char* last);
+
+    // Runs the analyses and writes g out compiled. Returns false if the
+    // stream went bad.
+    bool write_compiled_grammar(std::ostream& o, const grammar& g, std::uint64_t source_hash);
+
+    class compiled_grammar {
+        public:
+            static const std::uint32_t version = 1;
+
+            // A view of the compiled grammar in [first, last), which has to
+            // stay put and be 8 byte aligned (as an mmap is). Checks the
+            // header and that every section fits; converts to false if not.
+            compiled_grammar(const char* first, const char* last);
+            explicit operator bool() const { return ok; }
+
+            std::uint64_t source_hash() const;
+
+            // Like grammar's interned view.
+            int size() const { return productions; }
+            int symbol_count() const { return symbols; }
+            int nonterminal_count() const { return nonterminals; }
+            int terminal_count() const { return symbols - nonterminals; }
+            bool is_terminal(symbol_id x) const { return x >= symbol_id(nonterminals); }
+            int terminal_index(symbol_id x) const { return x - nonterminals; }
+            span<char> name_of(symbol_id x) const;
+            // no_symbol if there's no such symbol.
+            symbol_id id_of(const char* name, std::size_t length) const;
+            symbol_id id_of(const std::string& name) const { return id_of(name.data(), name.size()); }
+            symbol_id lhs_id(int p) const { return lhs_ids[p]; }
+            span<symbol_id> rhs_ids(int p) const { return {rhs_symbols + rhs_offsets[p], rhs_symbols + rhs_offsets[p+1]}; }
+            int rhs_size(int p) const { return rhs_offsets[p+1] - rhs_offsets[p]; }
+            span<std::int32_t> production_indices(symbol_id A) const {
+                return {by_lhs + lhs_offsets[A], by_lhs + lhs_offsets[A+1]};
+            }
+
+            // Rows of set_words() words, as in first.h: FIRST and FOLLOW
+            // per symbol, PREDICT per production.
+            int set_words() const { return words; }
+            bool nullable(symbol_id x) const { return nullable_bytes[x]; }
+            const bits::word* first(symbol_id x) const { return first_rows + std::size_t(x) * words; }
+            const bits::word* follow(symbol_id x) const { return follow_rows + std::size_t(x) * words; }
+            const bits::word* predict(int p) const { return predict_rows + std::size_t(p) * words; }
+
+            // The LL(1) table as ll1_parser has it, and whether it had
+            // conflicts.
+            int ll1_predict(symbol_id A, int t) const { return ll1_table[std::size_t(A) * (terminal_count() + 1) + t]; }
+            bool ll1_conflicts() const;
+            // The LALR(1) tables as lr_parser has them.
+            int lr_state_count() const;
+            bool lr_conflicts() const;
+            std::int32_t lr_action(int state, int t) const { return action.get(state, t); }
+            int lr_goto(int state, symbol_id A) const { return go_to.get(A, state); }
+
+            // The same as ll1_parser's and lr_parser's, straight off the
+            // tables here.
+            bool ll1_recognize(span<symbol_id> input, std::size_t* error_at = nullptr) const;
+            bool lr_recognize(span<symbol_id> input, std::size_t* error_at = nullptr) const;
+
+            // Back to a grammar, for everything else.
+            grammar to_grammar() const;
+
+        private:
+            struct header;
+            friend bool write_compiled_grammar(std::ostream& o, const grammar& g, std::uint64_t source_hash);
+            // A packed_table, pointing into the file.
+            struct packed_view {
+                const std::int32_t* base = nullptr;
+                const std::int32_t* defaults = nullptr;
+                const std::int32_t* entries = nullptr;  // (check, value) pairs
+                std::int32_t get(int row, int column) const {
+                    auto e = entries + 2 * std::size_t(base[row] + column);
+                    return e[0] == row ? e[1] : defaults[row];
+                }
+            };
+
+            bool ok = false;
+            const header* head = nullptr;
+            int symbols = 0, nonterminals = 0, productions = 0, words = 0;
+            const std::uint32_t* name_offsets = nullptr;
+            const char* name_text = nullptr;
+            const std::uint32_t* name_slots = nullptr;
+            std::uint32_t name_mask = 0;
+            const symbol_id* lhs_ids = nullptr;
+            const std::uint32_t* rhs_offsets = nullptr;
+            const symbol_id* rhs_symbols = nullptr;
+            const std::int32_t* by_lhs = nullptr;
+            const std::uint32_t* lhs_offsets = nullptr;
+            const std::uint8_t* nullable_bytes = nullptr;
+            const bits::word* first_rows = nullptr;
+            const bits::word* follow_rows = nullptr;
+            const bits::word* predict_rows = nullptr;
+            const std::int32_t* ll1_table = nullptr;
+            packed_view action, go_to;
+    };
+}
+
+#endif
@@ -0,0 +1,176 @@
+#include "count.h"
+#include "first.h"
+
+#include <vector>
+#include <limits>
+#include <cassert>
+#include <utility>
+
+using namespace std;
+
+namespace cfg {
+    derivation_counter::derivation_counter(const grammar& g, int max_length): g(g), L(max_length) {
+        const int N = g.nonterminal_count();
+        shortest = compute_min_yield(g);
+        auto nullable = compute_nullable(g);
+        auto productive = [&](symbol_id x) { return shortest[x] != numeric_limits<int>::max(); };
+
+        offsets.assign(g.size() + 1, 0);
+        for (int p = 0; p < g.size(); ++p) { offsets[p+1] = offsets[p] + g.rhs_size(p); }
+        counts.assign(N * size_t(L + 1), bigint());
+        partial.assign(offsets.back() * size_t(L + 1), bigint());
+
+        // Which count(B, n) each count(A, n) needs: B in a production of A
+        // whose other symbols are all nullable. Productions that can't
+        // derive anything don't count.
+        vector<int> waiting(N, 0);
+        vector<vector<symbol_id>> needed_by(N);
+        for (int p = 0; p < g.size(); ++p) {
+            symbol_id A = g.lhs_id(p);
+            auto rhs = g.rhs_ids(p);
+            int solid = 0;
+            bool dead = false;
+            for (auto x : rhs) {
+                solid += !nullable[x];
+                dead |= !productive(x);
+            }
+            if (dead || solid > 1) { continue; }
+            for (auto x : rhs) {
+                if (g.is_terminal(x) || (solid && nullable[x])) { continue; }
+                ++waiting[A];
+                needed_by[x].push_back(A);
+            }
+        }
+        vector<symbol_id> order;
+        for (symbol_id A = 0; A < symbol_id(N); ++A) {
+            if (productive(A) && waiting[A] == 0) { order.push_back(A); }
+        }
+        for (size_t k = 0; k < order.size(); ++k) {
+            for (auto A : needed_by[order[k]]) {
+                if (--waiting[A] == 0) { order.push_back(A); }
+            }
+        }
+        int live = 0;
+        for (symbol_id A = 0; A < symbol_id(N); ++A) { live += productive(A); }
+        if (int(order.size()) < live) {
+            acyclic = false;
+            return;
+        }
+
+        // While A is being done, the counts of the nonterminals after it
+        // aren't final yet. A production's counts from the first of those
+        // on get done over once the whole length is.
+        vector<int> rank(N, -1);
+        for (size_t k = 0; k < order.size(); ++k) { rank[order[k]] = k; }
+        vector<int> redo(g.size(), 0);
+        for (int p = 0; p < g.size(); ++p) {
+            auto rhs = g.rhs_ids(p);
+            int i = 1;
+            for (; i <= int(rhs.size()); ++i) {
+                symbol_id x = rhs[i-1];
+                if (!g.is_terminal(x) && rank[x] >= rank[g.lhs_id(p)]) { break; }
+            }
+            redo[p] = i;
+        }
+
+        for (int n = 0; n <= L; ++n) {
+            for (auto A : order) {
+                bigint& total = counts[A * size_t(L + 1) + n];
+                for (auto p : g.production_indices(A)) {
+                    fill(p, 1, n);
+                    total += ways(p, g.rhs_size(p), n);
+                }
+            }
+            for (int p = 0; p < g.size(); ++p) {
+                if (redo[p] <= g.rhs_size(p)) { fill(p, redo[p], n); }
+            }
+        }
+    }
+
+    const bigint& derivation_counter::ways(int p, int i, int m) const {
+        static const bigint zero, one(1);
+        if (i == 0) { return m == 0 ? one : zero; }
+        return partial[(offsets[p] + i - 1) * size_t(L + 1) + m];
+    }
+
+    void derivation_counter::fill(int p, int from, int n) {
+        auto rhs = g.rhs_ids(p);
+        for (int i = from; i <= int(rhs.size()); ++i) {
+            bigint& w = at(p, i, n);
+            symbol_id x = rhs[i-1];
+            if (g.is_terminal(x)) {
+                w = n > 0 ? ways(p, i - 1, n - 1) : bigint();
+                continue;
+            }
+            w = bigint();
+            for (int j = shortest[x]; j <= n; ++j) {
+                w.add_product(ways(p, i - 1, n - j), counts[x * size_t(L + 1) + j]);
+            }
+        }
+    }
+
+    const bigint& derivation_counter::count(symbol_id x, int n) const {
+        static const bigint zero, one(1);
+        assert(0 <= n && n <= L);
+        if (g.is_terminal(x)) { return n == 1 ? one : zero; }
+        return counts[x * size_t(L + 1) + n];
+    }
+
+    const bigint& derivation_counter::count(int n) const {
+        static const bigint zero;
+        assert(0 <= n && n <= L);
+        if (g.size() == 0) { return zero; }
+        return count(0, n);
+    }
+
+    vector<int> derivation_counter::sample(symbol_id A, int n, mt19937_64& rng) const {
+        vector<int> derivation;
+        if (!acyclic || count(A, n).is_zero()) { return derivation; }
+
+        // What's left to derive, leftmost on top.
+        vector<pair<symbol_id, int>> stack{{A, n}};
+        vector<int> lengths;
+        while (stack.size()) {
+            symbol_id X = stack.back().first;
+            int m = stack.back().second;
+            stack.pop_back();
+            if (g.is_terminal(X)) { continue; }
+
+            bigint r = bigint::random_below(count(X, m), rng);
+            int p = -1;
+            for (auto q : g.production_indices(X)) {
+                const bigint& w = ways(q, g.rhs_size(q), m);
+                if (r < w) {
+                    p = q;
+                    break;
+                }
+                r -= w;
+            }
+            assert(p >= 0);
+            derivation.push_back(p);
+
+            // Split m between the symbols, last one first: Xi gets j with
+            // probability ways(p, i-1, m-j) * count(Xi, j) / ways(p, i, m).
+            auto rhs = g.rhs_ids(p);
+            lengths.assign(rhs.size(), 0);
+            for (int i = rhs.size(); i >= 1; --i) {
+                symbol_id x = rhs[i-1];
+                int j = m;
+                if (g.is_terminal(x)) { j = 1; }
+                else if (i > 1) {
+                    r = bigint::random_below(ways(p, i, m), rng);
+                    for (j = shortest[x]; ; ++j) {
+                        assert(j <= m);
+                        bigint w = ways(p, i - 1, m - j) * count(x, j);
+                        if (r < w) { break; }
+                        r -= w;
+                    }
+                }
+                lengths[i-1] = j;
+                m -= j;
+            }
+            for (int i = rhs.size(); i-- > 0; ) { stack.push_back({rhs[i], lengths[i]}); }
+        }
+        return derivation;
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef COUNT_H
+#define COUNT_H
+
+//////////////////////////////////////////////////////////////////////////////
+// How many derivations (parse trees) each nonterminal has for each length of
+// sentence, and drawing one of them uniformly at random, without
+// enumerating them like print_parse_trees does. For an unambiguous grammar
+// that's the number of sentences too; for an ambiguous one each sentence
+// counts once per tree.
+//
+// It's the usual dynamic programming (Hickey and Cohen, "Uniform random
+// generation of strings in a context-free language", SIAM J. Comput. 12,
+// 1983), done on the grammar as it is rather than on a normal form, so the
+// trees counted are the trees of this grammar. For each production
+// A -> X1 ... Xk and each i, ways(p, i, m) is the number of ways X1 ... Xi
+// derives m terminals:
+//
+//     ways(p, i, m) = sum over j of ways(p, i-1, m-j) * count(Xi, j)
+//     count(A, n)   = sum over A's productions p of ways(p, k, n)
+//
+// filled in one length at a time. That's O(|G| n^2) big additions and
+// multiplications for everything up to n. Within one length, count(A, n) can
+// need count(B, n) when A -> x B y with x and y nullable, so the
+// nonterminals get done in an order where B comes first. If there isn't one
+// (A derives A through such productions and derives something at all),
+// there are infinitely many trees for some length and finite() is false.
+//
+// Sampling walks back down the same tables: pick a production with
+// probability ways(p, k, n) / count(A, n), then split n between the
+// symbols from the right, and so on into each nonterminal. That's
+// polynomial too, and the result is a leftmost derivation, which
+// parse_tree(g, derivation) turns back into the tree.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <random>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "cfg.h"
+#include "bigint.h"
+
+namespace cfg {
+    class derivation_counter {
+        public:
+            const grammar& g;
+            // Counts everything up to max_length terminals.
+            derivation_counter(const grammar& g, int max_length);
+
+            int max_length() const { return L; }
+            // False if some nonterminal has infinitely many trees for some
+            // length, in which case the counts mean nothing.
+            bool finite() const { return acyclic; }
+
+            // The number of trees of symbol x with n terminals, n <= max_length().
+            // For a terminal that's 1 if n == 1 and 0 otherwise.
+            const bigint& count(symbol_id x, int n) const;
+            // The start symbol's, and none if the grammar has no
+            // productions (so no start symbol either).
+            const bigint& count(int n) const;
+
+            // A leftmost derivation from A of n terminals, uniformly among
+            // count(A, n) of them, or empty if there are none.
+            std::vector<int> sample(symbol_id A, int n, std::mt19937_64& rng) const;
+            std::vector<int> sample(int n, std::mt19937_64& rng) const {
+                if (g.size() == 0) { return {}; }
+                return sample(0, n, rng);
+            }
+
+        private:
+            int L;
+            bool acyclic = true;
+            // count(A, n) at A * (L + 1) + n.
+            std::vector<bigint> counts;
+            // The fewest terminals each symbol derives (first.h).
+            std::vector<int> shortest;
+            // ways(p, i, m) for i >= 1 at (offsets[p] + i - 1) * (L + 1) + m;
+            // ways(p, 0, m) is 1 for m == 0 and 0 otherwise.
+            std::vector<std::uint32_t> offsets;
+            std::vector<bigint> partial;
+
+            const bigint& ways(int p, int i, int m) const;
+            bigint& at(int p, int i, int m) {
+                return partial[(offsets[p] + i - 1) * std::size_t(L + 1) + m];
+            }
+            // Fill in ways(p, i, n) for i from `from` to the end.
+            void fill(int p, int from, int n);
+    };
+}
+
+#endif
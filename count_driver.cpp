@@ -0,0 +1,78 @@
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "cfg.h"
+#include "mapped_file.h"
+#include "arguments.h"
+#include "count.h"
+#include "parse_tree.h"
+
+// Counts the parse trees of the grammar in the given file for each sentence
+// length up to max_length, and with -s prints that many sentences of length
+// max_length drawn uniformly at random from its trees.
+// Usage: ./count_driver [-s samples] [-r seed] max_length grammar.cfg
+// The counts go to stdout, one "length count" line each, then the samples;
+// how long it all took goes to stderr.
+
+using namespace std;
+using namespace cfg;
+
+int main(int argc, char* argv[]) {
+    long samples = 0;
+    unsigned long seed = 1;
+    int arg = 1;
+    for (; arg < argc - 2; ++arg) {
+        string flag = argv[arg];
+        if (flag == "-s" && arg + 1 < argc - 2 && parse_number(argv[arg + 1], samples)) { ++arg; }
+        else if (flag == "-r" && arg + 1 < argc - 2 && parse_number(argv[arg + 1], seed)) { ++arg; }
+        else { break; }
+    }
+    int max_length = 0;
+    if (arg != argc - 2 || !parse_number(argv[arg], max_length)) {
+        cerr << "usage: " << argv[0] << " [-s samples] [-r seed] max_length grammar.cfg" << endl;
+        return 2;
+    }
+    if (max_length < 0) {
+        cerr << "max_length must be at least 0" << endl;
+        return 2;
+    }
+    mapped_file file(argv[arg + 1]);
+    if (!file) {
+        cerr << "can't open " << argv[arg + 1] << endl;
+        return 2;
+    }
+    auto G = parse_grammar(file.begin(), file.end());
+    if (G.size() == 0) {
+        cerr << argv[arg + 1] << ": empty grammar" << endl;
+        return 2;
+    }
+
+    auto start = chrono::steady_clock::now();
+    derivation_counter counter(G, max_length);
+    if (!counter.finite()) {
+        cerr << "some nonterminal derives itself, so there are infinitely many trees" << endl;
+        return 1;
+    }
+    chrono::duration<double> counting = chrono::steady_clock::now() - start;
+    for (int n = 0; n <= max_length; ++n) {
+        cout << n << " " << counter.count(n) << "\n";
+    }
+
+    start = chrono::steady_clock::now();
+    mt19937_64 rng(seed);
+    for (long s = 0; s < samples; ++s) {
+        auto derivation = counter.sample(max_length, rng);
+        if (derivation.empty()) {
+            cerr << "no sentences of length " << max_length << endl;
+            return 1;
+        }
+        parse_tree(G, derivation).print_leaves(cout);
+        cout << "\n";
+    }
+    chrono::duration<double> sampling = chrono::steady_clock::now() - start;
+    cerr << "counted up to length " << max_length << " in " << counting.count() * 1e3 << " ms";
+    if (samples) { cerr << ", sampled " << samples << " in " << sampling.count() * 1e3 << " ms"; }
+    cerr << endl;
+}
@@ -0,0 +1,292 @@
+#include "cyk.h"
+
+#include <tuple>
+#include <cassert>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <unordered_map>
+
+using namespace std;
+
+namespace cfg {
+    namespace {
+        // While converting, a terminal t of g is terminal_flag | t, so it
+        // can't be confused with the fresh nonterminals.
+        const symbol_id terminal_flag = symbol_id(1) << 31;
+        bool is_terminal(symbol_id x) { return x & terminal_flag; }
+
+        // Everything is at most two long after binarizing.
+        struct rule {
+            symbol_id lhs;
+            int size;
+            symbol_id rhs[2];
+            bool operator<(const rule& r) const {
+                return tie(lhs, size, rhs[0], rhs[1]) < tie(r.lhs, r.size, r.rhs[0], r.rhs[1]);
+            }
+            bool operator==(const rule& r) const {
+                return !(*this < r) && !(r < *this);
+            }
+        };
+    }
+
+    cnf_grammar::cnf_grammar(const grammar& g): g(g) {
+        const int N = g.nonterminal_count();
+        for (symbol_id A = 0; A < symbol_id(N); ++A) { names.push_back(g.name_of(A)); }
+
+        unordered_map<symbol, int> suffixes;
+        auto fresh = [&](const symbol& base) {
+            for (int& k = suffixes[base]; ; ) {
+                symbol s = base + "." + to_string(++k);
+                if (g.id_of(s) == no_symbol) {
+                    names.push_back(s);
+                    return symbol_id(names.size() - 1);
+                }
+            }
+        };
+        auto encode = [&](symbol_id x) {
+            return g.is_terminal(x) ? terminal_flag | g.terminal_index(x) : x;
+        };
+
+        // 1) Binarize.
+        vector<rule> rules;
+        for (int p = 0; p < g.size(); ++p) {
+            symbol_id A = g.lhs_id(p);
+            auto rhs = g.rhs_ids(p);
+            int k = rhs.size();
+            if (k <= 2) {
+                rules.push_back({A, k, {k > 0 ? encode(rhs[0]) : 0, k > 1 ? encode(rhs[1]) : 0}});
+                continue;
+            }
+            symbol_id lhs = A;
+            for (int i = 0; i + 2 < k; ++i) {
+                symbol_id rest = fresh(g.name_of(A));
+                rules.push_back({lhs, 2, {encode(rhs[i]), rest}});
+                lhs = rest;
+            }
+            rules.push_back({lhs, 2, {encode(rhs[k-2]), encode(rhs[k-1])}});
+        }
+
+        // 2) Epsilon rules. Nullable first, by counting down each rule's
+        // symbols not yet known to be nullable.
+        int M = names.size();
+        vector<bool> nullable(M, false);
+        {
+            vector<int> remaining(rules.size());
+            vector<vector<int>> occurs(M);
+            vector<symbol_id> work;
+            for (size_t r = 0; r < rules.size(); ++r) {
+                auto& R = rules[r];
+                remaining[r] = R.size;
+                for (int i = 0; i < R.size; ++i) {
+                    // A terminal never counts down, so the rule never fires.
+                    if (!is_terminal(R.rhs[i])) { occurs[R.rhs[i]].push_back(r); }
+                }
+                if (R.size == 0 && !nullable[R.lhs]) {
+                    nullable[R.lhs] = true;
+                    work.push_back(R.lhs);
+                }
+            }
+            while (work.size()) {
+                symbol_id B = work.back();
+                work.pop_back();
+                for (auto r : occurs[B]) {
+                    symbol_id A = rules[r].lhs;
+                    if (--remaining[r] == 0 && !nullable[A]) {
+                        nullable[A] = true;
+                        work.push_back(A);
+                    }
+                }
+            }
+        }
+        empty = N > 0 && nullable[0];
+        auto can_vanish = [&](symbol_id x) { return !is_terminal(x) && nullable[x]; };
+
+        vector<rule> no_epsilon;
+        for (auto& R : rules) {
+            if (R.size == 0) { continue; }
+            no_epsilon.push_back(R);
+            if (R.size == 2) {
+                if (can_vanish(R.rhs[0])) { no_epsilon.push_back({R.lhs, 1, {R.rhs[1], 0}}); }
+                if (can_vanish(R.rhs[1])) { no_epsilon.push_back({R.lhs, 1, {R.rhs[0], 0}}); }
+            }
+        }
+
+        // 3) Unit rules. Everything each A reaches by unit rules (A itself
+        // included), then A gets their other rules.
+        auto is_unit = [](const rule& R) { return R.size == 1 && !is_terminal(R.rhs[0]); };
+        vector<vector<symbol_id>> units(M);
+        for (auto& R : no_epsilon) {
+            if (is_unit(R)) { units[R.lhs].push_back(R.rhs[0]); }
+        }
+        vector<rule> others;
+        for (auto& R : no_epsilon) {
+            if (!is_unit(R)) { others.push_back(R); }
+        }
+        sort(others.begin(), others.end());
+        others.erase(unique(others.begin(), others.end()), others.end());
+        vector<uint32_t> others_from(M + 1, 0);
+        for (auto& R : others) { ++others_from[R.lhs + 1]; }
+        for (int A = 0; A < M; ++A) { others_from[A+1] += others_from[A]; }
+
+        vector<rule> no_units;
+        bit_matrix reached(M, M);
+        vector<symbol_id> stack;
+        for (symbol_id A = 0; A < symbol_id(M); ++A) {
+            reached.set(A, A);
+            stack.assign(1, A);
+            while (stack.size()) {
+                symbol_id B = stack.back();
+                stack.pop_back();
+                for (auto C : units[B]) {
+                    if (reached.set(A, C)) { stack.push_back(C); }
+                }
+            }
+            reached.for_each(A, [&](int B) {
+                for (auto r = others_from[B]; r < others_from[B+1]; ++r) {
+                    no_units.push_back({A, others[r].size, {others[r].rhs[0], others[r].rhs[1]}});
+                }
+            });
+        }
+        sort(no_units.begin(), no_units.end());
+        no_units.erase(unique(no_units.begin(), no_units.end()), no_units.end());
+
+        // 4) Terminals in binary rules get a nonterminal each.
+        vector<symbol_id> wrapper(g.terminal_count(), no_symbol);
+        vector<pair<symbol_id, int>> terminal_rules;
+        for (auto& R : no_units) {
+            if (R.size == 1) {
+                terminal_rules.push_back({R.lhs, R.rhs[0] & ~terminal_flag});
+                continue;
+            }
+            symbol_id rhs[2];
+            for (int i = 0; i < 2; ++i) {
+                rhs[i] = R.rhs[i];
+                if (!is_terminal(rhs[i])) { continue; }
+                int t = rhs[i] & ~terminal_flag;
+                if (wrapper[t] == no_symbol) {
+                    wrapper[t] = fresh(g.name_of(g.terminal_id(t)));
+                    terminal_rules.push_back({wrapper[t], t});
+                }
+                rhs[i] = wrapper[t];
+            }
+            binary.push_back({R.lhs, rhs[0], rhs[1]});
+        }
+
+        terminals = bit_matrix(g.terminal_count(), names.size());
+        for (auto& r : terminal_rules) { terminals.set(r.second, r.first); }
+    }
+
+    sequence<production> cnf_grammar::productions() const {
+        // By LHS, so the start symbol comes first: (lhs, binary rule or
+        // terminal index + binary.size()).
+        vector<pair<symbol_id, int>> order;
+        for (size_t r = 0; r < binary.size(); ++r) { order.push_back({binary[r].lhs, r}); }
+        for (int t = 0; t < terminals.rows(); ++t) {
+            terminals.for_each(t, [&](int A) { order.push_back({symbol_id(A), int(binary.size()) + t}); });
+        }
+        stable_sort(order.begin(), order.end(),
+                    [](const pair<symbol_id, int>& a, const pair<symbol_id, int>& b) { return a.first < b.first; });
+
+        sequence<production> prods;
+        for (auto& o : order) {
+            int r = o.second;
+            if (r < int(binary.size())) {
+                prods.push_back({names[o.first], names[binary[r].left], names[binary[r].right]});
+            }
+            else {
+                prods.push_back({names[o.first], g.name_of(g.terminal_id(r - binary.size()))});
+            }
+        }
+        return prods;
+    }
+
+    ostream& operator<<(ostream& o, const cnf_grammar& cnf) {
+        if (cnf.accepts_empty()) {
+            o << production(cnf.name_of(0), {}) << endl;
+        }
+        for (auto& p : cnf.productions()) {
+            o << p << endl;
+        }
+        return o;
+    }
+
+    bool cyk_chart::derives(symbol_id A, size_t i, size_t j) const {
+        assert(i < j && j <= n);
+        return bits::test(cell(i, j - i), A);
+    }
+
+    cyk_parser::cyk_parser(const grammar& g): g(g), normal_form(g) {
+        int M = normal_form.nonterminal_count();
+        auto rules = normal_form.binary_rules();
+        sort(rules.begin(), rules.end(), [](const cnf_grammar::binary_rule& a, const cnf_grammar::binary_rule& b) {
+            return tie(a.left, a.right) < tie(b.left, b.right);
+        });
+
+        // One pair per distinct (B, C).
+        int pairs = 0;
+        for (size_t r = 0; r < rules.size(); ++r) {
+            if (r == 0 || rules[r].left != rules[r-1].left || rules[r].right != rules[r-1].right) { ++pairs; }
+        }
+        partners = bit_matrix(M, M);
+        parents = bit_matrix(pairs, M);
+        pair_offsets.assign(M + 1, 0);
+        for (size_t r = 0; r < rules.size(); ++r) {
+            auto& R = rules[r];
+            if (r == 0 || R.left != rules[r-1].left || R.right != rules[r-1].right) {
+                pair_right.push_back(R.right);
+                partners.set(R.left, R.right);
+                ++pair_offsets[R.left + 1];
+            }
+            parents.set(pair_right.size() - 1, R.lhs);
+        }
+        for (int B = 0; B < M; ++B) { pair_offsets[B+1] += pair_offsets[B]; }
+    }
+
+    cyk_chart cyk_parser::chart(span<symbol_id> input) const {
+        cyk_chart c;
+        size_t n = input.size();
+        c.n = n;
+        c.words = partners.words_per_row();
+        c.cells.assign(n * (n + 1) / 2 * c.words, 0);
+        int words = c.words;
+
+        auto& terminals = normal_form.terminal_rules();
+        for (size_t i = 0; i < n; ++i) {
+            symbol_id x = input[i];
+            if (x >= symbol_id(g.symbol_count()) || !g.is_terminal(x)) { continue; }
+            auto from = terminals.row(g.terminal_index(x));
+            copy(from, from + words, c.cell(i, 1));
+        }
+
+        for (size_t len = 2; len <= n; ++len) {
+            for (size_t i = 0; i + len <= n; ++i) {
+                bits::word* d = c.cell(i, len);
+                for (size_t k = 1; k < len; ++k) {
+                    const bits::word* left = c.cell(i, k);
+                    const bits::word* right = c.cell(i + k, len - k);
+                    bits::for_each(left, words, [&](int B) {
+                        if (!bits::intersects(right, partners.row(B), words)) { return; }
+                        for (auto q = pair_offsets[B]; q < pair_offsets[B+1]; ++q) {
+                            if (bits::test(right, pair_right[q])) {
+                                bits::or_words(d, parents.row(q), words);
+                            }
+                        }
+                    });
+                }
+            }
+        }
+        return c;
+    }
+
+    bool cyk_parser::recognize(span<symbol_id> input) const {
+        if (input.empty()) { return normal_form.accepts_empty(); }
+        // No point filling in a chart if some token can't even start.
+        auto& terminals = normal_form.terminal_rules();
+        for (auto x : input) {
+            if (x >= symbol_id(g.symbol_count()) || !g.is_terminal(x)) { return false; }
+            if (!terminals.count(g.terminal_index(x))) { return false; }
+        }
+        return chart(input).derives(0, 0, input.size());
+    }
+}
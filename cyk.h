@@ -0,0 +1,123 @@
+#ifndef CYK_H
+#define CYK_H
+
+//////////////////////////////////////////////////////////////////////////////
+// Cocke-Younger-Kasami recognition, after converting the grammar to Chomsky
+// normal form.
+//
+// CNF means every rule is A -> B C or A -> a, plus possibly S -> epsilon,
+// which we keep to the side as a flag. The conversion goes in the order Lange
+// and Leiss recommend ("To CNF or not to CNF?", 2009), which keeps it from
+// blowing up:
+//   1) Binarize: A -> X1 X2 ... Xk becomes A -> X1 A.1, A.1 -> X2 A.2, ...,
+//      with fresh nonterminals, so nothing is longer than 2.
+//   2) Take out epsilon rules: each A -> X Y also gives A -> Y if X is
+//      nullable and A -> X if Y is. With rules that short that's at most
+//      three rules where there was one.
+//   3) Take out unit rules A -> B: A gets every non-unit rule of everything
+//      it reaches through unit rules.
+//   4) Terminals in binary rules get a fresh nonterminal of their own.
+// The original nonterminals keep their IDs; the fresh ones come after them.
+//
+// The chart is the usual triangle, one cell per span of the input, and a
+// cell is a bitset of nonterminals. Cells of the same length are stored
+// together. For each split of a span, we go over the nonterminals B of the
+// left part, AND the right part with the C's that B has rules A -> B C for,
+// and OR in the A's of each pair that's left. That's O(n^3) whatever the
+// grammar, with the inner loops a word at a time, so it's a fair baseline
+// for the other parsers on very ambiguous grammars.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+#include "cfg.h"
+#include "bitset.h"
+
+namespace cfg {
+    class cnf_grammar {
+        public:
+            const grammar& g;
+            explicit cnf_grammar(const grammar& g);
+
+            struct binary_rule {
+                symbol_id lhs;
+                symbol_id left;
+                symbol_id right;
+            };
+
+            // Nonterminals [0, g.nonterminal_count()) are g's, the rest
+            // are fresh.
+            int nonterminal_count() const { return names.size(); }
+            const symbol& name_of(symbol_id A) const { return names[A]; }
+            // Whether the start symbol derives epsilon.
+            bool accepts_empty() const { return empty; }
+
+            const std::vector<binary_rule>& binary_rules() const { return binary; }
+            // Row t (a terminal index of g) is the nonterminals A with A -> t.
+            const bit_matrix& terminal_rules() const { return terminals; }
+
+            // The rules as productions over the names, binary ones first,
+            // without S -> epsilon.
+            sequence<production> productions() const;
+
+        private:
+            std::vector<symbol> names;
+            bool empty = false;
+            std::vector<binary_rule> binary;
+            bit_matrix terminals;
+    };
+
+    std::ostream& operator<<(std::ostream& o, const cnf_grammar& cnf);
+
+    class cyk_parser;
+
+    class cyk_chart {
+        public:
+            std::size_t length() const { return n; }
+            // Does nonterminal A (of the CNF grammar) derive the input from
+            // i up to j? Only for i < j: the empty string is accepts_empty().
+            bool derives(symbol_id A, std::size_t i, std::size_t j) const;
+
+        private:
+            friend class cyk_parser;
+            std::size_t n = 0;
+            int words = 0;
+            std::vector<bits::word> cells;
+
+            // The first cell of spans of length len.
+            std::size_t base(std::size_t len) const { return (len - 1) * (n + 1) - (len - 1) * len / 2; }
+            bits::word* cell(std::size_t i, std::size_t len) {
+                return cells.data() + (base(len) + i) * words;
+            }
+            const bits::word* cell(std::size_t i, std::size_t len) const {
+                return cells.data() + (base(len) + i) * words;
+            }
+    };
+
+    class cyk_parser {
+        public:
+            const grammar& g;
+            explicit cyk_parser(const grammar& g);
+
+            const cnf_grammar& cnf() const { return normal_form; }
+
+            cyk_chart chart(span<symbol_id> input) const;
+            bool recognize(span<symbol_id> input) const;
+
+        private:
+            cnf_grammar normal_form;
+            // Row B: the C's with some rule A -> B C.
+            bit_matrix partners;
+            // For each B, [pair_offsets[B], pair_offsets[B+1]) into
+            // pair_right and parents: each C it pairs with and the A's of
+            // those rules.
+            std::vector<std::uint32_t> pair_offsets;
+            std::vector<symbol_id> pair_right;
+            bit_matrix parents;
+    };
+}
+
+#endif
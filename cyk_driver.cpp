@@ -0,0 +1,73 @@
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "cfg.h"
+#include "mapped_file.h"
+#include "arguments.h"
+#include "cyk.h"
+
+// CYK recognizes the tokens on stdin with the grammar in the given file,
+// after putting it in Chomsky normal form.
+// Usage: ./cyk_driver [-c] [-b repeats] grammar.cfg < tokens
+// Tokens are terminal names separated by whitespace. With -c the CNF grammar
+// gets printed first; with -b we just recognize the input that many times
+// and report the throughput.
+
+using namespace std;
+using namespace cfg;
+
+int main(int argc, char* argv[]) {
+    bool print_cnf = false;
+    long repeats = 0;
+    int arg = 1;
+    for (; arg < argc - 1; ++arg) {
+        string flag = argv[arg];
+        if (flag == "-c") { print_cnf = true; }
+        else if (flag == "-b" && arg + 1 < argc - 1 && parse_number(argv[arg + 1], repeats)) { ++arg; }
+        else { break; }
+    }
+    if (arg != argc - 1) {
+        cerr << "usage: " << argv[0] << " [-c] [-b repeats] grammar.cfg < tokens" << endl;
+        return 2;
+    }
+    mapped_file file(argv[arg]);
+    if (!file) {
+        cerr << "can't open " << argv[arg] << endl;
+        return 2;
+    }
+
+    auto G = parse_grammar(file.begin(), file.end());
+    cyk_parser parser(G);
+    if (print_cnf) {
+        cout << parser.cnf() << endl;
+    }
+
+    vector<symbol_id> tokens;
+    string bad;
+    if (!read_tokens(G, cin, tokens, &bad)) {
+        cerr << "unknown token " << bad << endl;
+        return 1;
+    }
+    span<symbol_id> input{tokens.data(), tokens.data() + tokens.size()};
+
+    if (repeats > 0) {
+        cout << parser.cnf().nonterminal_count() << " nonterminals, "
+             << parser.cnf().binary_rules().size() << " binary rules in CNF" << endl;
+        auto start = chrono::steady_clock::now();
+        long accepted = 0;
+        for (long r = 0; r < repeats; ++r) {
+            accepted += parser.recognize(input);
+        }
+        chrono::duration<double> took = chrono::steady_clock::now() - start;
+        cout << accepted << "/" << repeats << " accepted, "
+             << tokens.size() * repeats / took.count() / 1e6 << " million tokens/s" << endl;
+        return accepted == repeats ? 0 : 1;
+    }
+
+    if (!parser.recognize(input)) {
+        cout << "rejected" << endl;
+        return 1;
+    }
+    cout << "accepted" << endl;
+}
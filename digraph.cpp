@@ -0,0 +1,89 @@
+#include "digraph.h"
+
+#include <climits>
+#include <algorithm>
+
+#include "stats.h"
+
+using namespace std;
+
+namespace cfg {
+    relation::relation(int nodes, const vector<pair<int, int>>& edges):
+        offsets(nodes + 1, 0), targets(edges.size()) {
+        for (auto&& e : edges) { ++offsets[e.first + 1]; }
+        for (int x = 0; x < nodes; ++x) { offsets[x+1] += offsets[x]; }
+        auto fill = offsets;
+        for (auto&& e : edges) { targets[fill[e.first]++] = e.second; }
+    }
+
+    // This is the paper's recursive "traverse", with the recursion turned
+    // into an explicit stack so that long chains of nonterminals can't
+    // blow the call stack.
+    void digraph(const relation& R, bit_matrix& F) {
+        CFG_PHASE("digraph");
+        const int n = R.size();
+        const int done = INT_MAX;
+        vector<int> N(n, 0);
+        vector<int> S;
+        // Every active traverse call: its node, the next edge to look
+        // at, and the stack depth the node was pushed at.
+        struct frame { int x; int edge; int depth; };
+        vector<frame> calls;
+
+        auto call = [&](int x) {
+            S.push_back(x);
+            N[x] = S.size();
+            calls.push_back({x, R.offsets[x], N[x]});
+        };
+
+        for (int root = 0; root < n; ++root) {
+            if (N[root] != 0) { continue; }
+            call(root);
+
+            while (calls.size()) {
+                frame& f = calls.back();
+                int x = f.x;
+                if (f.edge < R.offsets[x+1]) {
+                    int y = R.targets[f.edge];
+                    if (N[y] == 0) {
+                        // "Recurse"; we finish this edge when y returns.
+                        call(y);
+                        continue;
+                    }
+                    N[x] = min(N[x], N[y]);
+                    CFG_COUNT("digraph.unions");
+                    bool grew = F.or_row(x, y);
+                    CFG_ADD("digraph.new_unions", grew);
+                    ++f.edge;
+                    continue;
+                }
+
+                // x is finished. If it's the root of its SCC, everything
+                // above it on the stack is in the SCC and gets its set.
+                if (N[x] == f.depth) {
+                    CFG_COUNT("digraph.components");
+                    for (;;) {
+                        int top = S.back();
+                        S.pop_back();
+                        N[top] = done;
+                        if (top == x) { break; }
+                        CFG_COUNT("digraph.unions");
+                        bool grew = F.or_row(top, x);
+                        CFG_ADD("digraph.new_unions", grew);
+                    }
+                }
+                calls.pop_back();
+
+                // Back in the caller: finish the edge that led to x.
+                if (calls.size()) {
+                    frame& caller = calls.back();
+                    N[caller.x] = min(N[caller.x], N[x]);
+                    CFG_COUNT("digraph.unions");
+                    bool grew = F.or_row(caller.x, x);
+                    CFG_ADD("digraph.new_unions", grew);
+                    ++caller.edge;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef DIGRAPH_H
+#define DIGRAPH_H
+
+//////////////////////////////////////////////////////////////////////////////
+// The "digraph" algorithm from DeRemer and Pennello's LALR(1) paper
+// (TOPLAS 4(4), 1982). Given a relation R over nodes [0, n) and an initial
+// set F'(x) for each node, it computes the smallest F with
+//
+//     F(x) = F'(x) u U{ F(y) | x R y }
+//
+// in a single depth-first traversal: it's Tarjan's SCC algorithm, where all
+// the nodes of a strongly connected component end up sharing one set. So
+// the cost is linear in the size of the relation (times the set width),
+// rather than re-sweeping everything until nothing changes.
+//
+// FIRST, FOLLOW and the LALR lookaheads are all instances of this.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <utility>
+
+#include "bitset.h"
+
+namespace cfg {
+    // A relation stored CSR-style: the successors of x are
+    // targets[offsets[x]...offsets[x+1]).
+    struct relation {
+        std::vector<int> offsets;
+        std::vector<int> targets;
+
+        relation(int nodes, const std::vector<std::pair<int, int>>& edges);
+        int size() const { return offsets.size() - 1; }
+    };
+
+    // F holds F'(x) in row x on entry, and F(x) on return.
+    void digraph(const relation& R, bit_matrix& F);
+}
+
+#endif
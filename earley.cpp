@@ -0,0 +1,374 @@
+#include "earley.h"
+
+#include <vector>
+#include <cassert>
+#include <algorithm>
+#include <unordered_map>
+
+#include "first.h"
+
+using namespace std;
+
+namespace cfg {
+    namespace {
+        bool operator==(earley_item a, earley_item b) {
+            return a.rule == b.rule && a.origin == b.origin;
+        }
+
+        // Open addressing hash index over the items of the set being built,
+        // mapping an item to where it lives in the items array.
+        class item_index {
+            vector<int32_t> slots;
+            vector<uint32_t> used;
+            uint32_t mask;
+
+            static uint32_t hash(earley_item it) {
+                return (it.rule * 0x9E3779B1u) ^ (it.origin * 0x85EBCA77u);
+            }
+            void grow(const vector<earley_item>& items) {
+                vector<uint32_t> old;
+                old.swap(used);
+                vector<int32_t> values;
+                for (auto h : old) { values.push_back(slots[h]); }
+                slots.assign(slots.size() * 2, -1);
+                mask = slots.size() - 1;
+                for (auto v : values) {
+                    uint32_t h = hash(items[v]) & mask;
+                    while (slots[h] >= 0) { h = (h + 1) & mask; }
+                    slots[h] = v;
+                    used.push_back(h);
+                }
+            }
+
+            public:
+            item_index(): slots(1024, -1), mask(1023) {}
+
+            // If it is already in the set, where; otherwise records that it's
+            // about to go in at position at, and returns -1.
+            int32_t find_or_insert(const vector<earley_item>& items, earley_item it, int32_t at) {
+                if (used.size() * 2 >= slots.size()) { grow(items); }
+                uint32_t h = hash(it) & mask;
+                while (slots[h] >= 0) {
+                    if (items[slots[h]] == it) { return slots[h]; }
+                    h = (h + 1) & mask;
+                }
+                slots[h] = at;
+                used.push_back(h);
+                return -1;
+            }
+            void clear() {
+                for (auto h : used) { slots[h] = -1; }
+                used.clear();
+            }
+        };
+    }
+
+    earley_parser::earley_parser(const grammar& g, bool use_leo):
+        g(g), use_leo(use_leo), nullable(compute_nullable(g)) {
+        for (int p = 0; p < g.size(); ++p) {
+            rule_base.push_back(next_symbol.size());
+            auto rhs = g.rhs_ids(p);
+            for (size_t dot = 0; dot <= rhs.size(); ++dot) {
+                next_symbol.push_back(dot < rhs.size() ? rhs[dot] : no_symbol);
+                rule_production.push_back(p);
+                rule_lhs.push_back(g.lhs_id(p));
+            }
+        }
+        goal_rule = next_symbol.size();
+        for (auto X : {symbol_id(0), no_symbol}) {
+            next_symbol.push_back(X);
+            rule_production.push_back(-1);
+            rule_lhs.push_back(g.symbol_count());
+        }
+
+        // A nonterminal gets an epsilon production once everything on its
+        // right hand side has one, so following them always bottoms out.
+        epsilon_production.assign(g.nonterminal_count(), -1);
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int p = 0; p < g.size(); ++p) {
+                if (epsilon_production[g.lhs_id(p)] >= 0) { continue; }
+                auto rhs = g.rhs_ids(p);
+                if (all_of(rhs.begin(), rhs.end(), [&](symbol_id X) {
+                    return g.is_nonterminal(X) && epsilon_production[X] >= 0;
+                })) {
+                    epsilon_production[g.lhs_id(p)] = p;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    earley_chart earley_parser::chart(span<symbol_id> input, bool keep_links) const {
+        earley_chart c;
+        auto& items = c.items;
+        item_index index;
+        typedef earley_chart::link link;
+
+        auto add = [&](uint32_t rule, uint32_t origin, link l) {
+            earley_item it{rule, origin};
+            if (index.find_or_insert(items, it, items.size()) >= 0) { return; }
+            items.push_back(it);
+            if (keep_links) { c.links.push_back(l); }
+        };
+
+        // The items of finished set k waiting on X.
+        auto waiting = [&](int k, symbol_id X) {
+            auto first = c.by_next.data() + c.by_next_offsets[k];
+            auto last = c.by_next.data() + c.by_next_offsets[k+1];
+            first = lower_bound(first, last, X, [&](uint32_t x, symbol_id X) {
+                return next_symbol[items[x].rule] < X;
+            });
+            last = upper_bound(first, last, X, [&](symbol_id X, uint32_t x) {
+                return X < next_symbol[items[x].rule];
+            });
+            return span<uint32_t>{first, last};
+        };
+
+        // Leo's memo for (set k, nonterminal A), or -1 if the completion
+        // isn't deterministic there. We walk down the chain until we find a
+        // memo or the end, then fill in memos on the way back up.
+        unordered_map<uint64_t, int32_t> leo_memos;
+        const int32_t in_progress = -2;
+        vector<pair<uint64_t, int32_t>> path;  // (key, waiting item)
+        auto leo = [&](uint32_t k, symbol_id A) {
+            int32_t result = -1;
+            for (;;) {
+                uint64_t key = uint64_t(k) << 32 | A;
+                auto found = leo_memos.find(key);
+                if (found != leo_memos.end()) {
+                    // A unit rule cycle: not deterministic after all.
+                    result = found->second == in_progress ? -1 : found->second;
+                    break;
+                }
+                auto w = waiting(k, A);
+                if (w.size() != 1 || next_symbol[items[w[0]].rule + 1] != no_symbol) {
+                    leo_memos[key] = -1;
+                    break;
+                }
+                leo_memos[key] = in_progress;
+                path.push_back({key, int32_t(w[0])});
+                auto& waiter = items[w[0]];
+                A = rule_lhs[waiter.rule];
+                k = waiter.origin;
+            }
+            while (path.size()) {
+                auto key = path.back().first;
+                auto w = path.back().second;
+                path.pop_back();
+                earley_chart::leo_memo m{w, result, {items[w].rule + 1, items[w].origin}};
+                if (result >= 0) { m.top = c.memos[result].top; }
+                result = c.memos.size();
+                c.memos.push_back(m);
+                leo_memos[key] = result;
+            }
+            return result;
+        };
+
+        vector<int> predicted(g.nonterminal_count(), -1);
+        const symbol_id N = g.nonterminal_count();
+        size_t n = input.size();
+
+        add(goal_rule, 0, {link::predict, -1, -1});
+        for (size_t k = 0; ; ++k) {
+            for (size_t x = c.set_offsets[k]; x < items.size(); ++x) {
+                auto it = items[x];
+                auto X = next_symbol[it.rule];
+                if (X == no_symbol) {
+                    // Aycock and Horspool took care of the ones from here.
+                    if (it.origin == k) { continue; }
+                    auto A = rule_lhs[it.rule];
+                    int32_t m = use_leo ? leo(it.origin, A) : -1;
+                    if (m >= 0) {
+                        auto top = c.memos[m].top;
+                        add(top.rule, top.origin, {link::leo, int32_t(x), m});
+                    }
+                    else {
+                        for (auto w : waiting(it.origin, A)) {
+                            add(items[w].rule + 1, items[w].origin, {link::complete, int32_t(w), int32_t(x)});
+                        }
+                    }
+                }
+                else if (X < N) {
+                    if (predicted[X] != int(k)) {
+                        predicted[X] = k;
+                        for (auto p : g.production_indices(X)) {
+                            add(rule_base[p], k, {link::predict, -1, -1});
+                        }
+                    }
+                    if (nullable[X]) {
+                        add(it.rule + 1, it.origin, {link::nullable, int32_t(x), -1});
+                    }
+                }
+            }
+
+            // Done with set k: index it by the symbol after the dot.
+            auto start = c.set_offsets[k];
+            c.set_offsets.push_back(items.size());
+            auto first = c.by_next.size();
+            for (size_t x = start; x < items.size(); ++x) {
+                if (next_symbol[items[x].rule] != no_symbol) { c.by_next.push_back(x); }
+            }
+            sort(c.by_next.begin() + first, c.by_next.end(), [&](uint32_t x, uint32_t y) {
+                auto X = next_symbol[items[x].rule], Y = next_symbol[items[y].rule];
+                return X < Y || (X == Y && x < y);
+            });
+            c.by_next_offsets.push_back(c.by_next.size());
+
+            if (k == n) {
+                c.accepted = index.find_or_insert(items, {uint32_t(goal_rule + 1), 0}, -1) >= 0;
+                c.error_at = n;
+                break;
+            }
+
+            index.clear();
+            // Only terminals get scanned.
+            if (input[k] >= N && input[k] < symbol_id(g.symbol_count())) {
+                for (auto w : waiting(k, input[k])) {
+                    add(items[w].rule + 1, items[w].origin, {link::scan, int32_t(w), -1});
+                }
+            }
+            if (items.size() == c.set_offsets[k+1]) {
+                c.error_at = k;
+                c.set_offsets.push_back(items.size());
+                break;
+            }
+        }
+        return c;
+    }
+
+    bool earley_parser::recognize(span<symbol_id> input, size_t* error_at) const {
+        auto c = chart(input);
+        if (!c.accepted && error_at) { *error_at = c.error_at; }
+        return c.accepted;
+    }
+
+    bool earley_parser::parse(span<symbol_id> input, vector<int>& d, size_t* error_at) const {
+        auto c = chart(input, true);
+        if (!c.accepted) {
+            if (error_at) { *error_at = c.error_at; }
+            return false;
+        }
+        d = derivation(c);
+        return true;
+    }
+
+    parse_tree earley_parser::parse(span<symbol_id> input, size_t* error_at) const {
+        vector<int> d;
+        if (!parse(input, d, error_at)) { return parse_tree(g); }
+        return parse_tree(g, d);
+    }
+
+    vector<int> earley_parser::derivation(const earley_chart& c) const {
+        assert(c.accepted && c.links.size() == c.items.size());
+        typedef earley_chart::link link;
+        auto& items = c.items;
+
+        // Something a tree node comes from: a complete item, a level of an
+        // unwound Leo chain, or a nullable nonterminal deriving epsilon.
+        struct source {
+            enum { item, chain, epsilon } kind;
+            int a;
+            int b;
+        };
+        struct node {
+            int production;
+            vector<int> kids;  // the nonterminal children, in order
+        };
+        vector<node> nodes;
+        vector<pair<int, source>> pending;
+        // A Leo chain is its memos, bottom first, and the completed item
+        // that set it off.
+        vector<pair<vector<int>, int>> chains;
+
+        auto make = [&](source s) {
+            int p = -1;
+            switch (s.kind) {
+                case source::item: p = rule_production[items[s.a].rule]; break;
+                case source::chain: p = rule_production[items[c.memos[chains[s.a].first[s.b]].waiting].rule]; break;
+                case source::epsilon: p = epsilon_production[s.a]; break;
+            }
+            nodes.push_back({p, {}});
+            pending.push_back({int(nodes.size()) - 1, s});
+        };
+
+        // The children of the item up to x, right to left.
+        vector<source> kids;
+        auto walk = [&](int x) {
+            for (;;) {
+                auto& l = c.links[x];
+                switch (l.kind) {
+                    case link::predict: return;
+                    case link::scan: break;
+                    case link::complete: kids.push_back({source::item, l.b, 0}); break;
+                    case link::nullable:
+                        kids.push_back({source::epsilon, int(next_symbol[items[l.a].rule]), 0});
+                        break;
+                    case link::leo: assert(false); return;
+                }
+                x = l.a;
+            }
+        };
+
+        int goal = -1;
+        auto last = c.set(c.set_count() - 1);
+        for (size_t i = 0; i < last.size(); ++i) {
+            if (last[i].rule == uint32_t(goal_rule + 1) && last[i].origin == 0) {
+                goal = c.set_offsets[c.set_count() - 1] + i;
+            }
+        }
+        make({source::item, goal, 0});
+
+        while (pending.size()) {
+            auto n = pending.back().first;
+            auto s = pending.back().second;
+            pending.pop_back();
+            kids.clear();
+
+            if (s.kind == source::epsilon) {
+                auto rhs = g.rhs_ids(nodes[n].production);
+                for (auto it = rhs.rbegin(); it != rhs.rend(); ++it) {
+                    kids.push_back({source::epsilon, int(*it), 0});
+                }
+            }
+            else if (s.kind == source::item && c.links[s.a].kind == link::leo) {
+                // The top of a Leo chain: unwind it.
+                auto& l = c.links[s.a];
+                vector<int> memos;
+                for (int m = l.b; m >= 0; m = c.memos[m].next) { memos.push_back(m); }
+                int level = memos.size() - 1;
+                chains.push_back({move(memos), l.a});
+                if (level == 0) { kids.push_back({source::item, l.a, 0}); }
+                else { kids.push_back({source::chain, int(chains.size()) - 1, level - 1}); }
+                walk(c.memos[chains.back().first[level]].waiting);
+            }
+            else if (s.kind == source::chain) {
+                auto& chain = chains[s.a];
+                if (s.b == 0) { kids.push_back({source::item, chain.second, 0}); }
+                else { kids.push_back({source::chain, s.a, s.b - 1}); }
+                walk(c.memos[chain.first[s.b]].waiting);
+            }
+            else {
+                walk(s.a);
+            }
+
+            for (auto it = kids.rbegin(); it != kids.rend(); ++it) {
+                nodes[n].kids.push_back(nodes.size());
+                make(*it);
+            }
+        }
+
+        // The goal's one child is the tree; read it off in preorder.
+        vector<int> ret;
+        vector<int> stack{nodes[0].kids[0]};
+        while (stack.size()) {
+            auto n = stack.back();
+            stack.pop_back();
+            ret.push_back(nodes[n].production);
+            auto& k = nodes[n].kids;
+            stack.insert(stack.end(), k.rbegin(), k.rend());
+        }
+        return ret;
+    }
+}
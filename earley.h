@@ -0,0 +1,130 @@
+#ifndef EARLEY_H
+#define EARLEY_H
+
+//////////////////////////////////////////////////////////////////////////////
+// An Earley parser, for any grammar at all: ambiguous, left recursive,
+// right recursive, with epsilon productions, whatever.
+//
+// Two well known fixes to Earley's original algorithm are built in:
+//
+//   Aycock and Horspool ("Practical Earley Parsing", 2002): when we predict
+//   a nullable nonterminal, we also move the dot over it right away. Then
+//   completing an item that started in the current set never has to look
+//   back at the current set, which is what goes wrong with epsilon rules.
+//
+//   Leo ("A general context-free parsing algorithm running in linear time on
+//   every LR(k) grammar without using lookahead", TCS 82, 1991): when
+//   completing A at set i, if exactly one item of set i is waiting on A and
+//   A is the last thing it's waiting for, completing it is a foregone
+//   conclusion, as is whatever that completes in turn. So we memoize the
+//   topmost item of that deterministic chain per (set, nonterminal) and add
+//   just that. Right recursion then takes linear time and space instead of
+//   quadratic.
+//
+// Items are two 32 bit words, (dotted rule, origin), where the dotted rules
+// of production p are numbered base(p) + dot, with a hidden goal rule
+// S' -> S on the end. The sets live back to back in one array. While a set
+// is being built, a hash index on it keeps the items unique; once it's done,
+// its items get sorted by the symbol after the dot, which is all scanning
+// and completing ever look them up by.
+//
+// To get a parse tree out, each item can remember the first way we found it
+// (its "link"). Along with the Leo memos that's enough to rebuild one
+// derivation without rerunning anything; for ambiguous input it's whichever
+// one we stumbled on first.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "cfg.h"
+#include "parse_tree.h"
+
+namespace cfg {
+    struct earley_item {
+        std::uint32_t rule;    // dotted rule
+        std::uint32_t origin;  // the set it started in
+    };
+
+    class earley_parser;
+
+    // The Earley sets for one input.
+    class earley_chart {
+        public:
+            bool accepted = false;
+            // Where we got stuck: the index of the token no item could scan,
+            // or the length of the input if we got to the end and didn't
+            // accept.
+            std::size_t error_at = 0;
+
+            int set_count() const { return set_offsets.size() - 1; }
+            span<earley_item> set(int k) const {
+                return {items.data() + set_offsets[k], items.data() + set_offsets[k+1]};
+            }
+            std::size_t size() const { return items.size(); }
+
+        private:
+            friend class earley_parser;
+
+            // How an item was first found.
+            struct link {
+                enum kind_t : std::uint8_t { predict, scan, complete, nullable, leo };
+                kind_t kind;
+                std::int32_t a;  // the item we advanced, or for leo the completed item
+                std::int32_t b;  // the completed item, or for leo the memo
+            };
+            // Leo's memo for (set, nonterminal A): the one item of the set
+            // waiting on A, the memo that carries on from it, if any, and the
+            // topmost item of the chain.
+            struct leo_memo {
+                std::int32_t waiting;
+                std::int32_t next;
+                earley_item top;
+            };
+
+            std::vector<earley_item> items;
+            std::vector<std::uint32_t> set_offsets{0};
+            std::vector<link> links;  // parallel to items, if asked for
+            std::vector<leo_memo> memos;
+            // Each finished set's items with a symbol after the dot, sorted
+            // by that symbol.
+            std::vector<std::uint32_t> by_next;
+            std::vector<std::uint32_t> by_next_offsets{0};
+    };
+
+    class earley_parser {
+        public:
+            const grammar& g;
+            explicit earley_parser(const grammar& g, bool use_leo = true);
+
+            // links says whether to keep what's needed to build a tree.
+            earley_chart chart(span<symbol_id> input, bool links = false) const;
+
+            bool recognize(span<symbol_id> input, std::size_t* error_at = nullptr) const;
+            // A leftmost derivation of input, as production indices.
+            bool parse(span<symbol_id> input, std::vector<int>& derivation,
+                       std::size_t* error_at = nullptr) const;
+            // Returns an undeveloped tree on failure.
+            parse_tree parse(span<symbol_id> input, std::size_t* error_at = nullptr) const;
+            // The leftmost derivation from a chart made with links.
+            std::vector<int> derivation(const earley_chart& c) const;
+
+        private:
+            bool use_leo;
+            int goal_rule;
+            // Indexed by dotted rule: the symbol after the dot (no_symbol if
+            // the rule is complete), the production, and its LHS, which is
+            // symbol_count() for the goal.
+            std::vector<symbol_id> next_symbol;
+            std::vector<std::int32_t> rule_production;
+            std::vector<symbol_id> rule_lhs;
+            std::vector<std::uint32_t> rule_base;  // production to its dot 0 rule
+            std::vector<bool> nullable;
+            // For each nullable nonterminal, a production to derive epsilon
+            // by without going round in circles.
+            std::vector<int> epsilon_production;
+    };
+}
+
+#endif
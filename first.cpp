@@ -2,10 +2,16 @@
 
 #include <set>
 #include <map>
+#include <vector>
 #include <iostream>
+#include <limits>
+#include <queue>
 #include <iterator>
 #include <algorithm>
 #include "cfg.h"
+#include "bitset.h"
+#include "digraph.h"
+#include "stats.h"
 
 // Following mainly the 3rd edition of Michael Scott's book, with some references to
 // the 2nd edition of the dragon book.
@@ -15,6 +21,12 @@
 // should be computable for all grammars, not jut LALR or whatever (though restricted grammars may be
 // the only ones for which these sets are useful).
 //
+// Internally everything is computed over the grammar's interned symbol IDs
+// with the bitset engine described in first.h: each set is a bit_matrix row
+// over terminal indices, and EPS is a separate nullable bit. The map-returning
+// functions at the bottom just convert back to strings, putting EPS back in
+// and dropping the end-of-input column (which the old interface never had).
+//
 // Next up: creating a table-driven pasrer...
 
 
@@ -23,122 +35,233 @@ using namespace cfg;
 
 const symbol EPS = "";
 
-map<symbol, set<symbol>> compute_first(const grammar& g) {
-  map<symbol, set<symbol>> FIRST;
+namespace {
 
-  // all terminals are their own first sets.
-  for (auto& s : g.all_terminals()) FIRST[s] = {s};
+first_sets first_by_sweep(const grammar& g) {
+  CFG_PHASE("first");
+  first_sets F{bit_matrix(g.symbol_count(), g.terminal_count() + 1),
+               vector<bool>(g.symbol_count(), false)};
+  auto& FIRST = F.first;
+  auto& nullable = F.nullable;
 
-  // add epsilon for any nonterminal that directly produces epsilon.
-  for (auto& p : g.all_productions()) {
-    if (p.rhs.size() == 0) { FIRST[p.lhs] = {EPS}; }
+  // all terminals are their own first sets.
+  for (int t = 0; t < g.terminal_count(); ++t) {
+    FIRST.set(g.terminal_id(t), t);
   }
 
   bool workDone = true;
   while (workDone) {
     workDone = false;
+    CFG_COUNT("first.sweep.iterations");
 
-    for (auto& p : g.all_productions()) {
+    for (int i = 0; i < g.size(); ++i) {
+      auto lhs = g.lhs_id(i);
 
       // We proceed down this production, and we only continue
       // to the i+1 symbol if the i-th symbol could produce epsilon.
       bool wholeProdIsEps = true;
-      for (auto& s : p.rhs) {
+      for (auto s : g.rhs_ids(i)) {
 
         // This symbol s could be the first in this production
         // to produce non-epsilon, so we inherit its first set.
-        // But we shouldn't add epsilon!
-        for (auto&& b : FIRST[s]) {
-          if (b == EPS) { continue; }
-          auto result = FIRST[p.lhs].insert(b);
-          workDone |= get<1>(result);
-        }
+        bool grew = FIRST.or_row(lhs, s);
+        CFG_COUNT("first.sweep.insertions");
+        CFG_ADD("first.sweep.new_insertions", grew);
+        workDone |= grew;
 
         // if this symbol doesn't have EPS, then we can't
         // continue.
-        if (FIRST[s].find(EPS) == FIRST[s].end()) {
+        if (!nullable[s]) {
           wholeProdIsEps = false;
           break;
         }
       }
-      // Isn't this necessary?
-      if (wholeProdIsEps) {
-        FIRST[p.lhs].insert(EPS);
+      if (wholeProdIsEps && !nullable[lhs]) {
+        nullable[lhs] = true;
+        workDone = true;
       }
+    }
+  }
+  return F;
+}
+
+}
 
+// The counter-based worklist algorithm: each production counts the RHS
+// symbols not yet known to be nullable, and we only ever decrement the
+// counters of productions a newly-nullable symbol actually occurs in.
+vector<bool> compute_nullable(const grammar& g) {
+  CFG_PHASE("nullable");
+  vector<bool> nullable(g.symbol_count(), false);
+
+  // Where each symbol occurs, by production (with repetition).
+  vector<int> offsets(g.symbol_count() + 1, 0);
+  for (int i = 0; i < g.size(); ++i) {
+    for (auto s : g.rhs_ids(i)) { ++offsets[s+1]; }
+  }
+  for (int s = 0; s < g.symbol_count(); ++s) { offsets[s+1] += offsets[s]; }
+  vector<int> occurs(offsets.back());
+  auto fill = offsets;
+  vector<int> remaining(g.size());
+  vector<symbol_id> work_list;
+  for (int i = 0; i < g.size(); ++i) {
+    remaining[i] = g.rhs_size(i);
+    for (auto s : g.rhs_ids(i)) { occurs[fill[s]++] = i; }
+    if (remaining[i] == 0 && !nullable[g.lhs_id(i)]) {
+      nullable[g.lhs_id(i)] = true;
+      work_list.push_back(g.lhs_id(i));
     }
   }
-  return FIRST;
+
+  while (work_list.size()) {
+    auto s = work_list.back();
+    work_list.pop_back();
+    CFG_COUNT("nullable.work_list_pops");
+    for (int k = offsets[s]; k < offsets[s+1]; ++k) {
+      int i = occurs[k];
+      if (--remaining[i] == 0 && !nullable[g.lhs_id(i)]) {
+        nullable[g.lhs_id(i)] = true;
+        work_list.push_back(g.lhs_id(i));
+      }
+    }
+  }
+  return nullable;
 }
 
-template<typename ITER>
-set<symbol> sequence_first(ITER start, ITER finish, map<symbol, set<symbol>>& FIRST) {
-  set<symbol> ret;
-  for (; start != finish; ++start) {
-    ret.insert(FIRST[*start].begin(), FIRST[*start].end());
-    if (FIRST[*start].find(EPS) == FIRST[*start].end()) {
-      break;
+vector<int> compute_min_yield(const grammar& g) {
+  const int none = numeric_limits<int>::max();
+  auto plus = [&](int a, int b) { return a > none - b ? none : a + b; };
+  vector<int> yield(g.symbol_count(), none);
+  for (int t = 0; t < g.terminal_count(); ++t) { yield[g.terminal_id(t)] = 1; }
+
+  // Like compute_nullable, each production counts down its nonterminals
+  // not known yet, adding up their lengths as they come in; once it gets
+  // to zero that's a length for its LHS. Then the shortest one on offer
+  // is final, as in Dijkstra's algorithm, since a production is never
+  // shorter than any of its parts.
+  vector<int> offsets(g.nonterminal_count() + 1, 0);
+  for (int i = 0; i < g.size(); ++i) {
+    for (auto s : g.rhs_ids(i)) {
+      if (g.is_nonterminal(s)) { ++offsets[s+1]; }
     }
-  } 
-  return ret;
+  }
+  for (int A = 0; A < g.nonterminal_count(); ++A) { offsets[A+1] += offsets[A]; }
+  vector<int> occurs(offsets.back());
+  auto fill = offsets;
+  vector<int> remaining(g.size(), 0);
+  vector<int> length(g.size(), 0);
+  typedef pair<int, symbol_id> offer;
+  priority_queue<offer, vector<offer>, greater<offer>> offers;
+  for (int i = 0; i < g.size(); ++i) {
+    for (auto s : g.rhs_ids(i)) {
+      if (g.is_nonterminal(s)) {
+        occurs[fill[s]++] = i;
+        ++remaining[i];
+      }
+      else {
+        length[i] = plus(length[i], 1);
+      }
+    }
+    if (remaining[i] == 0) { offers.push({length[i], g.lhs_id(i)}); }
+  }
+
+  while (offers.size()) {
+    auto o = offers.top();
+    offers.pop();
+    symbol_id A = o.second;
+    if (yield[A] != none) { continue; }
+    yield[A] = o.first;
+    for (int k = offsets[A]; k < offsets[A+1]; ++k) {
+      int i = occurs[k];
+      length[i] = plus(length[i], yield[A]);
+      if (--remaining[i] == 0) { offers.push({length[i], g.lhs_id(i)}); }
+    }
+  }
+  return yield;
 }
 
-template<typename ITER>
-bool sequence_epsilon(ITER start, ITER finish, map<symbol, set<symbol>>& FIRST) {
-  return all_of(start, finish, [&](const symbol& s) { return FIRST[s].find(EPS) != FIRST[s].end(); });
+namespace {
+
+// FIRST(A) includes FIRST(X) whenever A -> alpha X beta with alpha
+// nullable, so that's our relation; terminals start out with themselves.
+first_sets first_by_digraph(const grammar& g, vector<bool> nullable) {
+  CFG_PHASE("first");
+  first_sets F{bit_matrix(g.symbol_count(), g.terminal_count() + 1), move(nullable)};
+  for (int t = 0; t < g.terminal_count(); ++t) {
+    F.first.set(g.terminal_id(t), t);
+  }
+
+  vector<pair<int, int>> edges;
+  for (int i = 0; i < g.size(); ++i) {
+    for (auto s : g.rhs_ids(i)) {
+      edges.push_back({int(g.lhs_id(i)), int(s)});
+      if (!F.nullable[s]) { break; }
+    }
+  }
+  CFG_ADD("first.digraph.edges", edges.size());
+  digraph(relation(g.symbol_count(), edges), F.first);
+  return F;
 }
 
-map<symbol, set<symbol>> compute_follow(const grammar& g, bool Scott /*= false*/) {
-  map<symbol, set<symbol>> FOLLOW;
-  auto FIRST = compute_first(g);
+}
+
+first_sets compute_first_sets(const grammar& g, fixpoint how) {
+  if (how == fixpoint::sweep) { return first_by_sweep(g); }
+  return first_by_digraph(g, compute_nullable(g));
+}
 
-  // In Scott, we include computation for nonterminals.
-  // In C&T, we don't
-  if (Scott) {
-    for (auto&& a : g.all_symbols()) {
-      FOLLOW[a] = {}; // redundant...
+namespace {
+
+// out |= FIRST of the string rhs_ids(i)[from...]. Returns whether that
+// whole string can vanish.
+bool sequence_first(const grammar& g, int i, size_t from, const first_sets& F, bits::word* out) {
+  auto rhs = g.rhs_ids(i);
+  for (; from < rhs.size(); ++from) {
+    bits::or_words(out, F.first.row(rhs[from]), F.first.words_per_row());
+    if (!F.nullable[rhs[from]]) {
+      return false;
     }
   }
+  return true;
+}
+
+// This computes FOLLOW for every symbol, terminals included (the Scott
+// variant). The C&T variant is just the nonterminal subset of this.
+bit_matrix follow_by_sweep(const grammar& g, const first_sets& F) {
+  CFG_PHASE("follow");
+  bit_matrix FOLLOW(g.symbol_count(), F.first.width());
+  // The start symbol, if there's a grammar at all.
+  if (g.nonterminal_count() > 0) { FOLLOW.set(0, end_of_input(g)); }
+
+  int words = FOLLOW.words_per_row();
+  vector<bits::word> TRAILER(words);
 
   bool workDone = true;
   while (workDone) {
     workDone = false;
+    CFG_COUNT("follow.sweep.iterations");
 
-    for (auto&& p : g.all_productions()) {
-      auto TRAILER = FOLLOW[p.lhs];
-      for (auto it = p.rhs.rbegin(); it != p.rhs.rend(); ++it) {
-        if (Scott) {
-          // Do the set insertion
-          for (auto&& t : TRAILER) {
-            auto res = FOLLOW[*it].insert(t);
-            workDone |= get<1>(res);
-          }
-        }
-        if (g.is_nonterminal(*it)) {
-          if (!Scott) {
-            // Do the set insertion
-            for (auto&& t : TRAILER) {
-              auto res = FOLLOW[*it].insert(t);
-              workDone |= get<1>(res);
-            }
-          }
-
-          // If we could produce epsilon, we don't have to clear
-          // the TRAILER. We simply out what we could produce instead.
-          if (FIRST[*it].find(EPS) != FIRST[*it].end()) {
-            for (auto&& s : FIRST[*it]) {
-              if (s == EPS) { continue; }
-              TRAILER.insert(s);
-            }
-          }
-          // Because we don't produce epsilon, the trailer becomes
-          // our FIRST set.
-          else {
-            TRAILER = FIRST[*it];
-          }
+    for (int i = 0; i < g.size(); ++i) {
+      auto lhs_row = FOLLOW.row(g.lhs_id(i));
+      copy(lhs_row, lhs_row + words, TRAILER.begin());
+      auto rhs = g.rhs_ids(i);
+      for (auto it = rhs.rbegin(); it != rhs.rend(); ++it) {
+        // Do the set insertion
+        bool grew = FOLLOW.or_into(*it, TRAILER.data());
+        CFG_COUNT("follow.sweep.insertions");
+        CFG_ADD("follow.sweep.new_insertions", grew);
+        workDone |= grew;
+
+        // If we could produce epsilon, we don't have to clear
+        // the TRAILER. We simply out what we could produce instead.
+        auto first = F.first.row(*it);
+        if (F.nullable[*it]) {
+          bits::or_words(TRAILER.data(), first, words);
         }
+        // Because we don't produce epsilon (terminals never do), the
+        // trailer becomes our FIRST set.
         else {
-          TRAILER = FIRST[*it]; // as this is a terminal, it's just itself..
+          copy(first, first + words, TRAILER.begin());
         }
       }
     }
@@ -146,77 +269,180 @@ map<symbol, set<symbol>> compute_follow(const grammar& g, bool Scott /*= false*/
   return FOLLOW;
 }
 
-map<symbol, set<symbol>> compute_follow_scott(const grammar& g) {
-  map<symbol, set<symbol>> FOLLOW;
-  auto FIRST = compute_first(g);
+// For A -> alpha X beta, FOLLOW(X) directly reads FIRST(beta), and if beta
+// is nullable X "includes" A: FOLLOW(X) contains FOLLOW(A). So one right to
+// left pass over each production gives the initial sets and the relation.
+bit_matrix follow_by_digraph(const grammar& g, const first_sets& F) {
+  CFG_PHASE("follow");
+  bit_matrix FOLLOW(g.symbol_count(), F.first.width());
+  // The start symbol, if there's a grammar at all.
+  if (g.nonterminal_count() > 0) { FOLLOW.set(0, end_of_input(g)); }
 
-  for (auto& s : g.all_symbols()) {
-    FOLLOW[s] = {};
-  }
+  int words = FOLLOW.words_per_row();
+  vector<bits::word> reads(words);
+  vector<pair<int, int>> includes;
+  for (int i = 0; i < g.size(); ++i) {
+    fill(reads.begin(), reads.end(), 0);
+    bool rest_nullable = true;
+    auto rhs = g.rhs_ids(i);
+    for (auto it = rhs.rbegin(); it != rhs.rend(); ++it) {
+      FOLLOW.or_into(*it, reads.data());
+      if (rest_nullable) { includes.push_back({int(*it), int(g.lhs_id(i))}); }
 
-  bool workDone = true;
-  while (workDone) {
-    workDone = false;
-    for (auto& p : g.all_productions()) {
-      for (auto sit = p.rhs.begin(); sit != p.rhs.end(); ++sit) {
-        // this is the alpha B beta case
-        if (std::next(sit) != p.rhs.end()) {
-          auto seq_first = sequence_first(std::next(sit), p.rhs.end(), FIRST);
-          auto old_size = FOLLOW[*sit].size();
-          FOLLOW[*sit].insert(seq_first.begin(), seq_first.end());
-          if (old_size != FOLLOW[*sit].size()) { workDone = true; }
-
-          // If this sequence creates an epsilon. Is that the same as
-          // having eps \in seq_first?
-          if (sequence_epsilon(std::next(sit), p.rhs.end(), FIRST)) {
-            FOLLOW[*sit].insert(FOLLOW[p.lhs].begin(), FOLLOW[p.lhs].end());
-          }
-          if (old_size != FOLLOW[*sit].size()) { workDone = true; }
-        }
-        // this is the alpha B case (identical as if "beta" is already epsilon):
-        else {
-          FOLLOW[*sit].insert(FOLLOW[p.lhs].begin(), FOLLOW[p.lhs].end());
-        }
+      auto first = F.first.row(*it);
+      if (F.nullable[*it]) {
+        bits::or_words(reads.data(), first, words);
+      }
+      else {
+        copy(first, first + words, reads.begin());
+        rest_nullable = false;
       }
     }
   }
+  CFG_ADD("follow.digraph.includes", includes.size());
+  digraph(relation(g.symbol_count(), includes), FOLLOW);
   return FOLLOW;
 }
 
-map<production, set<symbol>> compute_predict(const grammar& g) {
-  auto FIRST = compute_first(g);
-  auto FOLLOW = compute_follow(g);
-  map<production, set<symbol>> PREDICT;
-  for (auto& p : g.all_productions()) {
-    PREDICT[p] = sequence_first(p.rhs.begin(), p.rhs.end(), FIRST);
-    if (sequence_epsilon(p.rhs.begin(), p.rhs.end(), FIRST)) {
-      PREDICT[p].insert(FOLLOW[p.lhs].begin(), FOLLOW[p.lhs].end());
+}
+
+bit_matrix compute_follow_sets(const grammar& g, const first_sets& F, fixpoint how) {
+  if (how == fixpoint::sweep) { return follow_by_sweep(g, F); }
+  return follow_by_digraph(g, F);
+}
+
+bit_matrix compute_predict_sets(const grammar& g, const first_sets& F, const bit_matrix& FOLLOW) {
+  CFG_PHASE("predict");
+  bit_matrix PREDICT(g.size(), F.first.width());
+  for (int i = 0; i < g.size(); ++i) {
+    if (sequence_first(g, i, 0, F, PREDICT.row(i))) {
+      PREDICT.or_row(i, FOLLOW, g.lhs_id(i));
     }
   }
   return PREDICT;
 }
 
+namespace {
+
+// Convert one row back to terminal names, ignoring end_of_input.
+set<symbol> to_names(const grammar& g, const bit_matrix& m, int r) {
+  set<symbol> ret;
+  m.for_each(r, [&](int t) {
+    if (t != end_of_input(g)) { ret.insert(g.name_of(g.terminal_id(t))); }
+  });
+  return ret;
+}
+
+}
+
+const vector<bool>& grammar_analysis::nullable() const {
+  call_once(nullable_once, [&]() {
+    if (how == fixpoint::sweep) { nullable_ = first().nullable; }
+    else { nullable_ = compute_nullable(g); }
+  });
+  return nullable_;
+}
+
+const vector<int>& grammar_analysis::min_yield() const {
+  call_once(min_yield_once, [&]() { min_yield_ = compute_min_yield(g); });
+  return min_yield_;
+}
+
+const first_sets& grammar_analysis::first() const {
+  call_once(first_once, [&]() {
+    if (how == fixpoint::sweep) { first_ = first_by_sweep(g); }
+    else { first_ = first_by_digraph(g, nullable()); }
+  });
+  return first_;
+}
+
+const bit_matrix& grammar_analysis::follow() const {
+  call_once(follow_once, [&]() { follow_ = compute_follow_sets(g, first(), how); });
+  return follow_;
+}
+
+const bit_matrix& grammar_analysis::predict() const {
+  call_once(predict_once, [&]() { predict_ = compute_predict_sets(g, first(), follow()); });
+  return predict_;
+}
+
+const vector<bool>& compute_nullable(const grammar_analysis& A) { return A.nullable(); }
+const vector<int>& compute_min_yield(const grammar_analysis& A) { return A.min_yield(); }
+const first_sets& compute_first_sets(const grammar_analysis& A) { return A.first(); }
+const bit_matrix& compute_follow_sets(const grammar_analysis& A) { return A.follow(); }
+const bit_matrix& compute_predict_sets(const grammar_analysis& A) { return A.predict(); }
+
+map<symbol, set<symbol>> compute_first(const grammar_analysis& A) {
+  auto& g = A.g;
+  auto& F = A.first();
+  map<symbol, set<symbol>> FIRST;
+  for (symbol_id s = 0; s < symbol_id(g.symbol_count()); ++s) {
+    auto& entry = FIRST[g.name_of(s)] = to_names(g, F.first, s);
+    if (F.nullable[s]) { entry.insert(EPS); }
+  }
+  return FIRST;
+}
+
+// In Scott, we include computation for nonterminals.
+// In C&T, we don't
+map<symbol, set<symbol>> compute_follow(const grammar_analysis& A, bool Scott /*= false*/) {
+  auto& g = A.g;
+  auto& follow = A.follow();
+  map<symbol, set<symbol>> FOLLOW;
+  int count = Scott ? g.symbol_count() : g.nonterminal_count();
+  for (symbol_id s = 0; s < symbol_id(count); ++s) {
+    FOLLOW[g.name_of(s)] = to_names(g, follow, s);
+  }
+  return FOLLOW;
+}
+
+// Scott's formulation, computing for every symbol; the engine's digraph
+// does that now.
+map<symbol, set<symbol>> compute_follow_scott(const grammar_analysis& A) {
+  return compute_follow(A, true);
+}
+map<symbol, set<symbol>> compute_follow_scott(const grammar& g) {
+  return compute_follow(g, true);
+}
+
+// Note that PREDICT sets are sets of terminals, so never contain EPS.
+map<production, set<symbol>> compute_predict(const grammar_analysis& A) {
+  auto& g = A.g;
+  auto& predict = A.predict();
+  map<production, set<symbol>> PREDICT;
+  for (int i = 0; i < g.size(); ++i) {
+    PREDICT[g[i]] = to_names(g, predict, i);
+  }
+  return PREDICT;
+}
+
 // absolutely dead stupid definition.
-pair<production, production> compute_predict_predict_conflict(const grammar& g) {
-  auto PREDICT = compute_predict(g);
-  for (auto&& p : g.all_productions()) {
-    for (auto&& q : g.all_productions()) {
+pair<production, production> compute_predict_predict_conflict(const grammar_analysis& A) {
+  auto& g = A.g;
+  auto& PREDICT = A.predict();
+  for (int i = 0; i < g.size(); ++i) {
+    auto& p = g[i];
+    for (auto j : g.production_indices(g.lhs_id(i))) {
+      auto& q = g[j];
       if (q >= p) { continue; }
-      if (q.lhs == p.lhs) {
-        bool conflicting = false;
-        for (auto&& s : PREDICT[p]) {
-          if (conflicting) break;
-          for (auto&& r : PREDICT[q]) {
-            if (s == r) {
-              cout << p << endl << q << endl;
-              conflicting = true;
-              break;
-              //return {p, q};
-            }
-          }
-        }
+      if (PREDICT.intersects(i, PREDICT, j)) {
+        cout << p << endl << q << endl;
+        //return {p, q};
       }
     }
   }
   return {{"", ""},{"", ""}};
 }
+
+map<symbol, set<symbol>> compute_first(const grammar& g) {
+  return compute_first(grammar_analysis(g));
+}
+map<symbol, set<symbol>> compute_follow(const grammar& g, bool Scott /*= false*/) {
+  return compute_follow(grammar_analysis(g), Scott);
+}
+map<production, set<symbol>> compute_predict(const grammar& g) {
+  return compute_predict(grammar_analysis(g));
+}
+pair<production, production> compute_predict_predict_conflict(const grammar& g) {
+  return compute_predict_predict_conflict(grammar_analysis(g));
+}
@@ -1,9 +1,92 @@
+#ifndef FIRST_H
+#define FIRST_H
+
 #include "cfg.h"
+#include "bitset.h"
 
 #include <map>
 #include <set>
+#include <vector>
+#include <mutex>
+
+// The bitset engine. Every FIRST/FOLLOW/PREDICT set is a row of a
+// bit_matrix whose columns are the grammar's terminal indices, plus one
+// extra column (end_of_input) standing for the end of the input, which
+// FOLLOW(start) always contains. Whether a symbol derives epsilon is kept
+// to the side as its nullable bit rather than being an element of FIRST.
+struct first_sets {
+  cfg::bit_matrix first;       // one row per symbol_id
+  std::vector<bool> nullable;  // indexed by symbol_id
+};
+
+inline int end_of_input(const cfg::grammar& g) { return g.terminal_count(); }
+
+// How the engine reaches its fixpoint. Both give identical sets.
+//   sweep:   the textbook loop over every production until nothing changes.
+//   digraph: build the relations once and run DeRemer and Pennello's
+//            SCC-based digraph algorithm (digraph.h), linear in their size.
+enum class fixpoint { sweep, digraph };
+
+// Just the nullable bits, by the linear counter-based worklist algorithm.
+std::vector<bool> compute_nullable(const cfg::grammar& g);
+// The length of the shortest terminal string each symbol derives (1 for a
+// terminal), by Knuth's generalization of Dijkstra's algorithm. INT_MAX for
+// nonterminals that don't derive any, and lengths saturate there too.
+std::vector<int> compute_min_yield(const cfg::grammar& g);
+first_sets compute_first_sets(const cfg::grammar& g, fixpoint how = fixpoint::digraph);
+// One row per symbol_id, terminals included.
+cfg::bit_matrix compute_follow_sets(const cfg::grammar& g, const first_sets& F, fixpoint how = fixpoint::digraph);
+// One row per production.
+cfg::bit_matrix compute_predict_sets(const cfg::grammar& g, const first_sets& F, const cfg::bit_matrix& FOLLOW);
+
+// The engine's results for one grammar, each computed the first time it's
+// asked for and then kept. PREDICT needs FOLLOW needs FIRST, so asking for
+// everything still only computes each of them once. The lazy steps are
+// guarded by std::call_once, so once constructed an analysis can be shared
+// and queried from any number of threads. The grammar must outlive it.
+class grammar_analysis {
+  public:
+    const cfg::grammar& g;
+    explicit grammar_analysis(const cfg::grammar& g, fixpoint how = fixpoint::digraph): g(g), how(how) {}
+    grammar_analysis(const grammar_analysis&) = delete;
+
+    const std::vector<bool>& nullable() const;
+    const std::vector<int>& min_yield() const;
+    const first_sets& first() const;
+    const cfg::bit_matrix& follow() const;
+    const cfg::bit_matrix& predict() const;
+
+  private:
+    const fixpoint how;
+    mutable std::once_flag nullable_once, min_yield_once, first_once, follow_once, predict_once;
+    mutable std::vector<bool> nullable_;
+    mutable std::vector<int> min_yield_;
+    mutable first_sets first_;
+    mutable cfg::bit_matrix follow_;
+    mutable cfg::bit_matrix predict_;
+};
+
+// The engine's functions again, answered from (and memoized in) A, so they
+// live as long as it does. These use A's fixpoint.
+const std::vector<bool>& compute_nullable(const grammar_analysis& A);
+const std::vector<int>& compute_min_yield(const grammar_analysis& A);
+const first_sets& compute_first_sets(const grammar_analysis& A);
+const cfg::bit_matrix& compute_follow_sets(const grammar_analysis& A);
+const cfg::bit_matrix& compute_predict_sets(const grammar_analysis& A);
+
+// The original interface, converting out of the engine. EPS is "" here.
+// The grammar versions just make a throwaway grammar_analysis.
+std::map<cfg::symbol, std::set<cfg::symbol>> compute_first(const grammar_analysis& A);
+std::map<cfg::symbol, std::set<cfg::symbol>> compute_follow(const grammar_analysis& A, bool Scott = false);
+std::map<cfg::symbol, std::set<cfg::symbol>> compute_follow_scott(const grammar_analysis& A);
+std::map<cfg::production, std::set<cfg::symbol>> compute_predict(const grammar_analysis& A);
+std::pair<cfg::production, cfg::production> compute_predict_predict_conflict(const grammar_analysis& A);
 
 std::map<cfg::symbol, std::set<cfg::symbol>> compute_first(const cfg::grammar& g);
 std::map<cfg::symbol, std::set<cfg::symbol>> compute_follow(const cfg::grammar& g, bool Scott = false);
+// Same as compute_follow(g, true).
+std::map<cfg::symbol, std::set<cfg::symbol>> compute_follow_scott(const cfg::grammar& g);
 std::map<cfg::production, std::set<cfg::symbol>> compute_predict(const cfg::grammar& g);
 std::pair<cfg::production, cfg::production> compute_predict_predict_conflict(const cfg::grammar& g);
+
+#endif
@@ -27,16 +27,17 @@ void print_set(const map<K, set<symbol>>& S) {
 
 int main() {
   auto G = read_grammar(cin);
-  auto FIRST = compute_first(G);
+  grammar_analysis A(G);
+  auto FIRST = compute_first(A);
   print_set(FIRST);
-  auto FOLLOW = compute_follow(G);
+  auto FOLLOW = compute_follow(A);
   cout << "=========================" << endl;
   print_set(FOLLOW);
   cout << "=========================" << endl;
-  auto PREDICT = compute_predict(G);
+  auto PREDICT = compute_predict(A);
   print_set(PREDICT);
   cout << "=========================" << endl;
-  auto x = compute_predict_predict_conflict(G);
+  auto x = compute_predict_predict_conflict(A);
   if (get<0>(x).lhs != "") {
     cout << get<0>(x) << endl;
     cout << get<1>(x) << endl;
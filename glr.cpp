@@ -0,0 +1,211 @@
+#include "glr.h"
+
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+
+namespace cfg {
+    glr_parser::glr_parser(const lr_table& table): g(table.g), columns(table.terminal_columns()) {
+        unordered_map<size_t, const lr_conflict*> conflicting;
+        for (auto&& c : table.conflicts()) {
+            conflicting[size_t(c.state) * columns + c.terminal] = &c;
+        }
+
+        action_offsets.push_back(0);
+        for (int s = 0; s < table.state_count(); ++s) {
+            for (int t = 0; t < columns; ++t) {
+                auto c = conflicting.find(size_t(s) * columns + t);
+                if (c != conflicting.end()) {
+                    auto& all = c->second->actions;
+                    actions.insert(actions.end(), all.begin(), all.end());
+                }
+                else if (table.action(s, t).kind != lr_action::error) {
+                    actions.push_back(table.action(s, t));
+                }
+                action_offsets.push_back(actions.size());
+            }
+            for (int A = 0; A < g.nonterminal_count(); ++A) {
+                gotos.push_back(table.go_to(s, A));
+            }
+        }
+    }
+
+    namespace {
+        struct gss_node {
+            int state;
+            int level;
+            vector<int> links;
+        };
+        struct gss_link {
+            int to;
+            int label;  // forest node
+        };
+        struct reduction {
+            int node;
+            int production;
+            int link;  // the link every path has to use, or -1
+        };
+    }
+
+    sppf glr_parser::parse(span<symbol_id> input, size_t* error_at) const {
+        sppf forest;
+        vector<gss_node> nodes;
+        vector<gss_link> links;
+        vector<reduction> work_list;
+        const symbol_id N = g.nonterminal_count();
+
+        size_t n = input.size();
+        int level = 0;
+        int t = 0;  // the lookahead's column
+        vector<int> frontier, next_frontier;
+        // The node of each state in the frontier, or -1; and the same for
+        // the next one.
+        vector<int> by_state(action_offsets.size() / columns, -1);
+        vector<int> next_by_state(by_state.size(), -1);
+
+        auto queue_reductions = [&](int v, int through) {
+            for (auto&& a : cell(nodes[v].state, t)) {
+                if (a.kind != lr_action::reduce) { continue; }
+                if (through >= 0 && g.rhs_size(a.value) == 0) { continue; }
+                work_list.push_back({v, a.value, through});
+            }
+        };
+
+        // Push state on top of u, labelling the link with the forest node.
+        auto push = [&](int u, int state, int label) {
+            int w = by_state[state];
+            bool created = w < 0;
+            if (created) {
+                w = nodes.size();
+                nodes.push_back({state, level, {}});
+                by_state[state] = w;
+                frontier.push_back(w);
+                queue_reductions(w, -1);
+            }
+            else {
+                for (auto l : nodes[w].links) {
+                    if (links[l].to == u) { return; }
+                }
+            }
+            int l = links.size();
+            links.push_back({u, label});
+            nodes[w].links.push_back(l);
+            // Farshi: if w was already here, the new link can be on a path
+            // from anywhere in the frontier.
+            if (!created) {
+                for (auto v : frontier) { queue_reductions(v, l); }
+            }
+        };
+
+        // Reduce along every path of length m from node, collecting the
+        // labels right to left.
+        vector<int> labels;
+        auto reduce = [&](const reduction& r) {
+            int m = g.rhs_size(r.production);
+            symbol_id A = g.lhs_id(r.production);
+            labels.assign(m, -1);
+
+            auto finish = [&](int u) {
+                int label = forest.add_node(A, nodes[u].level, level);
+                forest.add_packed(label, r.production, {labels.data(), labels.data() + m});
+                push(u, gotos[size_t(nodes[u].state) * N + A], label);
+            };
+            if (m == 0) {
+                finish(r.node);
+                return;
+            }
+
+            // Depth first through the links, by hand.
+            struct step { int node; size_t next; bool used; };
+            vector<step> path{{r.node, 0, false}};
+            while (path.size()) {
+                auto& top = path.back();
+                int depth = path.size() - 1;
+                if (depth == m) {
+                    if (r.link < 0 || top.used) { finish(top.node); }
+                    path.pop_back();
+                    continue;
+                }
+                if (top.next == nodes[top.node].links.size()) {
+                    path.pop_back();
+                    continue;
+                }
+                int l = nodes[top.node].links[top.next++];
+                labels[m - 1 - depth] = links[l].label;
+                bool used = top.used || l == r.link;
+                path.push_back({links[l].to, 0, used});
+            }
+        };
+
+        auto column = [&](size_t k) { return k < n ? int(input[k] - N) : columns - 1; };
+
+        // Off we go, with state 0 at the start.
+        t = column(0);
+        nodes.push_back({0, 0, {}});
+        frontier.push_back(0);
+        by_state[0] = 0;
+        size_t failed_at = n;
+        bool accepted = false;
+        for (size_t k = 0; ; ++k) {
+            if (unsigned(t) >= unsigned(columns)) {
+                failed_at = k;
+                break;
+            }
+            for (auto v : frontier) { queue_reductions(v, -1); }
+            while (work_list.size()) {
+                auto r = work_list.back();
+                work_list.pop_back();
+                reduce(r);
+            }
+
+            if (k == n) {
+                for (auto v : frontier) {
+                    for (auto&& a : cell(nodes[v].state, t)) {
+                        if (a.kind == lr_action::accept) { accepted = true; }
+                    }
+                }
+                break;
+            }
+
+            int label = forest.add_node(input[k], k, k + 1);
+            for (auto v : frontier) {
+                for (auto&& a : cell(nodes[v].state, t)) {
+                    if (a.kind != lr_action::shift) { continue; }
+                    int w = next_by_state[a.value];
+                    if (w < 0) {
+                        w = nodes.size();
+                        nodes.push_back({a.value, level + 1, {}});
+                        next_by_state[a.value] = w;
+                        next_frontier.push_back(w);
+                    }
+                    nodes[w].links.push_back(links.size());
+                    links.push_back({v, label});
+                }
+            }
+            if (next_frontier.empty()) {
+                failed_at = k;
+                break;
+            }
+
+            for (auto v : frontier) { by_state[nodes[v].state] = -1; }
+            swap(by_state, next_by_state);
+            swap(frontier, next_frontier);
+            next_frontier.clear();
+            ++level;
+            t = column(k + 1);
+        }
+
+        if (accepted) {
+            forest.root = forest.find_node(0, 0, n);
+        }
+        else if (error_at) {
+            *error_at = failed_at;
+        }
+        return forest;
+    }
+
+    bool glr_parser::recognize(span<symbol_id> input, size_t* error_at) const {
+        return parse(input, error_at).root >= 0;
+    }
+}
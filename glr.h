@@ -0,0 +1,61 @@
+#ifndef GLR_H
+#define GLR_H
+
+//////////////////////////////////////////////////////////////////////////////
+// Generalized LR (Tomita) parsing over an lr_table, conflicts and all.
+//
+// Where the table has one action we do what the LR parser would; where it
+// has several, we do all of them. The parser stacks share structure in a
+// graph-structured stack (GSS): a node is an LR state at a position in the
+// input (a "frontier"), and a link points back to the node it was pushed
+// on top of, labelled with the forest node for the symbol in between.
+// Stacks that reach the same state at the same position merge into one
+// node, which is what keeps it polynomial.
+//
+// Reductions are done from a worklist of (node, production, link): reduce
+// along every path of the production's length starting at node and going
+// through link (any path at all if link is -1). When a reduction adds a new
+// link to a node that already exists, paths through that new link might
+// exist from every node in the frontier, so they all get queued again with
+// that link; that's Farshi's fix, which takes care of epsilon rules and
+// hidden left recursion.
+//
+// The result is a shared packed parse forest (sppf.h), with terminal nodes
+// (t, i, i+1) for the input and a packed node for every reduction.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <cstddef>
+
+#include "cfg.h"
+#include "lr_table.h"
+#include "sppf.h"
+
+namespace cfg {
+    class glr_parser {
+        public:
+            const grammar& g;
+            explicit glr_parser(const lr_table& table);
+
+            // On failure *error_at (if given) is the index of the token no
+            // stack could shift, input.size() if it was the end of input.
+            bool recognize(span<symbol_id> input, std::size_t* error_at = nullptr) const;
+            // The forest's root is -1 on failure.
+            sppf parse(span<symbol_id> input, std::size_t* error_at = nullptr) const;
+
+        private:
+            int columns;
+            // Every action of each cell, as in the conflicts, or the one
+            // action of cells without any.
+            std::vector<lr_action> actions;
+            std::vector<std::uint32_t> action_offsets;
+            std::vector<int> gotos;  // states x nonterminals, -1 for none
+
+            span<lr_action> cell(int state, int t) const {
+                size_t c = size_t(state) * columns + t;
+                return {actions.data() + action_offsets[c], actions.data() + action_offsets[c+1]};
+            }
+    };
+}
+
+#endif
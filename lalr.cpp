@@ -0,0 +1,114 @@
+#include "lalr.h"
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include "digraph.h"
+#include "first.h"
+#include "stats.h"
+
+using namespace std;
+
+namespace cfg {
+    lalr_lookaheads compute_lalr_lookaheads(const lr0_automaton& a) {
+        auto& g = a.g;
+        auto nullable = compute_nullable(g);
+        int columns = g.terminal_count() + 1;
+
+        // The sets live on transition indices; the rows of terminal
+        // transitions just go unused.
+        bit_matrix F(a.transition_count(), columns);
+        vector<pair<int, int>> reads;
+
+        // DR, and the reads relation. The goal transition on S also gets
+        // the end of input, standing in for the "S' -> S $" of the paper.
+        symbol_id start = g.rhs_ids(0)[0];
+        for (int p = 0; p < a.state_count(); ++p) {
+            for (auto&& e : a.transitions(p)) {
+                if (!g.is_nonterminal(e.first)) { continue; }
+                int pA = a.transition_index(p, e.first);
+                for (auto&& f : a.transitions(e.second)) {
+                    if (g.is_terminal(f.first)) {
+                        F.set(pA, g.terminal_index(f.first));
+                    }
+                    else if (nullable[f.first]) {
+                        reads.push_back({pA, a.transition_index(e.second, f.first)});
+                    }
+                }
+                if (p == 0 && e.first == start) { F.set(pA, columns - 1); }
+            }
+        }
+        digraph(relation(a.transition_count(), reads), F);
+
+        // includes and lookback both come from walking each production
+        // B -> beta from each state p' with a transition on B.
+        vector<pair<int, int>> includes;
+        lalr_lookaheads ret;
+        vector<pair<int, int>> lookback;  // (reduction, transition)
+        unordered_map<uint64_t, int> reduction_index;
+
+        // rhs[vanishes_from[i]...] is the longest suffix of production i
+        // that can derive epsilon.
+        vector<int> vanishes_from(g.size());
+        for (int i = 0; i < g.size(); ++i) {
+            auto rhs = g.rhs_ids(i);
+            int k = rhs.size();
+            while (k > 0 && nullable[rhs[k-1]]) { --k; }
+            vanishes_from[i] = k;
+        }
+
+        for (int p = 0; p < a.state_count(); ++p) {
+            for (auto&& e : a.transitions(p)) {
+                auto B = e.first;
+                if (!g.is_nonterminal(B)) { continue; }
+                int pB = a.transition_index(p, B);
+
+                for (auto i : g.production_indices(B)) {
+                    auto rhs = g.rhs_ids(i);
+                    int q = p;
+                    for (int k = 0; k < int(rhs.size()); ++k) {
+                        int qX = a.transition_index(q, rhs[k]);
+                        if (k + 1 >= vanishes_from[i] && g.is_nonterminal(rhs[k])) {
+                            includes.push_back({qX, pB});
+                        }
+                        q = a.transition_target(qX);
+                    }
+
+                    uint64_t key = uint64_t(q) << 32 | uint32_t(i);
+                    auto r = reduction_index.insert({key, int(ret.reductions.size())});
+                    if (r.second) { ret.reductions.push_back({q, i}); }
+                    lookback.push_back({r.first->second, pB});
+                }
+            }
+        }
+        digraph(relation(a.transition_count(), includes), F);
+
+        ret.LA = bit_matrix(ret.reductions.size(), columns);
+        for (auto&& l : lookback) {
+            ret.LA.or_row(l.first, F, l.second);
+        }
+        return ret;
+    }
+
+    lr_table build_lalr_table(const grammar& g, const lr0_automaton& a) {
+        CFG_PHASE("lalr");
+        auto lookaheads = compute_lalr_lookaheads(a);
+        lr_table table(g, a.state_count());
+        for (int s = 0; s < a.state_count(); ++s) {
+            for (auto&& e : a.transitions(s)) {
+                table.add_augmented_transition(s, a.g, e.first, e.second);
+            }
+        }
+
+        // [S' -> S .] lives in goto(0, S), and there we accept.
+        int goal = a.transition(0, a.g.rhs_ids(0)[0]);
+        table.add_action(goal, table.terminal_columns() - 1, {lr_action::accept, 0});
+
+        for (size_t r = 0; r < lookaheads.reductions.size(); ++r) {
+            auto& reduction = lookaheads.reductions[r];
+            table.add_augmented_reduction(reduction.first, reduction.second, lookaheads.LA.row(r));
+        }
+        return table;
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef LALR_H
+#define LALR_H
+
+//////////////////////////////////////////////////////////////////////////////
+// LALR(1) lookaheads and parse tables, by the relations method of DeRemer
+// and Pennello ("Efficient Computation of LALR(1) Look-Ahead Sets", TOPLAS
+// 4(4), 1982) rather than by building LR(1) states and merging them.
+//
+// Everything is hung off the nonterminal transitions (p, A) of the LR(0)
+// automaton:
+//   DR(p, A)     the terminals t with p -A-> r -t->.
+//   reads        (p, A) reads (r, C) if p -A-> r -C-> and C is nullable.
+//   includes     (p, A) includes (p', B) if B -> beta A gamma, gamma is
+//                nullable, and p' -beta-> p.
+//   lookback     (q, A -> w) lookback (p, A) if p -w-> q.
+// Then Read = digraph(reads, DR), Follow = digraph(includes, Read), and the
+// lookahead set of each reduction is the union of Follow over its lookbacks.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <utility>
+
+#include "cfg.h"
+#include "bitset.h"
+#include "lr0.h"
+#include "lr_table.h"
+
+namespace cfg {
+    struct lalr_lookaheads {
+        // Every reduction in the automaton, as (state, production of the
+        // augmented grammar), and its lookahead set as the same row of LA.
+        // The columns are terminal indices, with end_of_input last.
+        std::vector<std::pair<int, int>> reductions;
+        bit_matrix LA;
+    };
+
+    // a must be the automaton of an augmented grammar.
+    lalr_lookaheads compute_lalr_lookaheads(const lr0_automaton& a);
+
+    // The LALR(1) tables for g, where a is the automaton of augment(g).
+    lr_table build_lalr_table(const grammar& g, const lr0_automaton& a);
+}
+
+#endif
@@ -0,0 +1,34 @@
+#include <string>
+#include <iostream>
+#include "cfg.h"
+#include "lr0.h"
+#include "lalr.h"
+#include "lr_table.h"
+
+// Builds the LALR(1) tables for the grammar on stdin and reports any
+// conflicts. Usage: ./lalr_driver [-t] < grammar.cfg
+// With -t the whole ACTION/GOTO table gets printed too.
+
+using namespace std;
+using namespace cfg;
+
+int main(int argc, char* argv[]) {
+    bool print_table = argc > 1 && string(argv[1]) == "-t";
+
+    auto G = read_grammar(cin);
+    if (G.size() == 0) {
+        cerr << "empty grammar" << endl;
+        return 2;
+    }
+    auto Gprime = augment(G);
+    lr0_automaton automaton(Gprime);
+    auto table = build_lalr_table(G, automaton);
+
+    cout << table.state_count() << " states, "
+         << table.conflicts().size() << " conflicts" << endl;
+    table.report_conflicts(cout);
+    if (print_table) {
+        table.print(cout);
+    }
+    return table.conflicts().size() ? 1 : 0;
+}
@@ -0,0 +1,91 @@
+#include "left_recursion.h"
+
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace cfg {
+    grammar remove_left_recursion(const grammar& g) {
+        // 1) One round of substituting for leading nonterminals that come
+        // earlier.
+        sequence<production> substituted;
+        for (symbol_id A = 0; A < symbol_id(g.nonterminal_count()); ++A) {
+            for (auto i : g.production_indices(A)) {
+                auto rhs = g.rhs_ids(i);
+                if (rhs.empty() || !g.is_nonterminal(rhs[0]) || rhs[0] >= A) {
+                    substituted.push_back(g[i]);
+                    continue;
+                }
+                auto& rest = g[i].rhs;
+                for (auto j : g.production_indices(rhs[0])) {
+                    sequence<symbol> new_rhs(g[j].rhs);
+                    new_rhs.insert(new_rhs.end(), rest.begin() + 1, rest.end());
+                    substituted.emplace_back(g[i].lhs, move(new_rhs));
+                }
+            }
+        }
+        grammar G1(substituted);
+
+        // 2) Immediate left recursion.
+        sequence<production> final_productions;
+        set<symbol> made;
+        int new_nonterm = 0;
+        for (symbol_id A = 0; A < symbol_id(G1.nonterminal_count()); ++A) {
+            // The left recursive ones with their leading A dropped, and the
+            // rest.
+            vector<sequence<symbol>> left_recursive_rhs, beta_rhs;
+            for (auto i : G1.production_indices(A)) {
+                auto& rhs = G1[i].rhs;
+                if (G1.rhs_size(i) > 0 && G1.rhs_ids(i)[0] == A) {
+                    // A -> A adds nothing to the language.
+                    if (G1.rhs_size(i) > 1) {
+                        left_recursive_rhs.emplace_back(rhs.begin() + 1, rhs.end());
+                    }
+                }
+                else {
+                    beta_rhs.push_back(rhs);
+                }
+            }
+            auto& name = G1.name_of(A);
+            // Nothing to take out, or A -> A is all there is, which we
+            // can't take out and still have A be a nonterminal.
+            if (left_recursive_rhs.empty()) {
+                if (beta_rhs.empty()) {
+                    for (auto i : G1.production_indices(A)) {
+                        final_productions.push_back(G1[i]);
+                    }
+                }
+                for (auto& rhs : beta_rhs) {
+                    final_productions.emplace_back(name, move(rhs));
+                }
+                continue;
+            }
+
+            symbol fresh;
+            do {
+                fresh = name + to_string(new_nonterm++);
+            } while (G1.id_of(fresh) != no_symbol || made.count(fresh));
+            made.insert(fresh);
+            // With no beta, A derives nothing: it keeps a production so it
+            // stays a nonterminal (and the start, if it was), and A' never
+            // gets to stop.
+            if (beta_rhs.empty()) {
+                final_productions.emplace_back(name, sequence<symbol>{fresh});
+            }
+            for (auto& rhs : beta_rhs) {
+                rhs.push_back(fresh);
+                final_productions.emplace_back(name, move(rhs));
+            }
+            for (auto& rhs : left_recursive_rhs) {
+                rhs.push_back(fresh);  // right recursive now
+                final_productions.emplace_back(fresh, move(rhs));
+            }
+            if (beta_rhs.size()) {
+                final_productions.emplace_back(fresh, sequence<symbol>{});
+            }
+        }
+        return grammar(final_productions);
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef LEFT_RECURSION_H
+#define LEFT_RECURSION_H
+
+//////////////////////////////////////////////////////////////////////////////
+// Taking the left recursion out of a grammar, so a top-down parser can have
+// a go at it. Two steps, after the dragon book's algorithm 4.19:
+//
+//   1) Each A -> B x where B comes before A (in symbol ID order, so the
+//      start symbol stays first) becomes A -> beta x for every B -> beta.
+//      That's one round of substitution, not the full algorithm's
+//      repeat-until-done, so some indirect left recursion can survive.
+//   2) Immediate left recursion goes the usual way. If A has productions
+//      A -> A alpha_i and A -> beta_j, we make a new nonterminal A' (A with
+//      a number on the end) and
+//        A  -> beta_j A'
+//        A' -> alpha_i A' | epsilon
+//      A -> A is dropped. With no beta_j, A derives nothing, and stays that
+//      way as A -> A' with no epsilon for A'.
+//
+// The language stays the same; the trees don't.
+//////////////////////////////////////////////////////////////////////////////
+
+#include "cfg.h"
+
+namespace cfg {
+    grammar remove_left_recursion(const grammar& g);
+}
+
+#endif
@@ -0,0 +1,125 @@
+#include "ll1.h"
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "stats.h"
+
+using namespace std;
+
+namespace cfg {
+    ll1_parser::ll1_parser(const grammar_analysis& A): g(A.g) {
+        fill(A.predict());
+    }
+
+    ll1_parser::ll1_parser(const grammar& g): g(g) {
+        auto F = compute_first_sets(g);
+        fill(compute_predict_sets(g, F, compute_follow_sets(g, F)));
+    }
+
+    void ll1_parser::fill(const bit_matrix& predict) {
+        CFG_PHASE("ll1");
+        columns = g.terminal_count() + 1;
+        table.assign(size_t(g.nonterminal_count()) * columns, -1);
+        for (int i = 0; i < g.size(); ++i) {
+            auto A = g.lhs_id(i);
+            predict.for_each(i, [&](int t) {
+                int& cell = table[size_t(A) * columns + t];
+                if (cell < 0) {
+                    cell = i;
+                    return;
+                }
+                // A grammar can have a lot of these, so no searching.
+                auto c = conflict_cells.insert({size_t(A) * columns + t, int(conflicts_.size())});
+                if (c.second) { conflicts_.push_back({A, t, {cell}}); }
+                conflicts_[c.first->second].productions.push_back(i);
+            });
+        }
+    }
+
+    template <typename F>
+    bool ll1_parser::run(span<symbol_id> input, size_t* error_at, F expanded) const {
+        const symbol_id N = g.nonterminal_count();
+        const int end = columns - 1;
+        const int* cells = table.data();
+
+        vector<symbol_id> stack;
+        stack.reserve(64);
+        stack.push_back(0);
+
+        // Only a table with conflicts can go round in circles.
+        unique_ptr<ll1_loop_guard> guard;
+        if (conflicts_.size()) { guard.reset(new ll1_loop_guard(N)); }
+
+        size_t i = 0, n = input.size();
+        // The current token's column. Nonterminals aren't valid input, and
+        // wrap around to something too big.
+        auto column = [&]() { return i < n ? int(input[i] - N) : end; };
+        auto fail = [&]() {
+            if (error_at) { *error_at = i; }
+            return false;
+        };
+
+        while (stack.size()) {
+            auto X = stack.back();
+            stack.pop_back();
+            if (X >= N) {
+                if (i == n || input[i] != X) { return fail(); }
+                ++i;
+                if (guard) { guard->matched(); }
+                continue;
+            }
+            unsigned t = column();
+            if (t > unsigned(end)) { return fail(); }
+            int p = cells[size_t(X) * columns + t];
+            if (p < 0) { return fail(); }
+            if (guard && !guard->expanding(X, stack.size())) { return fail(); }
+            expanded(p);
+            auto rhs = g.rhs_ids(p);
+            for (auto it = rhs.rbegin(); it != rhs.rend(); ++it) {
+                stack.push_back(*it);
+            }
+        }
+        if (i != n) { return fail(); }
+        return true;
+    }
+
+    bool ll1_parser::recognize(span<symbol_id> input, size_t* error_at) const {
+        return run(input, error_at, [](int) {});
+    }
+
+    bool ll1_parser::parse(span<symbol_id> input, vector<int>& derivation, size_t* error_at) const {
+        derivation.clear();
+        return run(input, error_at, [&](int p) { derivation.push_back(p); });
+    }
+
+    parse_tree ll1_parser::parse(span<symbol_id> input, size_t* error_at) const {
+        vector<int> derivation;
+        if (!parse(input, derivation, error_at)) { return parse_tree(g); }
+        return parse_tree(g, derivation);
+    }
+
+    void ll1_parser::print_table(ostream& o) const {
+        for (int A = 0; A < g.nonterminal_count(); ++A) {
+            o << g.name_of(A) << ":";
+            for (int t = 0; t < columns; ++t) {
+                int p = predict(A, t);
+                if (p < 0) { continue; }
+                o << " " << (t == columns - 1 ? "$" : g.name_of(g.terminal_id(t))) << "->" << p;
+            }
+            o << endl;
+        }
+    }
+
+    void ll1_parser::report_conflicts(ostream& o) const {
+        for (auto&& c : conflicts_) {
+            o << "conflict on " << g.name_of(c.nonterminal) << " at "
+              << (c.terminal == columns - 1 ? "$" : g.name_of(g.terminal_id(c.terminal))) << endl;
+            for (auto p : c.productions) {
+                o << "  " << g[p] << endl;
+            }
+        }
+    }
+}
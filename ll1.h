@@ -0,0 +1,118 @@
+#ifndef LL1_H
+#define LL1_H
+
+//////////////////////////////////////////////////////////////////////////////
+// A table-driven LL(1) parser.
+//
+// The table is dense, one row per nonterminal and one column per terminal
+// index (plus end_of_input last), and each cell is the production to expand
+// by, or -1. It comes straight out of the PREDICT sets: production i goes in
+// row lhs(i) at every column of PREDICT(i). If two productions want the same
+// cell the grammar isn't LL(1); we record a conflict and keep the
+// lower-numbered production. Parsing with such a table follows whichever
+// production got kept, so it can turn down sentences of the grammar, and
+// where that's a left recursive one it would expand the same nonterminal
+// forever; ll1_loop_guard catches that, and the parse fails there.
+//
+// Parsing is the usual stack machine, no recursion: pop a symbol, match it
+// if it's a terminal, otherwise look up the production for it and the
+// current token and push its right hand side backwards. Input is a sequence
+// of terminal ids of g; the end of the sequence is the end of input.
+//
+// Every expansion happens in leftmost order, so the productions we expand
+// by are exactly a leftmost derivation, which is what parse() hands back
+// (and what parse_tree can be built from). recognize() skips all of that
+// and just says yes or no.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <iostream>
+#include <unordered_map>
+
+#include "cfg.h"
+#include "first.h"
+#include "parse_tree.h"
+
+namespace cfg {
+    // Watches the expansions of an LL(1) stack machine for one that can
+    // never finish: the same nonterminal expanded twice at one input
+    // position, with nothing under the first one's stack slot touched in
+    // between. Everything from the first expansion to the second then
+    // happens again, and again. Only a table with conflicts can do that
+    // (left recursion always makes one), so parsers only bother then.
+    class ll1_loop_guard {
+        public:
+            explicit ll1_loop_guard(int nonterminals): depth_of(nonterminals, -1) {}
+
+            // A token got matched, so it's a new input position.
+            void matched() {
+                for (auto X : expanded) { depth_of[X] = -1; }
+                expanded.clear();
+            }
+            // X is about to be expanded, with depth symbols left under it
+            // on the stack. False if that's the loop above.
+            bool expanding(symbol_id X, std::size_t depth) {
+                // Expansions whose bottom we've popped into don't count.
+                while (expanded.size() && depth_of[expanded.back()] > int(depth)) {
+                    depth_of[expanded.back()] = -1;
+                    expanded.pop_back();
+                }
+                if (depth_of[X] >= 0) { return false; }
+                depth_of[X] = depth;
+                expanded.push_back(X);
+                return true;
+            }
+
+        private:
+            // Where each nonterminal was expanded at this position, or -1.
+            // expanded lists them, by depth, which only goes up along it.
+            std::vector<int> depth_of;
+            std::vector<symbol_id> expanded;
+    };
+
+    struct ll1_conflict {
+        symbol_id nonterminal;
+        int terminal;  // column, end_of_input last
+        std::vector<int> productions;  // the one in the table first
+    };
+
+    class ll1_parser {
+        public:
+            const grammar& g;
+            explicit ll1_parser(const grammar_analysis& A);
+            explicit ll1_parser(const grammar& g);
+
+            int terminal_columns() const { return columns; }
+            // The production to expand A by when looking at column t, or -1.
+            int predict(symbol_id A, int t) const { return table[size_t(A) * columns + t]; }
+            const std::vector<ll1_conflict>& conflicts() const { return conflicts_; }
+
+            // On failure *error_at (if given) is the index of the token we
+            // choked on, input.size() if it was the end of input.
+            bool recognize(span<symbol_id> input, std::size_t* error_at = nullptr) const;
+            // The leftmost derivation of input, as production indices.
+            bool parse(span<symbol_id> input, std::vector<int>& derivation,
+                       std::size_t* error_at = nullptr) const;
+            // Returns an undeveloped tree on failure.
+            parse_tree parse(span<symbol_id> input, std::size_t* error_at = nullptr) const;
+
+            void print_table(std::ostream& o) const;
+            void report_conflicts(std::ostream& o) const;
+
+        private:
+            int columns;
+            std::vector<int> table;
+            std::vector<ll1_conflict> conflicts_;
+            // Cell (A * columns + t) to its conflict.
+            std::unordered_map<std::size_t, int> conflict_cells;
+
+            void fill(const bit_matrix& predict);
+
+            template <typename F>
+            bool run(span<symbol_id> input, std::size_t* error_at, F expanded) const;
+    };
+}
+
+#endif
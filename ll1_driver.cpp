@@ -0,0 +1,82 @@
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "cfg.h"
+#include "mapped_file.h"
+#include "arguments.h"
+#include "first.h"
+#include "ll1.h"
+#include "parse_tree.h"
+
+// LL(1) parses the tokens on stdin with the grammar in the given file.
+// Usage: ./ll1_driver [-t] [-b repeats] grammar.cfg < tokens
+// Tokens are terminal names separated by whitespace. With -t the parse tree
+// gets printed; with -b we just recognize the input that many times and
+// report the throughput.
+
+using namespace std;
+using namespace cfg;
+
+int main(int argc, char* argv[]) {
+    bool print_tree = false;
+    long repeats = 0;
+    int arg = 1;
+    for (; arg < argc - 1; ++arg) {
+        string flag = argv[arg];
+        if (flag == "-t") { print_tree = true; }
+        else if (flag == "-b" && arg + 1 < argc - 1 && parse_number(argv[arg + 1], repeats)) { ++arg; }
+        else { break; }
+    }
+    if (arg != argc - 1) {
+        cerr << "usage: " << argv[0] << " [-t] [-b repeats] grammar.cfg < tokens" << endl;
+        return 2;
+    }
+    mapped_file file(argv[arg]);
+    if (!file) {
+        cerr << "can't open " << argv[arg] << endl;
+        return 2;
+    }
+
+    auto G = parse_grammar(file.begin(), file.end());
+    grammar_analysis A(G);
+    ll1_parser parser(A);
+    if (parser.conflicts().size()) {
+        cerr << "grammar isn't LL(1):" << endl;
+        parser.report_conflicts(cerr);
+    }
+
+    vector<symbol_id> tokens;
+    string bad;
+    if (!read_tokens(G, cin, tokens, &bad)) {
+        cerr << "unknown token " << bad << endl;
+        return 1;
+    }
+    span<symbol_id> input{tokens.data(), tokens.data() + tokens.size()};
+
+    if (repeats > 0) {
+        auto start = chrono::steady_clock::now();
+        long accepted = 0;
+        for (long r = 0; r < repeats; ++r) {
+            accepted += parser.recognize(input);
+        }
+        chrono::duration<double> took = chrono::steady_clock::now() - start;
+        cout << accepted << "/" << repeats << " accepted, "
+             << tokens.size() * repeats / took.count() / 1e6 << " million tokens/s" << endl;
+        return accepted == repeats ? 0 : 1;
+    }
+
+    size_t error_at;
+    vector<int> derivation;
+    if (!parser.parse(input, derivation, &error_at)) {
+        cout << "syntax error at token " << error_at;
+        if (error_at < tokens.size()) { cout << " (" << G.name_of(tokens[error_at]) << ")"; }
+        else { cout << " (end of input)"; }
+        cout << endl;
+        return 1;
+    }
+    cout << "accepted" << endl;
+    if (print_tree) {
+        cout << parse_tree(G, derivation);
+    }
+}
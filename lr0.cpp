@@ -0,0 +1,233 @@
+#include "lr0.h"
+
+#include <vector>
+#include <cassert>
+#include <iterator>
+#include <algorithm>
+#include <unordered_map>
+
+#include "cfg.h"
+#include "digraph.h"
+#include "stats.h"
+
+using namespace std;
+
+namespace cfg {
+    grammar augment(const grammar& g) {
+        assert(g.size() > 0);
+        auto start = g.start_symbol();
+        symbol new_start = start + "'";
+        while (g.id_of(new_start) != no_symbol) { new_start += "'"; }
+        sequence<production> new_productions{{new_start, {start}}};
+        for (auto&& p : g.prods) {
+            new_productions.push_back(p);
+        }
+        return grammar{new_productions};
+    }
+
+    set<item> compute_closure(set<item> I, const grammar& g) {
+        set<item> closure{I};
+
+        bool workDone = true;
+        while (workDone) {
+            workDone = false;
+            CFG_COUNT("closure.iterations");
+            auto old_size = closure.size();
+            vector<item> to_add;
+            for (auto& it : closure) {
+                auto rhs = g.rhs_ids(it.production_id);
+                if (it.dot_index == int(rhs.size()) || g.is_terminal(rhs[it.dot_index])) {
+                    continue;
+                }
+                for (auto i : g.production_indices(rhs[it.dot_index])) {
+                    to_add.push_back({i,0});
+                }
+            }
+            closure.insert(to_add.begin(), to_add.end());
+            workDone = old_size != closure.size();
+        }
+        return closure;
+    }
+
+    set<item> compute_goto(const set<item>& I, const symbol& X, const grammar& g) {
+        CFG_COUNT("goto.calls");
+        set<item> goto_set;
+        auto x = g.id_of(X);
+        for (auto&& it : I) {
+            auto rhs = g.rhs_ids(it.production_id);
+            if (it.dot_index < int(rhs.size()) && rhs[it.dot_index] == x) {
+                goto_set.insert({it.production_id, it.dot_index+1});
+            }
+        }
+        return compute_closure(goto_set,g);
+    }
+
+    void print_item(ostream& o, item it, const grammar& g) {
+        auto& prod = g[it.production_id];
+        o << "[" << prod.lhs << " -> ";
+        int i = 0;
+        for (auto&& s : prod.rhs) {
+            if (i == it.dot_index) {
+                o << ".";
+            }
+            o << s << " ";
+            ++i;
+        }
+        if (i == it.dot_index) {
+            o << ".";
+        }
+        o << "]";
+    }
+
+    namespace {
+        size_t kernel_hash(const vector<item>& k) {
+            size_t h = k.size();
+            for (auto&& it : k) {
+                h = h * 1000003 ^ (size_t(it.production_id) << 8 ^ it.dot_index);
+            }
+            return h;
+        }
+    }
+
+    lr0_automaton::lr0_automaton(const grammar& g, ostream* diagnostics):
+        g(g), left_corners(g.nonterminal_count(), g.nonterminal_count()) {
+        CFG_PHASE("lr0");
+
+        // A =>* B... is the reflexive transitive closure of "B is the first
+        // symbol of one of A's productions", which is just another digraph
+        // problem.
+        vector<pair<int, int>> first_symbol;
+        for (int i = 0; i < g.size(); ++i) {
+            if (g.rhs_size(i) && g.is_nonterminal(g.rhs_ids(i)[0])) {
+                first_symbol.push_back({int(g.lhs_id(i)), int(g.rhs_ids(i)[0])});
+            }
+        }
+        for (int A = 0; A < g.nonterminal_count(); ++A) { left_corners.set(A, A); }
+        digraph(relation(g.nonterminal_count(), first_symbol), left_corners);
+
+        kernel_offsets.push_back(0);
+        edge_offsets.push_back(0);
+        unordered_multimap<size_t, int> by_kernel;
+
+        // Returns the state with this (sorted) kernel, making it if need be.
+        auto add_state = [&](const vector<item>& k) {
+            CFG_COUNT("lr0.gotos");
+            auto h = kernel_hash(k);
+            auto range = by_kernel.equal_range(h);
+            for (auto it = range.first; it != range.second; ++it) {
+                CFG_COUNT("lr0.kernel_compares");
+                auto existing = kernel(it->second);
+                if (existing.size() == k.size() && equal(k.begin(), k.end(), existing.begin())) {
+                    CFG_COUNT("lr0.dedup_hits");
+                    return it->second;
+                }
+            }
+            int state = state_count();
+            kernel_items.insert(kernel_items.end(), k.begin(), k.end());
+            kernel_offsets.push_back(kernel_items.size());
+            by_kernel.insert({h, state});
+            return state;
+        };
+        add_state({{0, 0}});
+
+        vector<item> closure;
+        vector<bits::word> scratch(left_corners.words_per_row());
+        // The kernels of this state's gotos, bucketed by symbol.
+        vector<vector<item>> buckets(g.symbol_count());
+        vector<symbol_id> touched;
+
+        // New states get appended, so this is the worklist.
+        for (int state = 0; state < state_count(); ++state) {
+            closure_into(state, closure, scratch.data());
+            for (auto&& it : closure) {
+                auto rhs = g.rhs_ids(it.production_id);
+                if (it.dot_index == int(rhs.size())) { continue; }
+                auto X = rhs[it.dot_index];
+                if (buckets[X].empty()) { touched.push_back(X); }
+                buckets[X].push_back({it.production_id, it.dot_index + 1});
+            }
+
+            sort(touched.begin(), touched.end());
+            for (auto X : touched) {
+                sort(buckets[X].begin(), buckets[X].end());
+                int target = add_state(buckets[X]);
+                edges.push_back({X, target});
+                buckets[X].clear();
+                if (diagnostics) {
+                    *diagnostics << "goto(" << state << ", " << g.name_of(X) << ") = " << target << endl;
+                }
+            }
+            touched.clear();
+            edge_offsets.push_back(edges.size());
+        }
+    }
+
+    void lr0_automaton::closure_into(int state, vector<item>& out, bits::word* scratch) const {
+        auto k = kernel(state);
+        out.assign(k.begin(), k.end());
+        CFG_COUNT("lr0.closures");
+
+        // Every nonterminal we're about to expand is a left corner of
+        // something right after a dot in the kernel.
+        int words = left_corners.words_per_row();
+        fill(scratch, scratch + words, 0);
+        for (auto&& it : k) {
+            auto rhs = g.rhs_ids(it.production_id);
+            if (it.dot_index < int(rhs.size()) && g.is_nonterminal(rhs[it.dot_index])) {
+                bits::or_words(scratch, left_corners.row(rhs[it.dot_index]), words);
+            }
+        }
+        bits::for_each(scratch, words, [&](int B) {
+            CFG_COUNT("lr0.closure_expansions");
+            CFG_ADD("lr0.closure_items", g.production_indices(B).size());
+            for (auto i : g.production_indices(B)) {
+                out.push_back({i, 0});
+            }
+        });
+    }
+
+    vector<item> lr0_automaton::closure(int state) const {
+        vector<item> ret;
+        vector<bits::word> scratch(left_corners.words_per_row());
+        closure_into(state, ret, scratch.data());
+        return ret;
+    }
+
+    int lr0_automaton::transition_index(int state, symbol_id X) const {
+        auto t = transitions(state);
+        auto it = lower_bound(t.begin(), t.end(), X,
+                [](const pair<symbol_id, int>& e, symbol_id X) { return e.first < X; });
+        if (it == t.end() || it->first != X) { return -1; }
+        return it - edges.data();
+    }
+
+    int lr0_automaton::transition(int state, symbol_id X) const {
+        int e = transition_index(state, X);
+        return e < 0 ? -1 : edges[e].second;
+    }
+
+    symbol_id lr0_automaton::accessing_symbol(int state) const {
+        auto it = kernel(state)[0];
+        if (it.dot_index == 0) { return no_symbol; }
+        return g.rhs_ids(it.production_id)[it.dot_index - 1];
+    }
+
+    void lr0_automaton::print_state(ostream& o, int state) const {
+        o << "state " << state << endl;
+        for (auto&& it : closure(state)) {
+            o << "  ";
+            print_item(o, it, g);
+            o << endl;
+        }
+        for (auto&& e : transitions(state)) {
+            o << "  on " << g.name_of(e.first) << " goto " << e.second << endl;
+        }
+    }
+}
+
+ostream& operator<<(ostream& o, const cfg::lr0_automaton& a) {
+    for (int state = 0; state < a.state_count(); ++state) {
+        a.print_state(o, state);
+    }
+    return o;
+}
@@ -0,0 +1,116 @@
+#ifndef LR0_H
+#define LR0_H
+
+//////////////////////////////////////////////////////////////////////////////
+// LR(0) items and the LR(0) automaton (the "canonical collection" of sets
+// of items, plus its goto function), following the dragon book.
+//
+// An item is a production index and a dot position. A state is identified
+// by its kernel: the items with the dot somewhere other than the far left,
+// plus the initial [S' -> .S]. The rest of a state, its closure, is entirely
+// determined by the kernel, so we only store kernels and recompute closures
+// when somebody asks.
+//
+// The builder numbers states in the order it discovers them (state 0 is the
+// initial state), deduplicates them through a hash table keyed on the sorted
+// kernel, and computes the goto of every state exactly once, off a worklist.
+// The transitions are stored explicitly, CSR-style, sorted by symbol.
+//
+// Everything here expects an augmented grammar (see augment()), where
+// production 0 is S' -> S.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <set>
+#include <vector>
+#include <utility>
+#include <iostream>
+
+#include "cfg.h"
+#include "bitset.h"
+
+namespace cfg {
+    struct item {
+        int production_id;
+        int dot_index;
+        bool operator<(const item& it) const {
+            if (production_id < it.production_id) {
+                return true;
+            }
+            if (production_id > it.production_id) {
+                return false;
+            }
+            return dot_index < it.dot_index;
+        }
+        bool operator==(const item& it) const {
+            return production_id == it.production_id && dot_index == it.dot_index;
+        }
+        bool operator!=(const item& it) const { return !(*this == it); }
+    };
+
+    // A copy of g with a new start production S' -> S in front, so that
+    // production i of g is production i+1 of the result. S' is S with
+    // enough primes added to not clash with anything already in g, which
+    // mustn't be empty.
+    grammar augment(const grammar& g);
+
+    // The textbook set-at-a-time operations. The automaton doesn't use
+    // these, but they're handy for checking it and for printing.
+    std::set<item> compute_closure(std::set<item> I, const grammar& g);
+    std::set<item> compute_goto(const std::set<item>& I, const symbol& X, const grammar& g);
+
+    void print_item(std::ostream& o, item it, const grammar& g);
+
+    class lr0_automaton {
+        public:
+            const grammar& g;
+
+            // Builds the whole automaton. If diagnostics is given, every
+            // goto computed gets reported to it.
+            explicit lr0_automaton(const grammar& g, std::ostream* diagnostics = nullptr);
+
+            int state_count() const { return kernel_offsets.size() - 1; }
+
+            span<item> kernel(int state) const {
+                return {kernel_items.data() + kernel_offsets[state],
+                        kernel_items.data() + kernel_offsets[state+1]};
+            }
+            // The kernel followed by the closure items, which are grouped
+            // by LHS.
+            std::vector<item> closure(int state) const;
+
+            // goto(state, X), or -1 if it's empty.
+            int transition(int state, symbol_id X) const;
+            // Every transition has an index in [0, transition_count()),
+            // handy for hanging data off of them. -1 if there's no goto.
+            int transition_count() const { return edges.size(); }
+            int transition_index(int state, symbol_id X) const;
+            int transition_target(int index) const { return edges[index].second; }
+            // All of state's transitions as (symbol, target), sorted by symbol.
+            span<std::pair<symbol_id, int>> transitions(int state) const {
+                return {edges.data() + edge_offsets[state],
+                        edges.data() + edge_offsets[state+1]};
+            }
+
+            // The symbol every transition into state is on (no_symbol
+            // for the initial state).
+            symbol_id accessing_symbol(int state) const;
+
+            void print_state(std::ostream& o, int state) const;
+
+        private:
+            // For each nonterminal A, the nonterminals B with A =>* B...
+            // (A included), as rows over nonterminal IDs.
+            bit_matrix left_corners;
+
+            std::vector<item> kernel_items;
+            std::vector<int> kernel_offsets;
+            std::vector<std::pair<symbol_id, int>> edges;
+            std::vector<int> edge_offsets;
+
+            void closure_into(int state, std::vector<item>& out, bits::word* scratch) const;
+    };
+}
+
+std::ostream& operator<<(std::ostream& o, const cfg::lr0_automaton& a);
+
+#endif
@@ -0,0 +1,303 @@
+#include "lr1.h"
+
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+#include "first.h"
+#include "stats.h"
+
+using namespace std;
+
+namespace cfg {
+    namespace {
+        size_t core_hash(const vector<item>& k) {
+            size_t h = k.size();
+            for (auto&& it : k) {
+                h = h * 1000003 ^ (size_t(it.production_id) << 8 ^ it.dot_index);
+            }
+            return h;
+        }
+
+        // Pager's weak compatibility of two lookahead vectors over the same
+        // core: for all i != j, either (L_i & M_j) | (M_i & L_j) is empty,
+        // or L_i & L_j is nonempty, or M_i & M_j is nonempty.
+        bool weakly_compatible(const bits::word* L, const bits::word* M, int n, int words) {
+            for (int i = 0; i < n; ++i) {
+                for (int j = i + 1; j < n; ++j) {
+                    auto Li = L + i * words, Lj = L + j * words;
+                    auto Mi = M + i * words, Mj = M + j * words;
+                    if (!bits::intersects(Li, Mj, words) && !bits::intersects(Mi, Lj, words)) { continue; }
+                    if (bits::intersects(Li, Lj, words) || bits::intersects(Mi, Mj, words)) { continue; }
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    lr1_automaton::lr1_automaton(const grammar& g):
+        g(g), words(bits::words_for(g.terminal_count() + 1)) {
+        CFG_PHASE("lr1");
+        int columns = lookahead_columns();
+        auto F = compute_first_sets(g);
+
+        int rows = 0;
+        for (int i = 0; i < g.size(); ++i) {
+            suffix_base.push_back(rows);
+            rows += g.rhs_size(i) + 1;
+        }
+        suffix_first = bit_matrix(rows, columns);
+        suffix_nullable.assign(rows, true);
+        for (int i = 0; i < g.size(); ++i) {
+            auto rhs = g.rhs_ids(i);
+            for (int k = int(rhs.size()) - 1; k >= 0; --k) {
+                int r = suffix_base[i] + k;
+                suffix_first.or_row(r, F.first, rhs[k]);
+                if (F.nullable[rhs[k]]) {
+                    suffix_first.or_row(r, r + 1);
+                    suffix_nullable[r] = suffix_nullable[r + 1];
+                }
+                else {
+                    suffix_nullable[r] = false;
+                }
+            }
+        }
+        auto scratch = new_scratch();
+
+        unordered_multimap<size_t, int> by_core;
+        vector<int> work_list;
+        vector<bool> queued;
+
+        // Returns the state this kernel goes to: an existing weakly
+        // compatible state with the same core (grown to include our
+        // lookaheads), or else a brand new one.
+        auto find_or_merge = [&](vector<item>& kernel, vector<bits::word>& lookaheads) {
+            auto h = core_hash(kernel);
+            auto range = by_core.equal_range(h);
+            for (auto it = range.first; it != range.second; ++it) {
+                auto& t = states[it->second];
+                if (t.kernel != kernel) { continue; }
+                if (!weakly_compatible(t.lookaheads.data(), lookaheads.data(), kernel.size(), words)) {
+                    continue;
+                }
+                if (bits::or_words(t.lookaheads.data(), lookaheads.data(), lookaheads.size())
+                    && !queued[it->second]) {
+                    queued[it->second] = true;
+                    work_list.push_back(it->second);
+                }
+                return it->second;
+            }
+            int s = states.size();
+            states.push_back({move(kernel), move(lookaheads), {}});
+            by_core.insert({h, s});
+            queued.push_back(true);
+            work_list.push_back(s);
+            return s;
+        };
+
+        vector<item> start_kernel{{0, 0}};
+        vector<bits::word> start_lookaheads(words);
+        bits::set(start_lookaheads.data(), columns - 1);
+        find_or_merge(start_kernel, start_lookaheads);
+
+        // The successor kernels of a state, bucketed by symbol, as
+        // (item, where its lookaheads come from).
+        vector<vector<pair<item, const bits::word*>>> buckets(g.symbol_count());
+        vector<symbol_id> touched;
+
+        while (work_list.size()) {
+            int s = work_list.back();
+            work_list.pop_back();
+            queued[s] = false;
+
+            auto nonterminals = close(s, scratch);
+            auto& k = states[s].kernel;
+            for (size_t i = 0; i < k.size(); ++i) {
+                auto rhs = g.rhs_ids(k[i].production_id);
+                if (k[i].dot_index == int(rhs.size())) { continue; }
+                auto X = rhs[k[i].dot_index];
+                if (buckets[X].empty()) { touched.push_back(X); }
+                buckets[X].push_back({{k[i].production_id, k[i].dot_index + 1}, lookaheads(s, i)});
+            }
+            for (auto C : nonterminals) {
+                for (auto p : g.production_indices(C)) {
+                    if (g.rhs_size(p) == 0) { continue; }
+                    auto X = g.rhs_ids(p)[0];
+                    if (buckets[X].empty()) { touched.push_back(X); }
+                    buckets[X].push_back({{p, 1}, scratch.lookaheads.row(C)});
+                }
+            }
+
+            // The buckets point into states[s], so copy every successor out
+            // before find_or_merge can grow or move the states.
+            sort(touched.begin(), touched.end());
+            vector<pair<vector<item>, vector<bits::word>>> successors;
+            for (auto X : touched) {
+                auto& b = buckets[X];
+                sort(b.begin(), b.end(), [](const pair<item, const bits::word*>& x,
+                                            const pair<item, const bits::word*>& y) {
+                    return x.first < y.first;
+                });
+                successors.emplace_back();
+                auto& kernel = successors.back().first;
+                auto& lookaheads = successors.back().second;
+                lookaheads.resize(b.size() * words);
+                for (size_t i = 0; i < b.size(); ++i) {
+                    kernel.push_back(b[i].first);
+                    copy(b[i].second, b[i].second + words, lookaheads.begin() + i * words);
+                }
+                b.clear();
+            }
+            vector<pair<symbol_id, int>> edges;
+            for (size_t i = 0; i < touched.size(); ++i) {
+                edges.push_back({touched[i], find_or_merge(successors[i].first, successors[i].second)});
+            }
+            touched.clear();
+            states[s].edges = move(edges);
+        }
+
+        // Revisiting states can leave some of the old successors behind, so
+        // keep just what's reachable from the start, numbered in order.
+        vector<int> renumber(states.size(), -1);
+        vector<int> order{0};
+        renumber[0] = 0;
+        for (size_t i = 0; i < order.size(); ++i) {
+            for (auto&& e : states[order[i]].edges) {
+                if (renumber[e.second] < 0) {
+                    renumber[e.second] = order.size();
+                    order.push_back(e.second);
+                }
+            }
+        }
+        vector<state_data> reachable;
+        for (auto s : order) {
+            reachable.push_back(move(states[s]));
+            for (auto&& e : reachable.back().edges) { e.second = renumber[e.second]; }
+        }
+        states = move(reachable);
+    }
+
+    lr1_automaton::closure_scratch lr1_automaton::new_scratch() const {
+        return {bit_matrix(g.nonterminal_count(), lookahead_columns()),
+                vector<bool>(g.nonterminal_count(), false)};
+    }
+
+    vector<symbol_id> lr1_automaton::close(int state, closure_scratch& c) const {
+        auto& closure_lookaheads = c.lookaheads;
+        auto& in_closure = c.in_closure;
+        for (int C = 0; C < g.nonterminal_count(); ++C) {
+            if (in_closure[C]) {
+                in_closure[C] = false;
+                fill(closure_lookaheads.row(C), closure_lookaheads.row(C) + words, 0);
+            }
+        }
+
+        vector<symbol_id> ret;
+        vector<symbol_id> work_list;
+        vector<bool> queued(g.nonterminal_count(), false);
+
+        // [A -> alpha . C beta, L] puts FIRST(beta) into C's lookaheads,
+        // and L too if beta is nullable.
+        auto add = [&](symbol_id C, int suffix, const bits::word* L) {
+            bool changed = false;
+            if (!in_closure[C]) {
+                in_closure[C] = true;
+                ret.push_back(C);
+                changed = true;
+            }
+            changed |= closure_lookaheads.or_row(C, suffix_first, suffix);
+            if (suffix_nullable[suffix]) {
+                changed |= closure_lookaheads.or_into(C, L);
+            }
+            if (changed && !queued[C]) {
+                queued[C] = true;
+                work_list.push_back(C);
+            }
+        };
+
+        auto k = kernel(state);
+        for (size_t i = 0; i < k.size(); ++i) {
+            auto rhs = g.rhs_ids(k[i].production_id);
+            if (k[i].dot_index < int(rhs.size()) && g.is_nonterminal(rhs[k[i].dot_index])) {
+                add(rhs[k[i].dot_index], suffix_row({k[i].production_id, k[i].dot_index + 1}), lookaheads(state, i));
+            }
+        }
+        while (work_list.size()) {
+            auto C = work_list.back();
+            work_list.pop_back();
+            queued[C] = false;
+            for (auto p : g.production_indices(C)) {
+                if (g.rhs_size(p) && g.is_nonterminal(g.rhs_ids(p)[0])) {
+                    add(g.rhs_ids(p)[0], suffix_row({p, 1}), closure_lookaheads.row(C));
+                }
+            }
+        }
+        return ret;
+    }
+
+    int lr1_automaton::transition(int state, symbol_id X) const {
+        auto t = transitions(state);
+        auto it = lower_bound(t.begin(), t.end(), X,
+                [](const pair<symbol_id, int>& e, symbol_id X) { return e.first < X; });
+        if (it == t.end() || it->first != X) { return -1; }
+        return it->second;
+    }
+
+    vector<pair<int, vector<bits::word>>> lr1_automaton::reductions(int state) const {
+        vector<pair<int, vector<bits::word>>> ret;
+        auto k = kernel(state);
+        for (size_t i = 0; i < k.size(); ++i) {
+            if (k[i].dot_index == g.rhs_size(k[i].production_id)) {
+                auto L = lookaheads(state, i);
+                ret.push_back({k[i].production_id, vector<bits::word>(L, L + words)});
+            }
+        }
+        auto scratch = new_scratch();
+        for (auto C : close(state, scratch)) {
+            for (auto p : g.production_indices(C)) {
+                if (g.rhs_size(p) == 0) {
+                    auto L = scratch.lookaheads.row(C);
+                    ret.push_back({p, vector<bits::word>(L, L + words)});
+                }
+            }
+        }
+        return ret;
+    }
+
+    void lr1_automaton::print_state(ostream& o, int state) const {
+        o << "state " << state << endl;
+        auto k = kernel(state);
+        for (size_t i = 0; i < k.size(); ++i) {
+            o << "  ";
+            print_item(o, k[i], g);
+            o << " {";
+            bits::for_each(lookaheads(state, i), words, [&](int t) {
+                o << " " << (t == g.terminal_count() ? "$" : g.name_of(g.terminal_id(t)));
+            });
+            o << " }" << endl;
+        }
+        for (auto&& e : transitions(state)) {
+            o << "  on " << g.name_of(e.first) << " goto " << e.second << endl;
+        }
+    }
+
+    lr_table build_lr1_table(const grammar& g, const lr1_automaton& a) {
+        lr_table table(g, a.state_count());
+        for (int s = 0; s < a.state_count(); ++s) {
+            for (auto&& e : a.transitions(s)) {
+                table.add_augmented_transition(s, a.g, e.first, e.second);
+            }
+            for (auto&& r : a.reductions(s)) {
+                // [S' -> S .] is where we accept.
+                if (r.first == 0) {
+                    table.add_action(s, table.terminal_columns() - 1, {lr_action::accept, 0});
+                }
+                else {
+                    table.add_augmented_reduction(s, r.first, r.second.data());
+                }
+            }
+        }
+        return table;
+    }
+}
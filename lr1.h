@@ -0,0 +1,102 @@
+#ifndef LR1_H
+#define LR1_H
+
+//////////////////////////////////////////////////////////////////////////////
+// LR(1) automata built by Pager's method ("A Practical General Method for
+// Constructing LR(k) Parsers", Acta Informatica 7, 1977), using his weak
+// compatibility test.
+//
+// The canonical LR(1) construction makes a separate state for every
+// distinct set of (LR(0) item, lookahead) pairs, which is far too many.
+// LALR merges every pair of states with the same LR(0) core, which can
+// manufacture reduce/reduce conflicts. Pager merges two states with the same
+// core only if they're weakly compatible: for every pair of kernel items
+// i != j, either merging can't bring a lookahead of one into the other's
+// set, or the two already shared a lookahead in one of the states anyway.
+// That gives full LR(1) power with a state count close to LALR's.
+//
+// A state is an LR(0) kernel (as in lr0.h) where each kernel item carries
+// its lookahead set as a row of bits over the terminal indices, with
+// end_of_input last. When merging grows a state's lookaheads we revisit it,
+// so its successors get the new lookaheads too, and drop whatever states
+// end up unreachable at the end.
+//
+// As with the LR(0) automaton, g must be an augmented grammar.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <utility>
+#include <iostream>
+
+#include "cfg.h"
+#include "bitset.h"
+#include "lr0.h"
+#include "lr_table.h"
+
+namespace cfg {
+    class lr1_automaton {
+        public:
+            const grammar& g;
+            explicit lr1_automaton(const grammar& g);
+
+            int state_count() const { return states.size(); }
+            // Columns of the lookahead sets: terminals, then end_of_input.
+            int lookahead_columns() const { return g.terminal_count() + 1; }
+
+            span<item> kernel(int state) const {
+                auto& k = states[state].kernel;
+                return {k.data(), k.data() + k.size()};
+            }
+            // The lookaheads of kernel(state)[k].
+            const bits::word* lookaheads(int state, int k) const {
+                return states[state].lookaheads.data() + size_t(k) * words;
+            }
+
+            int transition(int state, symbol_id X) const;
+            span<std::pair<symbol_id, int>> transitions(int state) const {
+                auto& e = states[state].edges;
+                return {e.data(), e.data() + e.size()};
+            }
+
+            // Every reduction of the state, (production, lookaheads). These
+            // are the complete kernel items plus the epsilon productions
+            // from the closure.
+            std::vector<std::pair<int, std::vector<bits::word>>> reductions(int state) const;
+
+            void print_state(std::ostream& o, int state) const;
+
+        private:
+            struct state_data {
+                std::vector<item> kernel;
+                std::vector<bits::word> lookaheads;  // kernel.size() rows
+                std::vector<std::pair<symbol_id, int>> edges;
+            };
+            std::vector<state_data> states;
+            int words;
+
+            // Precomputed FIRST and nullability of every RHS suffix: row
+            // suffix_base[i] + k is about rhs_ids(i)[k...].
+            bit_matrix suffix_first;
+            std::vector<bool> suffix_nullable;
+            std::vector<int> suffix_base;
+
+            // Closure scratch space: the lookaheads every closure item
+            // [C -> . gamma] gets, which only depend on C. Each caller of
+            // close() brings its own, so const queries can run in parallel.
+            struct closure_scratch {
+                bit_matrix lookaheads;
+                std::vector<bool> in_closure;
+            };
+            closure_scratch new_scratch() const;
+            // Fills in c.lookaheads, returning the nonterminals that ended
+            // up in the closure.
+            std::vector<symbol_id> close(int state, closure_scratch& c) const;
+
+            int suffix_row(item it) const { return suffix_base[it.production_id] + it.dot_index; }
+    };
+
+    // The canonical-power LR(1) tables for g, where a is built over augment(g).
+    lr_table build_lr1_table(const grammar& g, const lr1_automaton& a);
+}
+
+#endif
@@ -0,0 +1,104 @@
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "cfg.h"
+#include "mapped_file.h"
+#include "arguments.h"
+#include "lr0.h"
+#include "lr1.h"
+#include "lalr.h"
+#include "lr_table.h"
+#include "lr_parser.h"
+#include "parse_tree.h"
+
+// Shift-reduce parses the tokens on stdin with the grammar in the given file.
+// Usage: ./lr_driver [-1] [-t] [-b repeats] grammar.cfg < tokens
+// The tables are LALR(1), or LR(1) by Pager's method with -1. Tokens are
+// terminal names separated by whitespace. With -t the parse tree gets
+// printed; with -b we just recognize the input that many times and report
+// the throughput.
+
+using namespace std;
+using namespace cfg;
+
+int main(int argc, char* argv[]) {
+    bool print_tree = false;
+    bool lr1 = false;
+    long repeats = 0;
+    int arg = 1;
+    for (; arg < argc - 1; ++arg) {
+        string flag = argv[arg];
+        if (flag == "-t") { print_tree = true; }
+        else if (flag == "-1") { lr1 = true; }
+        else if (flag == "-b" && arg + 1 < argc - 1 && parse_number(argv[arg + 1], repeats)) { ++arg; }
+        else { break; }
+    }
+    if (arg != argc - 1) {
+        cerr << "usage: " << argv[0] << " [-1] [-t] [-b repeats] grammar.cfg < tokens" << endl;
+        return 2;
+    }
+    mapped_file file(argv[arg]);
+    if (!file) {
+        cerr << "can't open " << argv[arg] << endl;
+        return 2;
+    }
+
+    auto G = parse_grammar(file.begin(), file.end());
+    if (G.size() == 0) {
+        cerr << argv[arg] << ": empty grammar" << endl;
+        return 2;
+    }
+    auto Gprime = augment(G);
+    unique_ptr<lr_table> table;
+    if (lr1) {
+        lr1_automaton automaton(Gprime);
+        table.reset(new lr_table(build_lr1_table(G, automaton)));
+    }
+    else {
+        lr0_automaton automaton(Gprime);
+        table.reset(new lr_table(build_lalr_table(G, automaton)));
+    }
+    if (table->conflicts().size()) {
+        cerr << table->conflicts().size() << " conflicts:" << endl;
+        table->report_conflicts(cerr);
+    }
+    lr_parser parser(*table);
+
+    vector<symbol_id> tokens;
+    string bad;
+    if (!read_tokens(G, cin, tokens, &bad)) {
+        cerr << "unknown token " << bad << endl;
+        return 1;
+    }
+    span<symbol_id> input{tokens.data(), tokens.data() + tokens.size()};
+
+    if (repeats > 0) {
+        cout << table->state_count() << " states, tables " << parser.table_bytes()
+             << " bytes packed, " << parser.dense_bytes() << " dense" << endl;
+        auto start = chrono::steady_clock::now();
+        long accepted = 0;
+        for (long r = 0; r < repeats; ++r) {
+            accepted += parser.recognize(input);
+        }
+        chrono::duration<double> took = chrono::steady_clock::now() - start;
+        cout << accepted << "/" << repeats << " accepted, "
+             << tokens.size() * repeats / took.count() / 1e6 << " million tokens/s" << endl;
+        return accepted == repeats ? 0 : 1;
+    }
+
+    size_t error_at;
+    vector<int> reductions;
+    if (!parser.parse(input, reductions, &error_at)) {
+        cout << "syntax error at token " << error_at;
+        if (error_at < tokens.size()) { cout << " (" << G.name_of(tokens[error_at]) << ")"; }
+        else { cout << " (end of input)"; }
+        cout << endl;
+        return 1;
+    }
+    cout << "accepted" << endl;
+    if (print_tree) {
+        cout << parse_tree(G, reductions, parse_tree::derivation_order::reverse_rightmost);
+    }
+}
@@ -0,0 +1,147 @@
+#include "lr_parser.h"
+
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <unordered_map>
+
+using namespace std;
+
+namespace cfg {
+    const int32_t lr_parser::accept_code;
+
+    packed_table::packed_table(const vector<vector<pair<int, int32_t>>>& rows,
+                               vector<int32_t> defaults, int columns):
+        base(rows.size(), 0), defaults(move(defaults)) {
+        // First fit, fullest rows first: they're the hardest to place.
+        vector<int> order(rows.size());
+        iota(order.begin(), order.end(), 0);
+        stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return rows[a].size() > rows[b].size();
+        });
+
+        vector<bool> taken;
+        size_t first_free = 0;
+        int top = 0;
+        for (auto r : order) {
+            auto& row = rows[r];
+            if (row.empty()) { continue; }
+            while (first_free < taken.size() && taken[first_free]) { ++first_free; }
+            // The first slot that's free has to be usable by something.
+            int b = max(0, int(first_free) - row[0].first);
+            for (;; ++b) {
+                bool fits = all_of(row.begin(), row.end(), [&](const pair<int, int32_t>& e) {
+                    return size_t(b + e.first) >= taken.size() || !taken[b + e.first];
+                });
+                if (fits) { break; }
+            }
+            base[r] = b;
+            for (auto&& e : row) {
+                size_t slot = b + e.first;
+                if (slot >= taken.size()) { taken.resize(slot + 1, false); }
+                taken[slot] = true;
+            }
+            top = max(top, b);
+        }
+
+        // Pad it out so base[r] + column is always in bounds.
+        entries.resize(top + columns);
+        for (size_t r = 0; r < rows.size(); ++r) {
+            for (auto&& e : rows[r]) {
+                entries[base[r] + e.first] = {int32_t(r), e.second};
+            }
+        }
+    }
+
+    size_t packed_table::bytes() const {
+        return base.size() * sizeof(base[0]) + defaults.size() * sizeof(defaults[0])
+            + entries.size() * sizeof(entries[0]);
+    }
+
+    namespace {
+        int32_t encode(lr_action a) {
+            switch (a.kind) {
+                case lr_action::shift: return a.value + 1;
+                case lr_action::reduce: return -(a.value + 1);
+                case lr_action::accept: return lr_parser::accept_code;
+                default: return 0;
+            }
+        }
+
+        // The most common eligible value, or none if there aren't any.
+        int32_t most_common(const vector<int32_t>& values, bool (*eligible)(int32_t), int32_t none) {
+            unordered_map<int32_t, int> counts;
+            int32_t best = none;
+            int best_count = 0;
+            for (auto v : values) {
+                if (!eligible(v)) { continue; }
+                int c = ++counts[v];
+                if (c > best_count || (c == best_count && v > best)) {
+                    best = v;
+                    best_count = c;
+                }
+            }
+            return best;
+        }
+    }
+
+    lr_parser::lr_parser(const lr_table& table): g(table.g) {
+        int states = table.state_count();
+        int columns = table.terminal_columns();
+        dense_size = size_t(states) * columns * sizeof(lr_action)
+            + size_t(states) * g.nonterminal_count() * sizeof(int);
+
+        vector<vector<pair<int, int32_t>>> rows(states);
+        vector<int32_t> defaults(states);
+        vector<int32_t> row(columns);
+        for (int s = 0; s < states; ++s) {
+            for (int t = 0; t < columns; ++t) {
+                row[t] = encode(table.action(s, t));
+            }
+            auto is_reduction = [](int32_t v) { return v < 0 && v != accept_code; };
+            defaults[s] = most_common(row, is_reduction, 0);
+            for (int t = 0; t < columns; ++t) {
+                if (row[t] != defaults[s] && !(defaults[s] && row[t] == 0)) {
+                    rows[s].push_back({t, row[t]});
+                }
+            }
+        }
+        actions = packed_table(rows, move(defaults), columns);
+
+        rows.assign(g.nonterminal_count(), {});
+        defaults.assign(g.nonterminal_count(), 0);
+        vector<int32_t> column(states);
+        for (int A = 0; A < g.nonterminal_count(); ++A) {
+            for (int s = 0; s < states; ++s) {
+                column[s] = table.go_to(s, A);
+            }
+            auto is_state = [](int32_t v) { return v >= 0; };
+            defaults[A] = most_common(column, is_state, -1);
+            for (int s = 0; s < states; ++s) {
+                if (column[s] >= 0 && column[s] != defaults[A]) {
+                    rows[A].push_back({s, column[s]});
+                }
+            }
+        }
+        gotos = packed_table(rows, move(defaults), states);
+
+        for (int i = 0; i < g.size(); ++i) {
+            rules.push_back({int32_t(g.lhs_id(i)), g.rhs_size(i)});
+        }
+    }
+
+    bool lr_parser::recognize(span<symbol_id> input, size_t* error_at) const {
+        return run(input, error_at, [](size_t) {}, [](int) {});
+    }
+
+    bool lr_parser::parse(span<symbol_id> input, vector<int>& reductions, size_t* error_at) const {
+        reductions.clear();
+        return run(input, error_at, [](size_t) {}, [&](int p) { reductions.push_back(p); });
+    }
+
+    parse_tree lr_parser::parse(span<symbol_id> input, size_t* error_at) const {
+        vector<int> reductions;
+        if (!parse(input, reductions, error_at)) { return parse_tree(g); }
+        return parse_tree(g, reductions, parse_tree::derivation_order::reverse_rightmost);
+    }
+}
@@ -0,0 +1,178 @@
+#ifndef LR_PARSER_H
+#define LR_PARSER_H
+
+//////////////////////////////////////////////////////////////////////////////
+// A shift-reduce parser driven by compressed LR tables.
+//
+// An lr_table is dense, states x terminals, and almost all of it is error
+// entries. We squeeze it the way yacc and bison do:
+//
+//   default reductions  Each state that reduces at all gets its most common
+//                       reduction as a default, which also takes over its
+//                       error entries. That only delays an error until the
+//                       next shift, which still fails on the same token.
+//   default gotos       Each nonterminal's most common GOTO target.
+//   row displacement    What's left of each row is a sparse set of columns.
+//                       We overlay the rows into one array ("comb vector"),
+//                       sliding each row to the first offset (its base)
+//                       where none of its columns land on a taken slot.
+//                       Every slot records which row owns it, so a lookup
+//                       is one index and one compare:
+//                         e = entries[base[row] + column]
+//                         e.check == row ? e.value : defaults[row]
+//
+// ACTION rows are states and columns terminals; the GOTO table is packed
+// transposed, rows nonterminals and columns states, since that's where the
+// defaults bite. Both come out a small fraction of the dense tables.
+//
+// Actions are encoded as a single int: 0 is error, s + 1 shifts to state s,
+// -(p + 1) reduces by production p of g (as numbered by g, and by
+// grammar::index_of), and accept is its own value.
+//
+// The parser keeps its state stack, and the semantic value stack for
+// callbacks, in contiguous vectors reserved up front. Reductions can build a
+// parse_tree, hand back the reverse rightmost derivation, or call the user
+// back: shift(i) makes the value of token i, and reduce(p, values) makes the
+// value of production p from the values of its right hand side.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <limits>
+#include <cstddef>
+#include <cstdint>
+
+#include "cfg.h"
+#include "lr_table.h"
+#include "parse_tree.h"
+
+namespace cfg {
+    // A table compressed by row displacement; see above.
+    class packed_table {
+        public:
+            packed_table() {}
+            // rows[r] lists (column, value) for the entries of row r that
+            // aren't its default.
+            packed_table(const std::vector<std::vector<std::pair<int, std::int32_t>>>& rows,
+                         std::vector<std::int32_t> defaults, int columns);
+
+            std::int32_t get(int row, int column) const {
+                auto& e = entries[base[row] + column];
+                return e.check == row ? e.value : defaults[row];
+            }
+            std::size_t bytes() const;
+
+            struct entry {
+                std::int32_t check = -1;
+                std::int32_t value = 0;
+            };
+            // The arrays themselves, for writing out (compiled.h).
+            const std::vector<std::int32_t>& bases() const { return base; }
+            const std::vector<std::int32_t>& default_values() const { return defaults; }
+            const std::vector<entry>& slots() const { return entries; }
+
+        private:
+            std::vector<std::int32_t> base;
+            std::vector<std::int32_t> defaults;
+            std::vector<entry> entries;
+    };
+
+    class lr_parser {
+        public:
+            const grammar& g;
+            explicit lr_parser(const lr_table& table);
+
+            static const std::int32_t accept_code = std::numeric_limits<std::int32_t>::min();
+            std::int32_t action(int state, int terminal) const { return actions.get(state, terminal); }
+            int go_to(int state, symbol_id A) const { return gotos.get(A, state); }
+
+            // The packed tables, and what lr_table spends on the same.
+            std::size_t table_bytes() const { return actions.bytes() + gotos.bytes(); }
+            std::size_t dense_bytes() const { return dense_size; }
+            const packed_table& action_table() const { return actions; }
+            const packed_table& goto_table() const { return gotos; }
+
+            // On failure *error_at (if given) is the index of the token we
+            // choked on, input.size() if it was the end of input.
+            bool recognize(span<symbol_id> input, std::size_t* error_at = nullptr) const;
+            // The productions in the order we reduced by them: a rightmost
+            // derivation, backwards.
+            bool parse(span<symbol_id> input, std::vector<int>& reductions,
+                       std::size_t* error_at = nullptr) const;
+            // Returns an undeveloped tree on failure.
+            parse_tree parse(span<symbol_id> input, std::size_t* error_at = nullptr) const;
+
+            // Parse with user actions, Value shift(std::size_t token) and
+            // Value reduce(int production, Value* rhs), leaving the value of
+            // the start symbol in result.
+            template <typename Value, typename Shift, typename Reduce>
+            bool parse(span<symbol_id> input, Shift shift, Reduce reduce, Value& result,
+                       std::size_t* error_at = nullptr) const {
+                std::vector<Value> values;
+                values.reserve(initial_stack);
+                bool ok = run(input, error_at,
+                    [&](std::size_t i) { values.push_back(shift(i)); },
+                    [&](int p) {
+                        auto n = g.rhs_size(p);
+                        Value v = reduce(p, values.data() + values.size() - n);
+                        values.erase(values.end() - n, values.end());
+                        values.push_back(std::move(v));
+                    });
+                if (ok) { result = std::move(values.back()); }
+                return ok;
+            }
+
+        private:
+            static const int initial_stack = 256;
+            packed_table actions;
+            packed_table gotos;
+            std::size_t dense_size;
+            // What reducing by each production needs, side by side.
+            struct rule {
+                std::int32_t lhs;
+                std::int32_t length;
+            };
+            std::vector<rule> rules;
+
+            template <typename Shifted, typename Reduced>
+            bool run(span<symbol_id> input, std::size_t* error_at,
+                     Shifted shifted, Reduced reduced) const {
+                const symbol_id N = g.nonterminal_count();
+                const unsigned end = g.terminal_count();
+                std::vector<int> states;
+                states.reserve(initial_stack);
+                states.push_back(0);
+
+                std::size_t i = 0, n = input.size();
+                for (;;) {
+                    // Nonterminals aren't valid input, and wrap around to
+                    // something too big; a real token can't be the end
+                    // marker either.
+                    unsigned t = i < n ? input[i] - N : end;
+                    if (i < n ? t >= end : false) { break; }
+                    auto a = action(states.back(), t);
+                    if (a > 0) {
+                        states.push_back(a - 1);
+                        shifted(i);
+                        ++i;
+                    }
+                    else if (a == accept_code) {
+                        if (i == n) { return true; }
+                        break;
+                    }
+                    else if (a < 0) {
+                        int p = -a - 1;
+                        states.resize(states.size() - rules[p].length);
+                        states.push_back(go_to(states.back(), rules[p].lhs));
+                        reduced(p);
+                    }
+                    else {
+                        break;
+                    }
+                }
+                if (error_at) { *error_at = i; }
+                return false;
+            }
+    };
+}
+
+#endif
@@ -0,0 +1,113 @@
+#include "lr_table.h"
+
+#include <cassert>
+#include <algorithm>
+
+using namespace std;
+
+namespace cfg {
+    bool lr_conflict::is_shift_reduce() const {
+        return any_of(actions.begin(), actions.end(),
+                [](const lr_action& a) { return a.kind == lr_action::shift; });
+    }
+
+    lr_table::lr_table(const grammar& g, int states):
+        g(g), states(states),
+        actions(size_t(states) * (g.terminal_count() + 1), lr_action{lr_action::error, 0}),
+        gotos(size_t(states) * g.nonterminal_count(), -1) {}
+
+    namespace {
+        // Does a beat b? Shifts (and accepting) beat reductions, and the
+        // earlier production beats the later.
+        bool preferred(lr_action a, lr_action b) {
+            if (a.kind != b.kind) { return a.kind != lr_action::reduce; }
+            return a.value < b.value;
+        }
+    }
+
+    void lr_table::add_action(int state, int terminal, lr_action a) {
+        size_t cell = size_t(state) * terminal_columns() + terminal;
+        lr_action& current = actions[cell];
+        if (current.kind == lr_action::error) {
+            current = a;
+            return;
+        }
+        if (current == a) { return; }
+
+        auto it = conflict_cells.find(cell);
+        if (it == conflict_cells.end()) {
+            it = conflict_cells.insert({cell, int(conflict_list.size())}).first;
+            conflict_list.push_back({state, terminal, {current}});
+        }
+        auto& candidates = conflict_list[it->second].actions;
+        if (find(candidates.begin(), candidates.end(), a) != candidates.end()) { return; }
+        candidates.push_back(a);
+        if (preferred(a, current)) {
+            current = a;
+            // Keep the chosen action at the front.
+            iter_swap(candidates.begin(), prev(candidates.end()));
+        }
+    }
+
+    // augment(g) puts S' in front of everything else, so its nonterminals
+    // are off by one from g's, while the terminals are numbered the same.
+    void lr_table::add_augmented_transition(int state, const grammar& augmented, symbol_id X, int target) {
+        if (augmented.is_nonterminal(X)) {
+            set_goto(state, X - 1, target);
+        }
+        else {
+            add_action(state, augmented.terminal_index(X), {lr_action::shift, target});
+        }
+    }
+
+    void lr_table::add_augmented_reduction(int state, int augmented_production, const bits::word* lookaheads) {
+        assert(augmented_production > 0);
+        bits::for_each(lookaheads, bits::words_for(terminal_columns()), [&](int t) {
+            add_action(state, t, {lr_action::reduce, augmented_production - 1});
+        });
+    }
+
+    string lr_table::terminal_name(int terminal) const {
+        if (terminal == g.terminal_count()) { return "$"; }
+        return g.name_of(g.terminal_id(terminal));
+    }
+
+    void lr_table::print_action(ostream& o, lr_action a) const {
+        switch (a.kind) {
+            case lr_action::error: o << "error"; break;
+            case lr_action::shift: o << "shift " << a.value; break;
+            case lr_action::reduce: o << "reduce " << g[a.value]; break;
+            case lr_action::accept: o << "accept"; break;
+        }
+    }
+
+    void lr_table::report_conflicts(ostream& o) const {
+        for (auto&& c : conflict_list) {
+            o << "state " << c.state << ": "
+              << (c.is_shift_reduce() ? "shift/reduce" : "reduce/reduce")
+              << " conflict on " << terminal_name(c.terminal) << endl;
+            for (size_t i = 0; i < c.actions.size(); ++i) {
+                o << (i == 0 ? "  chose " : "     or ");
+                print_action(o, c.actions[i]);
+                o << endl;
+            }
+        }
+    }
+
+    void lr_table::print(ostream& o) const {
+        for (int s = 0; s < states; ++s) {
+            o << "state " << s << endl;
+            for (int t = 0; t < terminal_columns(); ++t) {
+                auto a = action(s, t);
+                if (a.kind == lr_action::error) { continue; }
+                o << "  " << terminal_name(t) << ": ";
+                print_action(o, a);
+                o << endl;
+            }
+            for (int A = 0; A < g.nonterminal_count(); ++A) {
+                if (go_to(s, A) < 0) { continue; }
+                o << "  " << g.name_of(A) << ": goto " << go_to(s, A) << endl;
+            }
+        }
+    }
+}
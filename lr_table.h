@@ -0,0 +1,94 @@
+#ifndef LR_TABLE_H
+#define LR_TABLE_H
+
+//////////////////////////////////////////////////////////////////////////////
+// LR parse tables: the ACTION and GOTO tables of the dragon book, as
+// produced by the LALR(1) and LR(1) constructions.
+//
+// The tables are expressed in terms of the grammar the user gave us, not
+// the augmented grammar the automaton was built from: reductions name
+// production indices of g, columns of ACTION are g's terminal indices plus
+// end_of_input (the last column), and GOTO is indexed by g's nonterminal
+// IDs. Reducing by the augmenting production S' -> S is the accept action.
+//
+// Where the grammar isn't LR, a cell can have several candidate actions.
+// We record all of them in a conflict (a GLR parser wants the lot), and
+// resolve the cell the way yacc does: shift beats reduce, and otherwise the
+// production that comes first in the grammar wins.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+
+#include "cfg.h"
+#include "bitset.h"
+
+namespace cfg {
+    struct lr_action {
+        enum kind_t : std::uint8_t { error, shift, reduce, accept };
+        kind_t kind;
+        // The state to shift to, or the production to reduce by.
+        int value;
+
+        bool operator==(const lr_action& a) const { return kind == a.kind && value == a.value; }
+        bool operator!=(const lr_action& a) const { return !(*this == a); }
+    };
+
+    struct lr_conflict {
+        int state;
+        int terminal;
+        // Every candidate action, the one we chose first.
+        std::vector<lr_action> actions;
+        bool is_shift_reduce() const;
+    };
+
+    class lr_table {
+        public:
+            const grammar& g;
+
+            lr_table(const grammar& g, int states);
+
+            int state_count() const { return states; }
+            // Columns of ACTION: the terminals, then end_of_input.
+            int terminal_columns() const { return g.terminal_count() + 1; }
+
+            const lr_action& action(int state, int terminal) const {
+                return actions[size_t(state) * terminal_columns() + terminal];
+            }
+            // -1 if there's no such transition.
+            int go_to(int state, symbol_id A) const {
+                return gotos[size_t(state) * g.nonterminal_count() + A];
+            }
+            const std::vector<lr_conflict>& conflicts() const { return conflict_list; }
+
+            // Filling in the table, for the constructions.
+            void add_action(int state, int terminal, lr_action a);
+            void set_goto(int state, symbol_id A, int target) {
+                gotos[size_t(state) * g.nonterminal_count() + A] = target;
+            }
+            // The same, but in terms of augment(g), which is what the
+            // automata are built over. A transition on a terminal is a
+            // shift, on a nonterminal a goto. The reduction happens on every
+            // terminal column set in lookaheads.
+            void add_augmented_transition(int state, const grammar& augmented, symbol_id X, int target);
+            void add_augmented_reduction(int state, int augmented_production, const bits::word* lookaheads);
+
+            // The name of a terminal column, "$" for end_of_input.
+            std::string terminal_name(int terminal) const;
+            void print_action(std::ostream& o, lr_action a) const;
+            void report_conflicts(std::ostream& o) const;
+            void print(std::ostream& o) const;
+
+        private:
+            int states;
+            std::vector<lr_action> actions;
+            std::vector<int> gotos;
+            std::vector<lr_conflict> conflict_list;
+            // Cell (state * terminal_columns() + terminal) to its conflict.
+            std::unordered_map<size_t, int> conflict_cells;
+    };
+}
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+//////////////////////////////////////////////////////////////////////////////
+// A whole file, read-only, as one run of bytes [begin(), end()) in memory.
+// Normally that's an mmap of it, so the kernel pages it in as we scan and
+// nothing gets copied; for things that can't be mapped (pipes, /dev/stdin,
+// empty files) it reads the file into a buffer instead. Like an ifstream,
+// it converts to false if the file couldn't be opened.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <string>
+#include <fstream>
+#include <iterator>
+#include <cstddef>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace cfg {
+    class mapped_file {
+        const char* data = nullptr;
+        std::size_t length = 0;
+        bool mapped = false;
+        bool opened = false;
+        std::string buffer;
+
+        public:
+        explicit mapped_file(const std::string& path) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) { return; }
+            opened = true;
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+                void* p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED) {
+                    ::madvise(p, st.st_size, MADV_SEQUENTIAL);
+                    data = static_cast<const char*>(p);
+                    length = st.st_size;
+                    mapped = true;
+                }
+            }
+            ::close(fd);
+            if (!mapped) {
+                std::ifstream in(path, std::ios::binary);
+                buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+                data = buffer.data();
+                length = buffer.size();
+            }
+        }
+        ~mapped_file() {
+            if (mapped) { ::munmap(const_cast<char*>(data), length); }
+        }
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        explicit operator bool() const { return opened; }
+        const char* begin() const { return data; }
+        const char* end() const { return data + length; }
+        std::size_t size() const { return length; }
+    };
+}
+
+#endif
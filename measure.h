@@ -0,0 +1,82 @@
+#ifndef MEASURE_H
+#define MEASURE_H
+
+//////////////////////////////////////////////////////////////////////////////
+// Timing and memory measurement for the benchmarks (bench_lr,
+// bench_analyses, perf_check).
+//
+// best_ms is the best of some repeats, which is less noisy than the mean
+// since anything getting in the way only ever makes a run slower. Anything
+// that takes well under a millisecond is mostly noise even so; ms_per_pass
+// runs it in a loop of enough passes to take at least target_ms first.
+//
+// in_child runs f in a forked child and hands back what it returned, along
+// with the child's peak resident set size. Since the child starts out no
+// bigger than we are, that's the memory f needed, without whatever earlier
+// measurements left behind in this process.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+namespace cfg {
+    template <typename F>
+    double best_ms(int repeats, F f) {
+        double best = 0;
+        for (int i = 0; i < repeats; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            f();
+            std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+            if (i == 0 || took.count() < best) { best = took.count(); }
+        }
+        return best;
+    }
+
+    // The best time of a single f(), out of repeats runs of enough passes
+    // for one run to take target_ms.
+    template <typename F>
+    double ms_per_pass(int repeats, double target_ms, F f) {
+        long passes = 1;
+        auto run = [&]() {
+            for (long i = 0; i < passes; ++i) { f(); }
+        };
+        // Doubling, so this is at most as long again as one run.
+        while (best_ms(1, run) < target_ms) { passes *= 2; }
+        return best_ms(repeats, run) / passes;
+    }
+
+    // The result of f() in a child, which must be something we can send
+    // down a pipe as bytes, and its peak RSS; false if the child didn't
+    // get it back to us.
+    template <typename T, typename F>
+    bool in_child(F f, T& result, long& peak_rss_kb) {
+        int fds[2];
+        if (pipe(fds) != 0) { return false; }
+        pid_t child = fork();
+        if (child < 0) {
+            close(fds[0]);
+            close(fds[1]);
+            return false;
+        }
+        if (child == 0) {
+            close(fds[0]);
+            T r = f();
+            ssize_t written = write(fds[1], &r, sizeof(r));
+            _exit(written == sizeof(r) ? 0 : 1);
+        }
+        close(fds[1]);
+        ssize_t got = read(fds[0], &result, sizeof(result));
+        close(fds[0]);
+        int status = 0;
+        struct rusage usage;
+        wait4(child, &status, 0, &usage);
+        // ru_maxrss is in kilobytes on Linux.
+        peak_rss_kb = usage.ru_maxrss;
+        return got == sizeof(result) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+}
+
+#endif
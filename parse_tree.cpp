@@ -7,17 +7,17 @@ using namespace std;
 
 parse_tree::node_state parse_tree::state(node const * n) const {
     if (g.is_terminal(n->my_symbol)) {
-        assert(n->children.size() == 0);
+        assert(n->child_count == 0);
         assert(n->production_index == -1);
         return node_state::terminal_leaf;
     }
     else {
         if (n->production_index == -1) {
-            assert(n->children.size() == 0);
+            assert(n->child_count == 0);
             return node_state::undeveloped_nonterminal;
         }
         else {
-            assert(n->children.size() > 0);
+            assert(int(n->child_count) == g.rhs_size(n->production_index));
             assert(verify_children(n));
             return node_state::developed_nonterminal;
         }
@@ -25,21 +25,10 @@ parse_tree::node_state parse_tree::state(node const * n) const {
 }
 
 bool parse_tree::verify_children(node const * n) const {
-    production p = g[n->production_index];
-
-    auto match_seq = std::mismatch(p.rhs.begin(), p.rhs.end(), n->children.begin(),
-    [](const symbol& s, const std::shared_ptr<node> t) { return s == t->my_symbol; });
-    return match_seq.second == n->children.end();
-}
-
-std::shared_ptr<parse_tree::node> parse_tree::deep_copy(node const* p) const {
-    assert(p != nullptr);
-    auto new_root = make_shared<node>(p->my_symbol);
-    for (auto&& c : p->children) {
-        new_root->children.push_back(deep_copy(c.get()));
-    }
-    new_root->production_index = p->production_index;
-    return new_root;
+    auto rhs = g.rhs_ids(n->production_index);
+    auto kids = children(n);
+    return rhs.size() == kids.size() && std::equal(rhs.begin(), rhs.end(), kids.begin(),
+        [](symbol_id s, const node& t) { return s == t.my_symbol; });
 }
 
 bool parse_tree::internal_apply_production(int production_index) {
@@ -48,21 +37,127 @@ bool parse_tree::internal_apply_production(int production_index) {
     if (state(child) != node_state::undeveloped_nonterminal) {
         return false;
     }
-    production new_production = g[production_index];
-    if (child->my_symbol != new_production.lhs) {
+    if (child->my_symbol != g.lhs_id(production_index)) {
         return false;
     }
     else {
-        for (auto&& s : new_production.rhs) {
-            auto developed_child = make_shared<node>(s);
-            child->children.push_back(developed_child);
-        }
-        child->production_index = production_index;
-        assert(state(child) == node_state::developed_nonterminal);
+        int n = child - arena->data();
+        develop(n, production_index);
+        assert(state(&(*arena)[n]) == node_state::developed_nonterminal);
+        advance_cursor();
         return true;
     }
 }
 
+void parse_tree::advance_cursor() {
+    auto& nodes = *arena;
+    while (cursor.size()) {
+        auto& top = cursor.back();
+        const node& t = nodes[top.n];
+        if (top.next == 0 && t.production_index == -1 && g.is_nonterminal(t.my_symbol)) { return; }
+        if (top.next == t.child_count) {
+            cursor.pop_back();
+            continue;
+        }
+        int c = t.first_child + top.next++;
+        cursor.push_back({c, 0});
+    }
+}
+
+bool parse_tree::path_copy_production(int production_index) {
+    if (cursor.empty()) { return false; }
+    auto& nodes = *arena;
+    node copy = nodes[cursor.back().n];
+    if (copy.my_symbol != g.lhs_id(production_index)) {
+        return false;
+    }
+
+    // New children for the new leaf, then new copies of the sibling runs
+    // on the way back up, each with the new node from the level below.
+    // The cursor follows the new path.
+    copy.production_index = production_index;
+    copy.first_child = append_children(production_index);
+    copy.child_count = g.rhs_size(production_index);
+    for (int i = cursor.size() - 2; i >= 0; --i) {
+        node parent = nodes[cursor[i].n];
+        std::uint32_t changed = parent.first_child + cursor[i].next - 1;
+        std::uint32_t first = nodes.size();
+        for (auto c = parent.first_child; c < parent.first_child + parent.child_count; ++c) {
+            node sibling = c == changed ? copy : nodes[c];
+            nodes.push_back(sibling);
+        }
+        cursor[i+1].n = first + cursor[i].next - 1;
+        parent.first_child = first;
+        copy = parent;
+    }
+    root = nodes.size();
+    cursor[0].n = root;
+    nodes.push_back(copy);
+    advance_cursor();
+    return true;
+}
+
+parse_tree parse_tree::compact() const {
+    // Breadth first, so each run of children stays together.
+    parse_tree t(*this);
+    auto& from = *arena;
+    t.arena = make_shared<vector<node>>();
+    auto& nodes = *t.arena;
+    nodes.reserve(node_count);
+    nodes.push_back(from[root]);
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        auto first = nodes[n].first_child, count = nodes[n].child_count;
+        nodes[n].first_child = nodes.size();
+        nodes.insert(nodes.end(), from.begin() + first, from.begin() + first + count);
+    }
+    // The cursor goes the same way down the new copy.
+    t.root = 0;
+    for (size_t i = 0; i < t.cursor.size(); ++i) {
+        t.cursor[i].n = i == 0 ? 0 : nodes[t.cursor[i-1].n].first_child + t.cursor[i-1].next - 1;
+    }
+    return t;
+}
+
+parse_tree::parse_tree(const grammar& g, const vector<int>& derivation, derivation_order order):
+    g(g), arena(make_shared<vector<node>>(1, node(0))) {
+    auto& nodes = *arena;
+    // Either way we go top down, keeping a stack of the undeveloped leaves
+    // with the next one to develop on top. A rightmost derivation is just
+    // the reductions backwards.
+    bool leftmost = order == derivation_order::leftmost;
+    vector<int> undeveloped{0};
+    auto step = [&](int p) {
+        assert(undeveloped.size());
+        int n = undeveloped.back();
+        undeveloped.pop_back();
+        assert(nodes[n].my_symbol == g.lhs_id(p));
+
+        develop(n, p);
+        int first = nodes[n].first_child, last = first + nodes[n].child_count;
+        if (leftmost) {
+            for (int c = last; c-- > first; ) {
+                if (g.is_nonterminal(nodes[c].my_symbol)) { undeveloped.push_back(c); }
+            }
+        }
+        else {
+            for (int c = first; c < last; ++c) {
+                if (g.is_nonterminal(nodes[c].my_symbol)) { undeveloped.push_back(c); }
+            }
+        }
+    };
+
+    nodes.reserve(1 + derivation.size());
+    if (leftmost) {
+        for (auto p : derivation) { step(p); }
+    }
+    else {
+        for (auto it = derivation.rbegin(); it != derivation.rend(); ++it) { step(*it); }
+        assert(undeveloped.empty());
+    }
+    cursor.assign(1, {0, 0});
+    advance_cursor();
+}
+
 // Given the result of the << operator, be able to create a new tree
 // from that.
 
@@ -81,8 +176,14 @@ pair<size_t, string> parse_tree_line(string line) {
     return make_pair(depth/2, value);
 }
 
-parse_tree::node* parse_tree::read_tree(std::istream& i) {
-    stack<pair<size_t, node*>> working_stack;
+bool parse_tree::read_tree(std::istream& i) {
+    // The lines come in preorder, but the arena wants each node's children
+    // together, so first find everyone's parent and then lay them out
+    // breadth first.
+    vector<symbol_id> symbols;
+    vector<int> parents;
+    vector<bool> epsilon;  // lines with an epsilon_marker under them
+    stack<pair<size_t, int>> working_stack;
     string nextline;
     while(getline(i,nextline)) {
 
@@ -91,38 +192,84 @@ parse_tree::node* parse_tree::read_tree(std::istream& i) {
         tie(depth, value) = parse_tree_line(nextline);
 
         // skip lines we can't parse.
-        if (depth == -1 || value.size() == 0) { continue; }
+        if (depth == size_t(-1) || value.size() == 0) { continue; }
+
+        // The marker goes on its parent, which mustn't have anything else
+        // under it.
+        if (value == epsilon_marker && g.id_of(value) == no_symbol) {
+            while(working_stack.size() && working_stack.top().first >= depth) {
+                working_stack.pop();
+            }
+            if (working_stack.size() == 0) { return false; }
+            int parent = working_stack.top().second;
+            if (epsilon[parent] || !g.is_nonterminal(symbols[parent])) { return false; }
+            epsilon[parent] = true;
+            continue;
+        }
+
+        symbol_id s = g.id_of(value);
+        if (s == no_symbol) { return false; }
 
         // this is our root
         if (working_stack.size() == 0) {
-            if (depth != 0) { return nullptr; } // fail
-            working_stack.push(make_pair(depth, new node(value)));
+            if (depth != 0 || symbols.size()) { return false; } // fail
+            parents.push_back(-1);
         }
         else {
             // pop until we see our parent
-            while(working_stack.top().first >= depth) {
+            while(working_stack.size() && working_stack.top().first >= depth) {
                 working_stack.pop();
             }
 
-            int current_depth = -1;
-            node* current_parent = nullptr;
-
             // can't deal with forests right now.
-            if (working_stack.size() == 0) { return nullptr; }
-            tie(current_depth, current_parent) = working_stack.top();
+            if (working_stack.size() == 0) { return false; }
+            parents.push_back(working_stack.top().second);
+        }
+        working_stack.push(make_pair(depth, int(symbols.size())));
+        symbols.push_back(s);
+        epsilon.push_back(false);
+    }
+    if (symbols.empty()) { return false; }
 
-            // assume everything works as we want, put in error-checking later
-            auto node_to_add = make_shared<node>(value);
+    // Everyone's children, in order, CSR-style.
+    vector<int> child_offsets(symbols.size() + 1, 0);
+    for (size_t k = 1; k < symbols.size(); ++k) { ++child_offsets[parents[k] + 1]; }
+    for (size_t k = 0; k < symbols.size(); ++k) { child_offsets[k+1] += child_offsets[k]; }
+    vector<int> kids(symbols.size());
+    vector<int> filled(child_offsets.begin(), child_offsets.end() - 1);
+    for (size_t k = 1; k < symbols.size(); ++k) { kids[filled[parents[k]]++] = k; }
 
-            // add us to the tree itself
-            current_parent->children.push_back(node_to_add);
+    auto& nodes = *arena;
+    nodes.clear();
+    nodes.reserve(symbols.size());
+    nodes.push_back(node(symbols[0]));
+    terminal_count = g.is_terminal(symbols[0]);
+    vector<int> line_of{0};  // the line each node came from
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        int k = line_of[n];
+        int count = child_offsets[k+1] - child_offsets[k];
+        if (epsilon[k]) {
+            if (count) { return false; }
+            int p = g.index_of(production(g.name_of(symbols[k]), {}));
+            if (p == -1) { return false; }
+            develop(n, p);
+            continue;
+        }
+        // Otherwise a nonterminal leaf is undeveloped.
+        if (count == 0) { continue; }
 
-            // add us to the stack.
-            working_stack.push(make_pair(depth, node_to_add.get()));
+        // Which production is it? There had better be one.
+        sequence<symbol> rhs;
+        for (int c = child_offsets[k]; c < child_offsets[k+1]; ++c) {
+            rhs.push_back(g.name_of(symbols[kids[c]]));
         }
+        int p = g.index_of(production(g.name_of(symbols[k]), rhs));
+        if (p == -1) { return false; }
+
+        develop(n, p);
+        for (int c = child_offsets[k]; c < child_offsets[k+1]; ++c) { line_of.push_back(kids[c]); }
     }
-    while(working_stack.size() > 1) { working_stack.pop(); }
-    return working_stack.top().second;
+    return true;
 }
 
 
@@ -132,7 +279,7 @@ std::ostream& operator<<(std::ostream& o, const cfg::parse_tree& p) {
 }
 
 void parse_tree::print_terminals_dfs(std::ostream& o) {
-    for_each(begin(), end(), [&](node* n) {
-        if (g.is_terminal(n->my_symbol)) { o << n->my_symbol << " "; }
+    for_each(begin(), end(), [&](node const* n) {
+        if (g.is_terminal(n->my_symbol)) { o << g.name_of(n->my_symbol) << " "; }
     });
 }
@@ -30,11 +30,17 @@
 //   3) A developed inner node, which has a nonterminal symbol and a fixed
 //      production, and a sequence of children nodes whose symbols exactly
 //      correspond to those in the prodcuction.
+// An epsilon production makes a developed node with no children, which
+// would print just like an undeveloped leaf, so it gets a child line of
+// epsilon_marker when printed, and reads back developed.
 //////////////////////////////////////////////////////////////////////////////
 
 #include <memory>
+#include <list>
+#include <vector>
 #include <cassert>
 #include <stack>
+#include <cstdint>
 #include <algorithm>
 #include <iterator>
 
@@ -45,6 +51,10 @@ using namespace std;
 #include "cfg.h"
 
 namespace cfg {
+    // Under a node for an epsilon production, in printed trees. A grammar
+    // with a symbol of that name can't tell them apart.
+    const char* const epsilon_marker = "ε";
+
     // An explicit reperesentation of a parse tree.
     // The fundamental action we care about is finding and "developing"
     // a leaf.
@@ -62,97 +72,154 @@ namespace cfg {
             };
 
 
-            // The recursive node type defining our tree.
-            // It is just a container for some bits of data.
+            // The node type defining our tree. Nodes live back to back in
+            // an arena (below), and a node's children are the contiguous
+            // run [first_child, first_child + child_count) of it, since
+            // developing a node appends all its children at once. So a
+            // tree is a single allocation, copying one is a single copy,
+            // and the whole thing goes away at once.
             class node {
                 public:
                     // we assume that g provides productions
                     // in a fixed order, so this characterizer
                     // what production this node entails.
                     int production_index = -1;
-                    std::list<std::shared_ptr<node>> children = {};
-                    const symbol my_symbol;
+                    symbol_id my_symbol;
+                    std::uint32_t first_child = 0;
+                    std::uint32_t child_count = 0;
                 public:
-                    node(const symbol my_symbol): my_symbol(my_symbol) {}
+                    node(symbol_id my_symbol): my_symbol(my_symbol) {}
             };
 
 
             // Not a real iterator, but enough to hook into some basic
-            // std::algorithm stuff.
+            // std::algorithm stuff. Goes over the nodes in preorder.
             class const_iterator : public std::iterator<forward_iterator_tag, node const*>{
                 private:
-                node* t;
-                std::stack<node*> work_list;
-                public:
-                const_iterator (node* t): t(t) {
-                    if (t != nullptr) {
-                        for (auto it = t->children.rbegin(); it != t->children.rend(); ++it) {
-                            work_list.push(it->get());
-                        }
+                const parse_tree* tree;
+                int t;
+                std::vector<int> work_list;
+                void push_children(int n) {
+                    auto& p = (*tree->arena)[n];
+                    for (int c = p.first_child + p.child_count; c-- > int(p.first_child); ) {
+                        work_list.push_back(c);
                     }
                 }
+                public:
+                const_iterator (const parse_tree* tree, int t): tree(tree), t(t) {
+                    if (t >= 0) { push_children(t); }
+                }
                 void operator++() {
                     if (work_list.size()) {
-                        t = work_list.top();
-                        work_list.pop();
-                        for (auto it = t->children.rbegin(); it != t->children.rend(); ++it) {
-                            work_list.push(it->get());
-                        }
+                        t = work_list.back();
+                        work_list.pop_back();
+                        push_children(t);
                     }
                     else {
-                        t = nullptr;
+                        t = -1;
                     }
                 }
-                node* operator*() { return t; }
+                node const* operator*() { return &(*tree->arena)[t]; }
                 bool operator!=(const const_iterator& it) const { return t != it.t; }
                 bool operator==(const const_iterator& it) const { return t == it.t; }
             };
 
-            const_iterator begin() const { return const_iterator{root.get()}; }
-            const_iterator end() const { return const_iterator{nullptr}; } 
-            
+            const_iterator begin() const { return const_iterator{this, root}; }
+            const_iterator end() const { return const_iterator{this, -1}; }
 
-            // These are the only two fields in the parse tree!
-            // The root pointer, and a reference to the grammar.
-            std::shared_ptr<node> root = nullptr;
+
+        public:
+            // Copying the whole tree to develop one leaf costs the size of
+            // the tree. With path copying, the new tree shares the old
+            // one's arena and gets new copies of just the nodes on the
+            // path from the root to the leaf (and their siblings, which
+            // share a run of the arena with them); everything else is
+            // shared. The arena only ever grows, so no tree sees another's
+            // changes, and it goes away with the last tree using it.
+            enum class copy_mode { deep, path };
+        private:
+            // The node arena, where the root is, and a reference to the
+            // grammar. A deep copied tree has its arena to itself, root
+            // first; with path copying the arena holds other trees' nodes
+            // as well.
+            std::shared_ptr<std::vector<node>> arena;
+            int root = 0;
+            copy_mode mode = copy_mode::deep;
+
+            // Where the first undeveloped leaf is, as a preorder walk
+            // paused at it: the path from the root, with how many of each
+            // node's children we've gone into. Empty once there aren't
+            // any. Developing the leaf just resumes the walk, so over a
+            // derivation the whole tree is walked once rather than once a
+            // step; and the path is exactly what path copying copies.
+            struct step {
+                int n;
+                std::uint32_t next;
+            };
+            std::vector<step> cursor;
+            void advance_cursor();
+
+            // Kept up to date as nodes get developed.
+            int node_count = 1;
+            int terminal_count = 0;
+
+            span<node> children(node const* n) const {
+                auto& nodes = *arena;
+                return {nodes.data() + n->first_child, nodes.data() + n->first_child + n->child_count};
+            }
 
             // Assert that children are consistent with the
             // production associated with n.
             bool verify_children(node const* n) const;
 
-            // Given a tree, make a deep copy of it.
-            std::shared_ptr<node> deep_copy(node const* p) const;
-
             // What state is a node in?
             node_state state(node const * n) const;
 
 
             // Helper function to find the "first" undeveloped child
-            node* undeveloped_child() const {
-                auto res = find_if(begin(), end(), [&](node const* t) {
-                    return state(t) == node_state::undeveloped_nonterminal;
-                });
-                if (res == end()) { return nullptr; }
-                return *res;
+            node const* undeveloped_child() const {
+                if (cursor.empty()) { return nullptr; }
+                return &(*arena)[cursor.back().n];
             }
 
+            // Put undeveloped children for production p on the end of the
+            // arena, returning where they start.
+            std::uint32_t append_children(int p) {
+                auto& nodes = *arena;
+                std::uint32_t first = nodes.size();
+                for (auto s : g.rhs_ids(p)) {
+                    nodes.push_back(node(s));
+                    terminal_count += g.is_terminal(s);
+                }
+                node_count += g.rhs_size(p);
+                return first;
+            }
+            // Give nodes[n] the children of production p.
+            void develop(int n, int p) {
+                auto first = append_children(p);
+                auto& nodes = *arena;
+                nodes[n].production_index = p;
+                nodes[n].first_child = first;
+                nodes[n].child_count = g.rhs_size(p);
+            }
 
             // The main action: apply the production g[production_index]
             // to the first undeveloped node. This transforms the tree.
             bool internal_apply_production(int production_index);
-
-            parse_tree(const grammar& g, std::shared_ptr<node> new_root):
-                g(g), root(new_root) { assert(root != nullptr); }
-
-            void print_tree(std::ostream& o, node* p, std::string delim = "") const {
-                // if I'm a leaf, print me
-                if (p->children.size() == 0) {
-                    o << p->my_symbol << delim;
+            // The same, copying the path to the leaf instead.
+            bool path_copy_production(int production_index);
+
+            void print_tree(std::ostream& o, node const* p, std::string delim = "") const {
+                // if I'm a leaf, print me (epsilon nodes have no leaves)
+                if (p->child_count == 0) {
+                    if (p->production_index == -1) {
+                        o << g.name_of(p->my_symbol) << delim;
+                    }
                 }
                 // Otherwise, get to my kids.
                 else {
-                    for(auto&& c : p->children) {
-                        print_tree(o, c.get(), delim);
+                    for(auto&& c : children(p)) {
+                        print_tree(o, &c, delim);
                     }
                 }
             }
@@ -161,59 +228,94 @@ namespace cfg {
                 for (int i = 0; i < 2 *d; ++i) {
                     o << " ";
                 }
-                o << t->my_symbol << endl;
-                for (auto&& c : t->children) {
-                    print_tree_rec(o, c.get(), d+1);
+                o << g.name_of(t->my_symbol) << endl;
+                if (t->child_count == 0 && t->production_index != -1) {
+                    for (int i = 0; i < 2 * (d+1); ++i) {
+                        o << " ";
+                    }
+                    o << epsilon_marker << endl;
+                }
+                for (auto&& c : children(t)) {
+                    print_tree_rec(o, &c, d+1);
                 }
             }
 
-            node* read_tree(std::istream& in);
+            bool read_tree(std::istream& in);
 
         public:
-            parse_tree(const parse_tree& p): g(p.g), root(p.root) {}
-            parse_tree(const grammar& g):
-                g(g), root(new node(g.start_symbol())) {}
+            // The start symbol is always symbol 0.
+            parse_tree(const grammar& g, copy_mode mode = copy_mode::deep):
+                g(g), arena(std::make_shared<std::vector<node>>(1, node(0))), mode(mode),
+                cursor{{0, 0}} {}
+            // Reads what the << operator prints. If it isn't a tree of g,
+            // we're left with the undeveloped start symbol.
             parse_tree(const grammar& g, std::istream& in):
-                g(g), root(read_tree(in)) {}
+                g(g), arena(std::make_shared<std::vector<node>>()) {
+                if (!read_tree(in)) {
+                    arena->assign(1, node(0));
+                    node_count = 1;
+                    terminal_count = 0;
+                }
+                cursor.assign(1, {root, 0});
+                advance_cursor();
+            }
+            // The tree of a derivation, given as the production applied at
+            // each step. A leftmost derivation can stop early, leaving the
+            // rest undeveloped; a rightmost one comes the way an LR parser
+            // reduces, backwards, and has to be complete.
+            enum class derivation_order { leftmost, reverse_rightmost };
+            parse_tree(const grammar& g, const std::vector<int>& derivation,
+                       derivation_order order = derivation_order::leftmost);
 
             // create a new parse tree, a copy of this one but with
             // a production applied
             parse_tree apply_production(int production_index) const {
-                std::shared_ptr<node> new_root = deep_copy(root.get());
-                parse_tree ret_value(g, new_root);
+                if (mode == copy_mode::path) {
+                    // Over a long search the arena would fill up with dead
+                    // trees, so once it's mostly other trees' nodes we
+                    // start a new one.
+                    bool crowded = arena->size() > 16 * std::size_t(node_count) + 4096;
+                    parse_tree ret_value(crowded ? compact() : *this);
+                    ret_value.path_copy_production(production_index);
+                    return ret_value;
+                }
+                parse_tree ret_value(*this);
+                ret_value.arena = std::make_shared<std::vector<node>>();
+                ret_value.arena->reserve(arena->size() + g.rhs_size(production_index));
+                ret_value.arena->assign(arena->begin(), arena->end());
                 ret_value.internal_apply_production(production_index);
                 return ret_value;
             }
             
+            // A copy of just this tree, in an arena of its own. Trees with
+            // an arena to themselves can go to another thread.
+            parse_tree compact() const;
+
             bool has_undeveloped() const {
-                return undeveloped_child() != nullptr;
+                return !cursor.empty();
             }
 
             symbol undeveloped_symbol() const {
-                node* und = undeveloped_child();
+                auto und = undeveloped_child();
                 assert(und != nullptr);
-                return und->my_symbol;
+                return g.name_of(und->my_symbol);
             }
 
             void print_leaves(std::ostream& o, std::string delimiter = " ") const {
-                print_tree(o, root.get(), delimiter);
+                print_tree(o, &(*arena)[root], delimiter);
             }
             void print_tree(std::ostream& o) const {
-                print_tree_rec(o, root.get());
+                print_tree_rec(o, &(*arena)[root]);
             }
 
             int size() const {
-                return std::distance(begin(), end());
+                return node_count;
             }
             int leaf_count() const {
-                return std::count_if(begin(), end(), [&](node const* t) {
-                    return state(t) == node_state::terminal_leaf;
-                });
+                return terminal_count;
             }
             bool is_fully_developed() {
-                return std::none_of(begin(), end(), [&](node const* t) {
-                    return state(t) == node_state::undeveloped_nonterminal;
-                });
+                return cursor.empty();
             }
 
             void print_terminals_dfs(std::ostream& o);
@@ -0,0 +1,69 @@
+#include <string>
+#include <iostream>
+#include "cfg.h"
+#include "mapped_file.h"
+#include "first.h"
+#include "ll1.h"
+#include "lr0.h"
+#include "lalr.h"
+#include "lr_table.h"
+#include "lr_parser.h"
+#include "codegen.h"
+
+// Writes a C++ header to stdout that parses the grammar in the given file:
+// by recursive descent with -rd, or a direct-coded LALR(1) parser with -lr.
+// Usage: ./parsergen -rd|-lr grammar.cfg [namespace]
+// The namespace defaults to the file's name less its directory and
+// extension, with _rd or _lr on the end. See codegen.h for what's in it.
+
+using namespace std;
+using namespace cfg;
+
+int main(int argc, char* argv[]) {
+    string kind = argc > 1 ? argv[1] : "";
+    if ((argc != 3 && argc != 4) || (kind != "-rd" && kind != "-lr")) {
+        cerr << "usage: " << argv[0] << " -rd|-lr grammar.cfg [namespace]" << endl;
+        return 2;
+    }
+    string path = argv[2];
+    mapped_file file(path);
+    if (!file) {
+        cerr << "can't open " << path << endl;
+        return 2;
+    }
+    string name;
+    if (argc == 4) {
+        name = argv[3];
+    }
+    else {
+        name = path.substr(path.find_last_of('/') + 1);
+        name = name.substr(0, name.find('.')) + "_" + kind.substr(1);
+    }
+    name = identifier_for(name);
+
+    auto G = parse_grammar(file.begin(), file.end());
+    if (G.size() == 0) {
+        cerr << path << ": empty grammar" << endl;
+        return 2;
+    }
+    if (kind == "-rd") {
+        grammar_analysis A(G);
+        ll1_parser parser(A);
+        if (!generate_recursive_descent(cout, parser, name)) {
+            cerr << "the grammar isn't LL(1):" << endl;
+            parser.report_conflicts(cerr);
+            return 1;
+        }
+        return 0;
+    }
+
+    auto Gprime = augment(G);
+    lr0_automaton automaton(Gprime);
+    auto table = build_lalr_table(G, automaton);
+    if (table.conflicts().size()) {
+        cerr << table.conflicts().size() << " conflicts, resolved as in the table:" << endl;
+        table.report_conflicts(cerr);
+    }
+    lr_parser parser(table);
+    generate_direct_lr(cout, parser, name);
+}
@@ -0,0 +1,286 @@
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_set>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include "cfg.h"
+#include "mapped_file.h"
+#include "measure.h"
+#include "arguments.h"
+#include "cfg1_to_cfg.h"
+#include "left_recursion.h"
+#include "first.h"
+#include "lr0.h"
+#include "lalr.h"
+#include "lr_table.h"
+#include "lr_parser.h"
+#include "earley.h"
+
+// The performance regression check behind make perf-check: every step from
+// reading a grammar to parsing with it, on the real grammars in inputs/,
+// against the limits in a thresholds file. Usage:
+//   ./perf_check [-n repeats] thresholds.tsv
+//   ./perf_check -w [-n repeats] thresholds.tsv grammar...
+// The thresholds file has a line per grammar and step,
+//   grammar step max_ms max_rss_kb
+// a line
+//   calibration ms
+// and # comments. The first form runs the steps it lists and exits with 1
+// if any took longer or got bigger than allowed (or failed outright). The
+// second measures the grammars given and writes the file, allowing
+// time_margin and rss_margin times what it measured, for when a change is
+// meant to move the numbers.
+//
+// The times are only good for the machine they were written on, so both
+// forms also time a fixed bit of work that has nothing to do with grammars
+// (sorting and hashing some numbers), and the first scales every max_ms by
+// how much longer or shorter that took than when the file was written.
+// That tracks a faster or slower machine well enough to catch a step
+// getting a lot slower, but not to the margins: for that, write the
+// thresholds on the machine that checks them, before the change.
+//
+// A grammar is .cfg, or .cfg1 (the => format, expanded as it's read), with
+// sample tokens in the file of the same name ending .in. The steps are
+//   load            reading the grammar (and the cfg1 expansion)
+//   left_recursion  remove_left_recursion
+//   first_follow    FIRST, FOLLOW and PREDICT
+//   lr0             the LR(0) automaton
+//   lalr            LALR(1) lookaheads, the table and packing it
+//   parse           recognizing the sample
+//   earley          Earley recognizing the sample with the left recursion
+//                   taken out, which checks that the language stayed the
+//                   same too
+// ms is per pass of the step: each of the repeats runs it as many times as
+// it takes to fill pass_target_ms, so even the quick ones are timed over
+// long enough not to be noise, and ms is the best of them over the passes.
+// Like bench_analyses, each step runs in a process of its own, so
+// peak_rss_kb is that step and what it needs.
+
+using namespace std;
+using namespace cfg;
+
+const char* const all_steps[] = {"load", "left_recursion", "first_follow", "lr0", "lalr", "parse", "earley"};
+const double pass_target_ms = 50;
+const double time_margin = 1.75;
+const double rss_margin = 1.5;
+
+// The calibration work, per pass.
+double calibration_ms(int repeats) {
+    return ms_per_pass(repeats, pass_target_ms, []() {
+        mt19937 rng(1);
+        vector<uint32_t> numbers(1 << 16);
+        for (auto& x : numbers) { x = rng(); }
+        sort(numbers.begin(), numbers.end());
+        unordered_set<uint32_t> distinct(numbers.begin(), numbers.end());
+        volatile size_t keep = distinct.size();
+        (void)keep;
+    });
+}
+
+bool ends_with(const string& s, const string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Null if the file won't open.
+unique_ptr<grammar> load_grammar(const string& path) {
+    if (ends_with(path, ".cfg1")) {
+        ifstream in(path);
+        if (!in) { return nullptr; }
+        return unique_ptr<grammar>(new grammar(parse_cfg1_file(in)));
+    }
+    mapped_file file(path);
+    if (!file) { return nullptr; }
+    return unique_ptr<grammar>(new grammar(parse_grammar(file.begin(), file.end())));
+}
+
+string tokens_path(const string& path) {
+    return path.substr(0, path.rfind('.')) + ".in";
+}
+
+bool load_tokens(const grammar& g, const string& path, vector<symbol_id>& tokens) {
+    ifstream in(tokens_path(path));
+    string bad;
+    if (!in || !read_tokens(g, in, tokens, &bad)) {
+        cerr << tokens_path(path) << ": unknown token " << bad << endl;
+        return false;
+    }
+    return true;
+}
+
+// Gets whatever step needs ready, then times it; < 0 if it didn't work out.
+double time_step(const string& step, const string& path, int repeats) {
+    auto timed = [&](auto f) { return ms_per_pass(repeats, pass_target_ms, f); };
+    auto loaded = load_grammar(path);
+    if (!loaded) {
+        cerr << "can't open " << path << endl;
+        return -1;
+    }
+    auto& g = *loaded;
+    if (g.size() == 0) {
+        cerr << path << ": empty grammar" << endl;
+        return -1;
+    }
+    if (step == "load") {
+        return timed([&]() { load_grammar(path); });
+    }
+    if (step == "left_recursion") {
+        return timed([&]() { remove_left_recursion(g); });
+    }
+    if (step == "first_follow") {
+        return timed([&]() {
+            auto F = compute_first_sets(g);
+            auto FOLLOW = compute_follow_sets(g, F);
+            compute_predict_sets(g, F, FOLLOW);
+        });
+    }
+    if (step == "earley") {
+        auto g2 = remove_left_recursion(g);
+        vector<symbol_id> tokens;
+        if (!load_tokens(g2, path, tokens)) { return -1; }
+        span<symbol_id> input{tokens.data(), tokens.data() + tokens.size()};
+        earley_parser parser(g2);
+        bool accepted = true;
+        double ms = timed([&]() { accepted &= parser.recognize(input); });
+        return accepted ? ms : -1;
+    }
+
+    auto Gprime = augment(g);
+    if (step == "lr0") { return timed([&]() { lr0_automaton automaton(Gprime); }); }
+    lr0_automaton automaton(Gprime);
+    if (step == "lalr") {
+        return timed([&]() { lr_parser parser(build_lalr_table(g, automaton)); });
+    }
+    auto table = build_lalr_table(g, automaton);
+    lr_parser parser(table);
+    if (step == "parse") {
+        vector<symbol_id> tokens;
+        if (!load_tokens(g, path, tokens)) { return -1; }
+        span<symbol_id> input{tokens.data(), tokens.data() + tokens.size()};
+        bool accepted = true;
+        double ms = timed([&]() { accepted &= parser.recognize(input); });
+        return accepted ? ms : -1;
+    }
+    return -1;
+}
+
+struct measurement {
+    double ms;
+    long rss_kb;
+};
+
+// Runs the step in a child; false if it failed.
+bool measure(const string& step, const string& path, int repeats, measurement& m) {
+    bool ok = in_child([&]() { return time_step(step, path, repeats); }, m.ms, m.rss_kb);
+    return ok && m.ms >= 0;
+}
+
+struct threshold {
+    string grammar, step;
+    double max_ms;
+    long max_rss_kb;
+};
+
+int main(int argc, char* argv[]) {
+    int repeats = 3;
+    bool write_thresholds = false;
+    bool bad_number = false;
+    int arg = 1;
+    for (; arg < argc; ++arg) {
+        string flag = argv[arg];
+        if (flag == "-w") { write_thresholds = true; }
+        else if (flag == "-n" && arg + 1 < argc) { bad_number |= !parse_number(argv[++arg], repeats); }
+        else { break; }
+    }
+    if (bad_number || arg >= argc || (!write_thresholds && arg + 1 != argc)) {
+        cerr << "usage: " << argv[0] << " [-n repeats] thresholds.tsv" << endl
+             << "       " << argv[0] << " -w [-n repeats] thresholds.tsv grammar..." << endl;
+        return 2;
+    }
+    string thresholds_path = argv[arg++];
+
+    vector<threshold> limits;
+    double calibrated_ms = 0;
+    if (write_thresholds) {
+        for (; arg < argc; ++arg) {
+            for (auto step : all_steps) { limits.push_back({argv[arg], step, 0, 0}); }
+        }
+    }
+    else {
+        ifstream in(thresholds_path);
+        if (!in) {
+            cerr << "can't open " << thresholds_path << endl;
+            return 2;
+        }
+        string line;
+        while (getline(in, line)) {
+            if (line.empty() || line[0] == '#') { continue; }
+            stringstream fields(line);
+            threshold t;
+            if (fields >> t.grammar && t.grammar == "calibration" && fields >> calibrated_ms) { continue; }
+            fields.clear();
+            fields.seekg(0);
+            if (!(fields >> t.grammar >> t.step >> t.max_ms >> t.max_rss_kb)) {
+                cerr << thresholds_path << ": can't read " << line << endl;
+                return 2;
+            }
+            limits.push_back(t);
+        }
+        if (calibrated_ms <= 0) {
+            cerr << thresholds_path << " has no calibration line; make perf-thresholds writes one" << endl;
+            return 2;
+        }
+    }
+
+    // In a child like the steps, so it's in the same state they are.
+    double calibration = 0;
+    long calibration_rss_kb = 0;
+    if (!in_child([&]() { return calibration_ms(repeats); }, calibration, calibration_rss_kb)) {
+        cerr << "can't time the calibration" << endl;
+        return 2;
+    }
+    // How much slower this machine is than the one that wrote the file.
+    double scale = write_thresholds ? 1 : calibration / calibrated_ms;
+    cout << "# calibration " << calibration << " ms, limits scaled by " << scale << endl;
+
+    int regressions = 0;
+    cout << "grammar\tstep\tms\tmax_ms\tpeak_rss_kb\tmax_rss_kb\tresult" << endl;
+    for (auto& t : limits) {
+        measurement m{0, 0};
+        bool ok = measure(t.step, t.grammar, repeats, m);
+        if (write_thresholds && ok) {
+            // Timings wobble more than memory does.
+            t.max_ms = time_margin * m.ms;
+            t.max_rss_kb = long(rss_margin * m.rss_kb);
+        }
+        double max_ms = t.max_ms * scale;
+        const char* result = !ok ? "FAILED" :
+                             m.ms > max_ms ? "SLOWER" :
+                             m.rss_kb > t.max_rss_kb ? "BIGGER" : "ok";
+        if (!ok || m.ms > max_ms || m.rss_kb > t.max_rss_kb) { ++regressions; }
+        cout << t.grammar << "\t" << t.step << "\t" << m.ms << "\t" << max_ms << "\t"
+             << m.rss_kb << "\t" << t.max_rss_kb << "\t" << result << endl;
+    }
+
+    if (write_thresholds) {
+        if (regressions) {
+            cerr << "not writing " << thresholds_path << " with steps failing" << endl;
+            return 1;
+        }
+        ofstream out(thresholds_path);
+        out << "# Limits for perf_check, written by perf_check -w: grammar step max_ms (per pass) max_rss_kb" << endl;
+        out << "calibration\t" << calibration << endl;
+        for (auto& t : limits) {
+            out << t.grammar << "\t" << t.step << "\t" << t.max_ms << "\t" << t.max_rss_kb << endl;
+        }
+        return out ? 0 : 1;
+    }
+    if (regressions) {
+        cerr << regressions << " of " << limits.size() << " steps over their thresholds" << endl;
+        return 1;
+    }
+}
@@ -1,6 +1,37 @@
 #include "cfg.h"
+#include "mapped_file.h"
+#include "first.h"
 #include "parse_tree.h"
-#include <stack>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <string>
+#include <limits>
+#include <sstream>
+#include <iostream>
+
+// Prints the leaves of every parse tree with at most max_leaves terminals,
+// one tree per line, for lambdaGrammar below or the grammar in the given file.
+// Usage: ./print_parse_trees [-j threads] max_leaves [grammar.cfg]
+//
+// It's a depth first search over leftmost derivations, split between
+// threads by work stealing. Each thread has its own deque of trees: it
+// works on the newest one, pushing the trees that come out of it back on
+// the end, and when it runs out it steals the oldest one of some other
+// thread's, which is the one with the most work under it. A thread that
+// finds nothing to steal waits until somebody has pushed more trees (or
+// everything's done) rather than spinning. Each thread
+// prints into its own buffer, flushed a chunk of whole lines at a time, so
+// with more than one thread the lines come out in no particular order; with
+// -j 1 they're in the same order as they always were.
+//
+// Trees that can't get small enough any more are never made: every tree
+// carries the fewest leaves it could end up with (its leaves so far plus
+// the minimum yield of each undeveloped leaf), and developing a leaf by a
+// production changes that by a fixed amount.
 
 using namespace std;
 using namespace cfg;
@@ -19,39 +50,152 @@ const cfg::grammar lambdaGrammar {
     {"N", "n"},
 };
 
-std::list<cfg::parse_tree> all_develop_of_leaf(const parse_tree& p) {
-    std::list<parse_tree> ret_val = {};
-    if (!p.has_undeveloped()) { return ret_val; }
-    symbol to_develop = p.undeveloped_symbol();
+struct task {
+    parse_tree tree;
+    int least;  // the fewest leaves it can end up with
+};
 
-    assert(p.g.is_nonterminal(to_develop));
+struct worker {
+    mutex m;
+    // Every tree here shares its arena only with trees here (and the one
+    // being developed), and we hold m while we add to any of them, so a
+    // thief holding m can safely copy one out.
+    deque<task> tasks;
+    stringstream out;
+};
 
-    for (auto&& production : p.g.productions_from_nonterminal(to_develop)) {
-        int index = p.g.index_of(production);
-        ret_val.push_back(p.apply_production(index));
+int main(int argc, char* argv[]) {
+    int threads = max(1u, thread::hardware_concurrency());
+    int arg = 1;
+    if (arg + 1 < argc && string(argv[arg]) == "-j") {
+        threads = max(1, atoi(argv[arg + 1]));
+        arg += 2;
     }
-    return ret_val;
-}
+    if (arg >= argc || arg + 2 < argc) {
+        cerr << "usage: " << argv[0] << " [-j threads] max_leaves [grammar.cfg]" << endl;
+        return 2;
+    }
+    int max_leaves = atoi(argv[arg]);
+    unique_ptr<grammar> loaded;
+    if (arg + 1 < argc) {
+        mapped_file file(argv[arg + 1]);
+        if (!file) {
+            cerr << "can't open " << argv[arg + 1] << endl;
+            return 2;
+        }
+        loaded.reset(new grammar(parse_grammar(file.begin(), file.end())));
+        if (loaded->size() == 0) {
+            cerr << argv[arg + 1] << ": empty grammar" << endl;
+            return 2;
+        }
+    }
+    const grammar& g = loaded ? *loaded : lambdaGrammar;
 
-int main(int argc, char* argv[]) {
-    parse_tree start(lambdaGrammar);
-    std::stack<parse_tree> work_list;
-    work_list.push(start);
-    while(work_list.size()) {
-        auto x = work_list.top();
-        work_list.pop();
-        if (x.leaf_count() > atoi(argv[1])) {
-            continue;
+    // How much each production adds to the fewest leaves a tree can end
+    // up with; none if it can't end up with any.
+    const int none = numeric_limits<int>::max();
+    auto yield = compute_min_yield(g);
+    vector<int> growth(g.size(), none);
+    for (int p = 0; p < g.size(); ++p) {
+        long total = 0;
+        for (auto s : g.rhs_ids(p)) { total += yield[s]; }
+        if (total < none) { growth[p] = total - yield[g.lhs_id(p)]; }
+    }
+
+    vector<worker> workers(threads);
+    atomic<long> pending(0);
+    // Threads with nothing to do wait on more_work. Whoever pushes trees
+    // while there are any bumps pushes_seen and wakes them; so does
+    // whoever finishes the last tree.
+    mutex idle;
+    condition_variable more_work;
+    atomic<int> sleepers(0);
+    long pushes_seen = 0;
+    auto wake = [&]() {
+        {
+            lock_guard<mutex> lock(idle);
+            ++pushes_seen;
         }
-        if (!x.has_undeveloped()) {
-            x.print_leaves(cout);
-            cout << '\n';
-            //cerr << x << endl;
+        more_work.notify_all();
+    };
+    mutex output;
+    auto flush = [&](worker& w) {
+        lock_guard<mutex> lock(output);
+        cout << w.out.str();
+        w.out.str("");
+    };
+
+    if (yield[0] <= max_leaves) {
+        workers[0].tasks.push_back({parse_tree(g, parse_tree::copy_mode::path), yield[0]});
+        pending = 1;
+    }
+
+    // Take the oldest tree of someone else's, copying it out of their
+    // arena while we hold their lock.
+    auto steal = [&](int me) {
+        for (int k = 1; k < threads; ++k) {
+            worker& victim = workers[(me + k) % threads];
+            unique_lock<mutex> lock(victim.m);
+            if (victim.tasks.empty()) { continue; }
+            task stolen{victim.tasks.front().tree.compact(), victim.tasks.front().least};
+            victim.tasks.pop_front();
+            lock.unlock();
+
+            lock_guard<mutex> mine(workers[me].m);
+            workers[me].tasks.push_back(move(stolen));
+            return true;
         }
-        else {
-            for (auto&& t : all_develop_of_leaf(x)) {
-                work_list.push(t);
+        return false;
+    };
+
+    auto run = [&](int me) {
+        worker& w = workers[me];
+        while (pending > 0) {
+            unique_lock<mutex> lock(w.m);
+            if (w.tasks.empty()) {
+                lock.unlock();
+                // Counted as asleep before looking, so a push we miss
+                // while stealing still bumps pushes_seen.
+                ++sleepers;
+                long seen;
+                {
+                    lock_guard<mutex> l(idle);
+                    seen = pushes_seen;
+                }
+                if (!steal(me)) {
+                    unique_lock<mutex> l(idle);
+                    more_work.wait(l, [&]() { return pushes_seen != seen || pending == 0; });
+                }
+                --sleepers;
+                continue;
+            }
+            task t = move(w.tasks.back());
+            w.tasks.pop_back();
+            if (!t.tree.has_undeveloped()) {
+                lock.unlock();
+                t.tree.print_leaves(w.out);
+                w.out << '\n';
+                if (w.out.tellp() > (1 << 16)) { flush(w); }
+            }
+            else {
+                auto A = g.id_of(t.tree.undeveloped_symbol());
+                bool pushed = false;
+                for (auto p : g.production_indices(A)) {
+                    if (growth[p] == none || t.least + growth[p] > max_leaves) { continue; }
+                    w.tasks.push_back({t.tree.apply_production(p), t.least + growth[p]});
+                    ++pending;
+                    pushed = true;
+                }
+                lock.unlock();
+                if (pushed && sleepers > 0) { wake(); }
             }
+            if (--pending == 0) { wake(); }
         }
-    }
+        flush(w);
+    };
+
+    vector<thread> helpers;
+    for (int i = 1; i < threads; ++i) { helpers.emplace_back(run, i); }
+    run(0);
+    for (auto& h : helpers) { h.join(); }
 }
@@ -0,0 +1,114 @@
+#include "reduce.h"
+
+#include <vector>
+
+#include "first.h"
+#include "stats.h"
+
+using namespace std;
+
+namespace cfg {
+    vector<bool> compute_productive(const grammar& g) {
+        CFG_PHASE("productive");
+        vector<bool> productive(g.symbol_count(), false);
+        for (int t = 0; t < g.terminal_count(); ++t) { productive[g.terminal_id(t)] = true; }
+
+        // Where each nonterminal occurs, by production (with repetition),
+        // and how many of those each production is still waiting on.
+        vector<int> offsets(g.nonterminal_count() + 1, 0);
+        for (int i = 0; i < g.size(); ++i) {
+            for (auto s : g.rhs_ids(i)) {
+                if (g.is_nonterminal(s)) { ++offsets[s+1]; }
+            }
+        }
+        for (int A = 0; A < g.nonterminal_count(); ++A) { offsets[A+1] += offsets[A]; }
+        vector<int> occurs(offsets.back());
+        auto fill = offsets;
+        vector<int> remaining(g.size(), 0);
+        vector<symbol_id> work_list;
+        for (int i = 0; i < g.size(); ++i) {
+            for (auto s : g.rhs_ids(i)) {
+                if (g.is_nonterminal(s)) {
+                    occurs[fill[s]++] = i;
+                    ++remaining[i];
+                }
+            }
+            if (remaining[i] == 0 && !productive[g.lhs_id(i)]) {
+                productive[g.lhs_id(i)] = true;
+                work_list.push_back(g.lhs_id(i));
+            }
+        }
+
+        while (work_list.size()) {
+            auto A = work_list.back();
+            work_list.pop_back();
+            CFG_COUNT("productive.work_list_pops");
+            for (int k = offsets[A]; k < offsets[A+1]; ++k) {
+                int i = occurs[k];
+                if (--remaining[i] == 0 && !productive[g.lhs_id(i)]) {
+                    productive[g.lhs_id(i)] = true;
+                    work_list.push_back(g.lhs_id(i));
+                }
+            }
+        }
+        return productive;
+    }
+
+    namespace {
+        bool all_productive(const grammar& g, int i, const vector<bool>& productive) {
+            for (auto s : g.rhs_ids(i)) {
+                if (!productive[s]) { return false; }
+            }
+            return true;
+        }
+    }
+
+    vector<bool> compute_reachable(const grammar& g, const vector<bool>& productive) {
+        CFG_PHASE("reachable");
+        vector<bool> reachable(g.symbol_count(), false);
+        if (g.nonterminal_count() == 0 || !productive[0]) { return reachable; }
+        reachable[0] = true;
+        vector<symbol_id> work_list{0};
+        while (work_list.size()) {
+            auto A = work_list.back();
+            work_list.pop_back();
+            for (auto i : g.production_indices(A)) {
+                if (!all_productive(g, i, productive)) { continue; }
+                for (auto s : g.rhs_ids(i)) {
+                    if (reachable[s]) { continue; }
+                    reachable[s] = true;
+                    if (g.is_nonterminal(s)) { work_list.push_back(s); }
+                }
+            }
+        }
+        return reachable;
+    }
+
+    reduced_grammar reduce(const grammar& g) {
+        CFG_PHASE("reduce");
+        if (g.size() == 0) { return {g, {}, {}, {}, {}}; }
+        auto productive = compute_productive(g);
+        auto reachable = compute_reachable(g, productive);
+
+        // A reachable LHS is productive, so that leaves the RHS.
+        sequence<production> kept;
+        vector<int> original;
+        auto keep = [&](int i) {
+            if (reachable[g.lhs_id(i)] && all_productive(g, i, productive)) {
+                kept.push_back(g[i]);
+                original.push_back(i);
+            }
+        };
+        for (auto i : g.production_indices(0)) { keep(i); }
+        for (int i = 0; i < g.size(); ++i) {
+            if (g.lhs_id(i) != 0) { keep(i); }
+        }
+        CFG_ADD("reduce.useless_productions", g.size() - kept.size());
+
+        if (kept.empty()) {
+            auto& S = g.name_of(0);
+            kept.emplace_back(S, sequence<symbol>{S});
+        }
+        return {grammar(kept), move(original), compute_nullable(g), move(productive), move(reachable)};
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef REDUCE_H
+#define REDUCE_H
+
+//////////////////////////////////////////////////////////////////////////////
+// Taking the useless symbols out of a grammar, so they don't cost anything
+// in the analyses and LR automata after. A symbol is useless if it can't
+// derive a string of terminals (it's unproductive) or can't be got to from
+// the start symbol through productions that can (it's unreachable); a
+// production is useless if anything in it is. Everything is linear in the
+// size of the grammar:
+//
+//   1) Productive symbols by the same counter-based worklist as
+//      compute_nullable (first.h): each production counts down its RHS
+//      nonterminals not known to be productive yet, and when it gets to
+//      zero its LHS is productive. Terminals are to begin with.
+//   2) Reachable symbols by a search from the start symbol, only going
+//      through productions whose RHS is all productive (the order matters:
+//      the other way round can leave unreachable symbols behind).
+//
+// The reduced grammar keeps the useful productions in their order, but
+// with the start symbol's first, so it's still the start symbol. Its IDs
+// are its own, since symbols drop out; original maps each production back
+// to its index in the grammar it came from.
+//
+// If the start symbol isn't productive, the language is empty and nothing
+// is useful. Then the reduced grammar is just S -> S, which has the same
+// (empty) language, rather than no productions, which would lose S; and
+// original is empty. A grammar with no productions at all (as read_grammar
+// gives for empty input) has no symbols to keep or lose, and reduces to
+// itself, with every vector empty.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+
+#include "cfg.h"
+
+namespace cfg {
+    // Over symbol IDs.
+    std::vector<bool> compute_productive(const grammar& g);
+    std::vector<bool> compute_reachable(const grammar& g, const std::vector<bool>& productive);
+
+    struct reduced_grammar {
+        grammar g;
+        std::vector<int> original;
+        // Of the grammar it came from, by its symbol IDs.
+        std::vector<bool> nullable, productive, reachable;
+
+        bool empty_language() const { return original.empty(); }
+    };
+
+    reduced_grammar reduce(const grammar& g);
+}
+
+#endif
@@ -0,0 +1,113 @@
+#include "sppf.h"
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+
+namespace cfg {
+    int sppf::add_node(symbol_id X, uint32_t start, uint32_t end) {
+        auto r = index.insert({{uint64_t(X) << 32 | start, end}, int(nodes.size())});
+        if (r.second) { nodes.push_back({X, start, end, {}}); }
+        return r.first->second;
+    }
+
+    int sppf::find_node(symbol_id X, uint32_t start, uint32_t end) const {
+        auto it = index.find({uint64_t(X) << 32 | start, end});
+        return it == index.end() ? -1 : it->second;
+    }
+
+    bool sppf::add_packed(int node, int p, span<int> children) {
+        for (auto q : nodes[node].packed) {
+            auto c = this->children(q);
+            if (packed_productions[q] == p && c.size() == children.size()
+                && equal(children.begin(), children.end(), c.begin())) {
+                return false;
+            }
+        }
+        nodes[node].packed.push_back(packed_productions.size());
+        packed_productions.push_back(p);
+        kids.insert(kids.end(), children.begin(), children.end());
+        kid_offsets.push_back(kids.size());
+        return true;
+    }
+
+    uint64_t sppf::count_trees(int node) const {
+        const uint64_t most = numeric_limits<uint64_t>::max();
+        auto times = [&](uint64_t a, uint64_t b) { return a && b > most / a ? most : a * b; };
+        auto plus = [&](uint64_t a, uint64_t b) { return a > most - b ? most : a + b; };
+
+        // Depth first, without recursion, since forests can be deep.
+        enum { unseen, open, counted };
+        vector<char> state(nodes.size(), unseen);
+        vector<uint64_t> count(nodes.size(), 0);
+        vector<int> stack{node};
+        while (stack.size()) {
+            int n = stack.back();
+            if (state[n] == unseen) {
+                state[n] = open;
+                for (auto q : nodes[n].packed) {
+                    for (auto c : children(q)) {
+                        // Going round a cycle means infinitely many trees.
+                        if (state[c] == open) { count[n] = most; }
+                        else if (state[c] == unseen) { stack.push_back(c); }
+                    }
+                }
+                continue;
+            }
+            stack.pop_back();
+            if (state[n] == counted) { continue; }
+            state[n] = counted;
+            if (nodes[n].packed.empty()) {
+                count[n] = 1;
+                continue;
+            }
+            uint64_t total = count[n];
+            for (auto q : nodes[n].packed) {
+                uint64_t product = 1;
+                for (auto c : children(q)) { product = times(product, count[c]); }
+                total = plus(total, product);
+            }
+            count[n] = total;
+        }
+        return count[node];
+    }
+
+    bool sppf_trees::next(vector<int>& derivation) {
+        if (done) { return false; }
+        if (started) {
+            // Bump the last choice that can be bumped, and forget the ones
+            // after it: they might not even be met this time.
+            int i = choices.size() - 1;
+            while (i >= 0 && choices[i] + 1 == choice_counts[i]) { --i; }
+            if (i < 0) {
+                done = true;
+                return false;
+            }
+            ++choices[i];
+            choices.resize(i + 1);
+            choice_counts.resize(i + 1);
+        }
+        started = true;
+
+        derivation.clear();
+        size_t visit = 0;
+        vector<int> stack{forest.root};
+        while (stack.size()) {
+            int n = stack.back();
+            stack.pop_back();
+            auto& alternatives = forest.alternatives(n);
+            if (alternatives.empty()) { continue; }
+            if (visit == choices.size()) {
+                choices.push_back(0);
+                choice_counts.push_back(alternatives.size());
+            }
+            int q = alternatives[choices[visit++]];
+            derivation.push_back(forest.production(q));
+            auto c = forest.children(q);
+            stack.insert(stack.end(), c.rbegin(), c.rend());
+        }
+        return true;
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef SPPF_H
+#define SPPF_H
+
+//////////////////////////////////////////////////////////////////////////////
+// Shared packed parse forests, after Rekers (and Scott and Johnstone).
+//
+// An ambiguous sentence can have exponentially many parse trees, but they
+// share most of their pieces. A forest has one symbol node per (symbol,
+// start, end) that derives that part of the input; a nonterminal's symbol
+// node has a packed node for each distinct way of deriving it, which is a
+// production and the symbol nodes of its right hand side. That's
+// polynomial in the length of the input however ambiguous the grammar is.
+//
+// Trees come out one at a time: sppf_trees walks the forest in preorder,
+// picking an alternative at each symbol node it meets, and moves on to the
+// next tree by bumping the last choice that has alternatives left, like an
+// odometer. Each tree is a leftmost derivation, ready for parse_tree.
+//
+// Grammars with cycles (A =>+ A) give forests with cycles, which have
+// infinitely many trees; the forest is still fine, but don't ask for the
+// trees.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include "cfg.h"
+
+namespace cfg {
+    class sppf {
+        public:
+            // The root symbol node, or -1 if the input wasn't in the language.
+            int root = -1;
+
+            int node_count() const { return nodes.size(); }
+            int packed_count() const { return packed_productions.size(); }
+
+            symbol_id symbol(int node) const { return nodes[node].symbol; }
+            std::uint32_t start(int node) const { return nodes[node].start; }
+            std::uint32_t end(int node) const { return nodes[node].end; }
+            // The packed nodes of a nonterminal's node; none for a terminal.
+            const std::vector<int>& alternatives(int node) const { return nodes[node].packed; }
+
+            int production(int packed) const { return packed_productions[packed]; }
+            span<int> children(int packed) const {
+                return {kids.data() + kid_offsets[packed], kids.data() + kid_offsets[packed+1]};
+            }
+
+            // How many trees hang off a node, saturating at UINT64_MAX.
+            std::uint64_t count_trees(int node) const;
+            std::uint64_t count_trees() const { return root < 0 ? 0 : count_trees(root); }
+
+            // Building one: nodes are unique by (symbol, start, end), packed
+            // nodes by (production, children) within their node.
+            int add_node(symbol_id X, std::uint32_t start, std::uint32_t end);
+            int find_node(symbol_id X, std::uint32_t start, std::uint32_t end) const;
+            // Returns whether it was new.
+            bool add_packed(int node, int production, span<int> children);
+
+        private:
+            struct symbol_node {
+                symbol_id symbol;
+                std::uint32_t start;
+                std::uint32_t end;
+                std::vector<int> packed;
+            };
+            std::vector<symbol_node> nodes;
+            std::vector<int> packed_productions;
+            std::vector<int> kids;
+            std::vector<std::uint32_t> kid_offsets{0};
+
+            struct key_hash {
+                std::size_t operator()(const std::pair<std::uint64_t, std::uint32_t>& k) const {
+                    return k.first * 0x9E3779B97F4A7C15ull ^ k.second;
+                }
+            };
+            // (symbol, start) and end to node
+            std::unordered_map<std::pair<std::uint64_t, std::uint32_t>, int, key_hash> index;
+    };
+
+    // Every tree of a forest, lazily. Usage:
+    //   sppf_trees trees(forest);
+    //   std::vector<int> derivation;
+    //   while (trees.next(derivation)) { ... parse_tree(g, derivation) ... }
+    class sppf_trees {
+        public:
+            explicit sppf_trees(const sppf& forest): forest(forest), done(forest.root < 0) {}
+
+            // The next tree as a leftmost derivation; false once there
+            // aren't any more.
+            bool next(std::vector<int>& derivation);
+
+        private:
+            const sppf& forest;
+            bool done;
+            bool started = false;
+            // The alternative picked at each symbol node we met, in the
+            // order we met them, and how many there were to pick from.
+            std::vector<int> choices;
+            std::vector<int> choice_counts;
+    };
+}
+
+#endif
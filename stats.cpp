@@ -0,0 +1,138 @@
+#include "stats.h"
+
+// Nothing here unless the counters are compiled in; see stats.h.
+#ifdef CFG_STATS
+
+#include <map>
+#include <new>
+#include <mutex>
+#include <string>
+#include <cstdlib>
+#include <fstream>
+
+using namespace std;
+
+namespace {
+    // Every operator new, counted for the phases. Per thread, so a phase
+    // only counts what its own thread allocated, not whatever else was
+    // running at the time.
+    thread_local unsigned long long allocations = 0, allocated_bytes = 0;
+
+    // Never freed: counters get bumped from static destructors, and we
+    // write everything out at exit after those may have run.
+    struct registry {
+        mutex lock;
+        map<string, cfg::stats::counter_type> counters;
+        map<string, cfg::stats::phase_totals> phases;
+    };
+    registry& the_registry() {
+        static registry* r = new registry;
+        return *r;
+    }
+
+    void write_at_exit() {
+        string path = getenv("CFG_STATS");
+        if (path == "-") {
+            cfg::stats::write_json(cerr);
+            return;
+        }
+        ofstream out(path);
+        if (!out) {
+            cerr << "can't write the stats to " << path << endl;
+            return;
+        }
+        cfg::stats::write_json(out);
+    }
+
+    struct write_at_exit_if_asked {
+        write_at_exit_if_asked() {
+            the_registry();
+            if (getenv("CFG_STATS")) { atexit(write_at_exit); }
+        }
+    } at_exit;
+
+    // Names are ours, but just in case.
+    void write_string(ostream& o, const string& s) {
+        o << '"';
+        for (char c : s) {
+            if (c == '"' || c == '\\') { o << '\\'; }
+            o << c;
+        }
+        o << '"';
+    }
+}
+
+void* operator new(size_t size) {
+    ++allocations;
+    allocated_bytes += size;
+    if (void* p = malloc(size ? size : 1)) { return p; }
+    throw bad_alloc();
+}
+
+// gcc takes the free for a mismatch, not knowing this is the operator new
+// it would be mismatched with.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    ::operator delete(p);
+}
+
+namespace cfg {
+    namespace stats {
+        counter_type& counter(const char* name) {
+            auto& r = the_registry();
+            lock_guard<mutex> guard(r.lock);
+            return r.counters[name];
+        }
+
+        phase_totals& totals(const char* name) {
+            auto& r = the_registry();
+            lock_guard<mutex> guard(r.lock);
+            return r.phases[name];
+        }
+
+        phase::phase(const char* name):
+            t(totals(name)), start(chrono::steady_clock::now()),
+            start_allocations(allocations), start_bytes(allocated_bytes) {}
+
+        phase::~phase() {
+            chrono::nanoseconds took = chrono::steady_clock::now() - start;
+            t.calls.fetch_add(1, memory_order_relaxed);
+            t.nanoseconds.fetch_add(took.count(), memory_order_relaxed);
+            t.allocations.fetch_add(allocations - start_allocations, memory_order_relaxed);
+            t.allocated_bytes.fetch_add(allocated_bytes - start_bytes, memory_order_relaxed);
+        }
+
+        void write_json(ostream& o) {
+            auto& r = the_registry();
+            lock_guard<mutex> guard(r.lock);
+            o << "{\"counters\": {";
+            const char* separator = "";
+            for (auto&& c : r.counters) {
+                o << separator << "\n  ";
+                write_string(o, c.first);
+                o << ": " << c.second.load();
+                separator = ",";
+            }
+            o << "},\n \"phases\": {";
+            separator = "";
+            for (auto&& p : r.phases) {
+                o << separator << "\n  ";
+                write_string(o, p.first);
+                o << ": {\"calls\": " << p.second.calls.load()
+                  << ", \"ms\": " << p.second.nanoseconds.load() / 1e6
+                  << ", \"allocations\": " << p.second.allocations.load()
+                  << ", \"allocated_bytes\": " << p.second.allocated_bytes.load() << "}";
+                separator = ",";
+            }
+            o << "}}" << endl;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef STATS_H
+#define STATS_H
+
+//////////////////////////////////////////////////////////////////////////////
+// Counters and phase timings for finding out where an analysis spends its
+// time. They're compiled in with -DCFG_STATS (make STATS=1) and to nothing
+// at all otherwise, so they can sit in inner loops.
+//
+//   CFG_COUNT(name)       adds one to the counter name
+//   CFG_ADD(name, n)      adds n, which is evaluated even without the
+//                         counters, but don't give it anything to do
+//   CFG_PHASE(name)       times the rest of the enclosing block: how often
+//                         it ran, the wall time, and how many allocations
+//                         (operator new) and bytes its thread made, nested
+//                         phases included
+//
+// Names are string literals, dotted by module ("first.sweep.iterations").
+// A program built with the counters writes them all out as JSON when it
+// exits, to the file named by the CFG_STATS environment variable ("-" for
+// stderr):
+//
+//   {"counters": {"lr0.gotos": 412, ...},
+//    "phases": {"lr0": {"calls": 1, "ms": 0.31, "allocations": 96,
+//                       "allocated_bytes": 30816}, ...}}
+//
+// The totals are atomic, so analyses on other threads count too.
+//////////////////////////////////////////////////////////////////////////////
+
+#ifdef CFG_STATS
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+
+namespace cfg {
+    namespace stats {
+        typedef std::atomic<unsigned long long> counter_type;
+
+        // The counter called name, made at zero the first time.
+        counter_type& counter(const char* name);
+
+        struct phase_totals {
+            counter_type calls{0};
+            counter_type nanoseconds{0};
+            counter_type allocations{0};
+            counter_type allocated_bytes{0};
+        };
+        phase_totals& totals(const char* name);
+
+        class phase {
+            public:
+                explicit phase(const char* name);
+                ~phase();
+                phase(const phase&) = delete;
+                phase& operator=(const phase&) = delete;
+            private:
+                phase_totals& t;
+                std::chrono::steady_clock::time_point start;
+                unsigned long long start_allocations, start_bytes;
+        };
+
+        // Everything so far, in the format above.
+        void write_json(std::ostream& o);
+    }
+}
+
+#define CFG_STATS_JOIN2(a, b) a##b
+#define CFG_STATS_JOIN(a, b) CFG_STATS_JOIN2(a, b)
+// The counter is looked up once per call site.
+#define CFG_ADD(name, n) do { \
+        static auto& cfg_stats_counter = ::cfg::stats::counter(name); \
+        cfg_stats_counter.fetch_add((n), std::memory_order_relaxed); \
+    } while (0)
+#define CFG_COUNT(name) CFG_ADD(name, 1)
+#define CFG_PHASE(name) ::cfg::stats::phase CFG_STATS_JOIN(cfg_stats_phase_, __LINE__)(name)
+
+#else
+
+// n still gets evaluated (and then thrown away), so it's never left unused.
+#define CFG_ADD(name, n) ((void)(n))
+#define CFG_COUNT(name) do {} while (0)
+#define CFG_PHASE(name) do {} while (0)
+
+#endif
+
+#endif
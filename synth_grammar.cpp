@@ -0,0 +1,47 @@
+#include <string>
+#include <iostream>
+#include "cfg.h"
+#include "synthetic.h"
+#include "arguments.h"
+
+// Writes a made up grammar to stdout; see synthetic.h for its shape.
+// Usage: ./synth_grammar [-n nonterminals] [-t terminals] [-a alternatives]
+//                        [-l max_rhs_length] [-e nullable] [-r left_recursion]
+//                        [-c chain_depth] [-b back_references] [-s seed]
+// -e, -r and -b are fractions between 0 and 1.
+
+using namespace std;
+using namespace cfg;
+
+int main(int argc, char* argv[]) {
+    synthetic_options options;
+    auto usage = [&]() {
+        cerr << "usage: " << argv[0] << " [-n nonterminals] [-t terminals] [-a alternatives]"
+             << " [-l max_rhs_length] [-e nullable] [-r left_recursion]"
+             << " [-c chain_depth] [-b back_references] [-s seed]" << endl;
+        return 2;
+    };
+    for (int arg = 1; arg < argc; arg += 2) {
+        string flag = argv[arg];
+        if (arg + 1 == argc || flag.size() != 2 || flag[0] != '-') { return usage(); }
+        const char* value = argv[arg + 1];
+        unsigned long long seed = options.seed;
+        bool ok = false;
+        switch (flag[1]) {
+            case 'n': ok = parse_number(value, options.nonterminals); break;
+            case 't': ok = parse_number(value, options.terminals); break;
+            case 'a': ok = parse_number(value, options.alternatives); break;
+            case 'l': ok = parse_number(value, options.max_rhs_length); break;
+            case 'e': ok = parse_number(value, options.nullable); break;
+            case 'r': ok = parse_number(value, options.left_recursion); break;
+            case 'c': ok = parse_number(value, options.chain_depth); break;
+            case 'b': ok = parse_number(value, options.back_references); break;
+            case 's': ok = parse_number(value, seed); options.seed = seed; break;
+            default:
+                cerr << "unknown option " << flag << endl;
+                return 2;
+        }
+        if (!ok) { return usage(); }
+    }
+    cout << synthetic_grammar(options);
+}
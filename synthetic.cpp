@@ -0,0 +1,86 @@
+#include "synthetic.h"
+
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+namespace cfg {
+    namespace {
+        // mt19937_64's output is fixed by the standard but the
+        // distributions aren't, so we do our own.
+        class dice {
+            public:
+                explicit dice(uint64_t seed): rng(seed) {}
+                // Uniform in [0, n).
+                int below(int n) { return rng() % uint64_t(n); }
+                bool chance(double p) { return (rng() >> 11) / 9007199254740992.0 < p; }
+            private:
+                mt19937_64 rng;
+        };
+    }
+
+    grammar synthetic_grammar(const synthetic_options& options) {
+        const int n = max(1, options.nonterminals);
+        const int terminals = max(1, options.terminals);
+        const int depth = max(1, options.chain_depth);
+        const int longest = max(1, options.max_rhs_length);
+        dice roll(options.seed);
+
+        auto nonterminal = [](int i) { return "N" + to_string(i); };
+        auto terminal = [&]() { return "t" + to_string(roll.below(terminals)); };
+        // The last rung of i's ladder.
+        auto ladder_end = [&](int i) { return min(n - 1, (i / depth + 1) * depth - 1); };
+
+        // A symbol for one of i's right hand sides: a terminal, or a
+        // nonterminal from one of the next few ladders, or (if back is
+        // allowed) sometimes any nonterminal up to i.
+        auto symbol_for = [&](int i, bool back) {
+            int later = min(n - 1 - ladder_end(i), options.reach * depth);
+            if (back && roll.chance(options.back_references)) { return nonterminal(roll.below(i + 1)); }
+            if (later == 0 || roll.chance(0.5)) { return terminal(); }
+            return nonterminal(ladder_end(i) + 1 + roll.below(later));
+        };
+        auto rhs_for = [&](int i, int length, bool back) {
+            sequence<symbol> rhs;
+            for (int k = 0; k < length; ++k) {
+                rhs.push_back(k == 0 && roll.chance(options.leading_terminals) ? terminal() : symbol_for(i, back));
+            }
+            return rhs;
+        };
+
+        sequence<production> prods;
+        for (int i = 0; i < n; ++i) {
+            auto A = nonterminal(i);
+            int count = 0;
+
+            auto base = rhs_for(i, 1 + roll.below(longest), false);
+            if (i == ladder_end(i) && i + 1 < n) {
+                base[base.size() > 1 ? 1 + roll.below(base.size() - 1) : 0] = nonterminal(i + 1);
+            }
+            prods.emplace_back(A, move(base));
+            ++count;
+
+            if (i != ladder_end(i)) {
+                prods.emplace_back(A, sequence<symbol>{nonterminal(i + 1)});
+                ++count;
+            }
+            if (roll.chance(options.left_recursion)) {
+                auto rhs = rhs_for(i, 1 + roll.below(max(1, longest - 1)), true);
+                rhs.insert(rhs.begin(), A);
+                prods.emplace_back(A, move(rhs));
+                ++count;
+            }
+            if (roll.chance(options.nullable)) {
+                prods.emplace_back(A, sequence<symbol>{});
+                ++count;
+            }
+            for (; count < options.alternatives; ++count) {
+                prods.emplace_back(A, rhs_for(i, 1 + roll.below(longest), true));
+            }
+        }
+        return grammar(prods);
+    }
+}
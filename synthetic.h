@@ -0,0 +1,58 @@
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+//////////////////////////////////////////////////////////////////////////////
+// Made up grammars of any size, for seeing how the analyses scale: the
+// grammars in inputs/ are too small for a slow algorithm to show.
+//
+// They're shaped a bit like real ones. The nonterminals N0, N1, ... come in
+// ladders of chain_depth, like expression -> term -> factor, each rung with
+// a unit production down to the next. Every nonterminal has a base
+// alternative of terminals (t0, t1, ...) and nonterminals a few ladders
+// further on, and the last rung of each ladder's base alternative mentions
+// the top of the next ladder, so everything is reachable from N0 and
+// derives something. Other alternatives can also refer back to any
+// nonterminal up to their own, which is where the recursion comes from. On
+// top of that a left_recursion fraction of the nonterminals get an
+// alternative A -> A ..., and a nullable fraction an empty one.
+//
+// The same options and seed always give the same grammar, with any
+// standard library.
+//////////////////////////////////////////////////////////////////////////////
+
+#include <cstdint>
+
+#include "cfg.h"
+
+namespace cfg {
+    struct synthetic_options {
+        int nonterminals = 100;
+        int terminals = 100;
+        // Per nonterminal, counting the special ones below.
+        int alternatives = 3;
+        // Right hand sides are 1 to max_rhs_length symbols long.
+        int max_rhs_length = 4;
+        // The fraction of nonterminals with an empty alternative.
+        double nullable = 0.1;
+        // The fraction with a left recursive alternative.
+        double left_recursion = 0.1;
+        // How many nonterminals each chain of unit productions goes
+        // through; 1 for none.
+        int chain_depth = 3;
+        // The fraction of alternatives that start with a terminal, as
+        // most in a real grammar do (a keyword, a bracket). Closures, and
+        // so LR automata, get out of hand if alternatives start with a
+        // nonterminal that starts with a nonterminal that ...
+        double leading_terminals = 0.8;
+        // How often a symbol of a non-base alternative refers back.
+        double back_references = 0.05;
+        // How many ladders on a nonterminal can refer forward to, since
+        // real grammars are local like that too.
+        int reach = 4;
+        std::uint64_t seed = 1;
+    };
+
+    grammar synthetic_grammar(const synthetic_options& options);
+}
+
+#endif
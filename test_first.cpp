@@ -2,6 +2,17 @@
 
 #include "first.h"
 #include "cfg.h"
+#include "mapped_file.h"
+#include "synthetic.h"
+#include "reduce.h"
+
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
 
 using namespace std;
 using namespace cfg;
@@ -171,6 +182,7 @@ TEST_CASE("Scott page 81") {
   //print_set(result_follow);
   //print_set(book_follow);
   REQUIRE(result_follow == book_follow);
+  REQUIRE(compute_follow_scott(simple_calculator) == book_follow);
 
   map<production, set<symbol>> book_predict = {
     {{"program", "stmt_list", "$$"}, {"id", "read", "write", "$$"}},
@@ -203,3 +215,369 @@ TEST_CASE("Scott page 81") {
   //print_set(book_predict);
   REQUIRE(result_predict == book_predict);
 }
+
+TEST_CASE("Bitset engine carries nullable and end-of-input separately") {
+  grammar g = {
+    {"Goal", "Expr"},
+    {"Expr", "Term", "Expr'"},
+    {"Expr'", "+", "Term", "Expr'"},
+    {"Expr'"},
+    {"Term", "num"}
+  };
+  auto F = compute_first_sets(g);
+  REQUIRE(F.nullable[g.id_of("Expr'")]);
+  REQUIRE(!F.nullable[g.id_of("Expr")]);
+  REQUIRE(F.first.count(g.id_of("Expr'")) == 1);
+
+  auto FOLLOW = compute_follow_sets(g, F);
+  // Only the end of input can follow the start symbol...
+  REQUIRE(FOLLOW.count(g.id_of("Goal")) == 1);
+  REQUIRE(FOLLOW.test(g.id_of("Goal"), end_of_input(g)));
+  // ...and it propagates like any other terminal.
+  REQUIRE(FOLLOW.test(g.id_of("Term"), end_of_input(g)));
+
+  auto PREDICT = compute_predict_sets(g, F, FOLLOW);
+  REQUIRE(PREDICT.count(3) == 1);
+  REQUIRE(PREDICT.test(3, end_of_input(g)));
+}
+
+TEST_CASE("The empty grammar has empty sets") {
+  stringstream nothing("");
+  auto g = read_grammar(nothing);
+  REQUIRE(g.size() == 0);
+  for (auto how : {fixpoint::sweep, fixpoint::digraph}) {
+    auto F = compute_first_sets(g, how);
+    auto FOLLOW = compute_follow_sets(g, F, how);
+    REQUIRE(FOLLOW.rows() == 0);
+    REQUIRE(compute_predict_sets(g, F, FOLLOW).rows() == 0);
+  }
+  grammar_analysis A(g);
+  REQUIRE(compute_first(A).empty());
+  REQUIRE(compute_follow(A).empty());
+  REQUIRE(compute_predict(A).empty());
+
+  REQUIRE(compute_productive(g).empty());
+  REQUIRE(compute_reachable(g, {}).empty());
+  auto r = reduce(g);
+  REQUIRE(r.empty_language());
+  REQUIRE(r.g.size() == 0);
+  REQUIRE(r.nullable.empty());
+  REQUIRE(r.productive.empty());
+  REQUIRE(r.reachable.empty());
+}
+
+TEST_CASE("Sweep and digraph fixpoints agree") {
+  grammar cyclic = {
+    // A and B are mutually left-recursive and nullable through C,
+    // so they land in one SCC of both relations.
+    {"S", "A", "end"},
+    {"A", "B", "a"},
+    {"A", "C"},
+    {"B", "A", "b"},
+    {"B", "C", "c", "B"},
+    {"C"},
+    {"C", "C", "d"},
+  };
+  for (auto&& g : {cyclic, grammar{{"S", "S", "+", "S"}, {"S", "n"}}}) {
+    auto sweep = compute_first_sets(g, fixpoint::sweep);
+    auto dg = compute_first_sets(g, fixpoint::digraph);
+    REQUIRE(sweep.first == dg.first);
+    REQUIRE(sweep.nullable == dg.nullable);
+    REQUIRE(compute_follow_sets(g, sweep, fixpoint::sweep) ==
+            compute_follow_sets(g, dg, fixpoint::digraph));
+  }
+}
+
+TEST_CASE("grammar_analysis is shared between queries and threads") {
+  grammar g = {
+    {"S", "A", "B"},
+    {"A", "a"},
+    {"A"},
+    {"B", "b", "B"},
+    {"B"},
+  };
+  grammar_analysis A(g);
+  auto FIRST = compute_first(A);
+  REQUIRE(FIRST == compute_first(g));
+  // Same object every time: it's only computed once.
+  REQUIRE(&A.first() == &A.first());
+  REQUIRE(A.nullable()[g.id_of("S")]);
+  // The engine's functions over the analysis hand back what it kept.
+  REQUIRE(&compute_nullable(A) == &A.nullable());
+  REQUIRE(compute_nullable(A) == compute_nullable(g));
+  REQUIRE(&compute_min_yield(A) == &compute_min_yield(A));
+  REQUIRE(compute_min_yield(A) == compute_min_yield(g));
+  REQUIRE(&compute_first_sets(A) == &A.first());
+  REQUIRE(&compute_follow_sets(A) == &A.follow());
+  REQUIRE(&compute_predict_sets(A) == &A.predict());
+  REQUIRE(compute_follow_scott(A) == compute_follow_scott(g));
+
+  vector<thread> threads;
+  vector<int> counts(4);
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&, i]() { counts[i] = A.predict().count(0); });
+  }
+  for (auto&& t : threads) { t.join(); }
+  for (auto c : counts) { REQUIRE(c == 3); }
+}
+
+TEST_CASE("Minimum yields") {
+  grammar g = {
+    {"S", "A", "B"},
+    {"S", "x", "x", "x", "x"},
+    {"A", "a", "A"},
+    {"A", "B", "B"},
+    {"B", "b"},
+    {"B"},
+    {"C", "C", "c"},
+    {"D", "D"}
+  };
+  auto yield = compute_min_yield(g);
+  REQUIRE(yield[g.id_of("x")] == 1);
+  REQUIRE(yield[g.id_of("B")] == 0);
+  REQUIRE(yield[g.id_of("A")] == 0);
+  REQUIRE(yield[g.id_of("S")] == 0);
+  // Neither derives any terminal string at all.
+  REQUIRE(yield[g.id_of("C")] == INT_MAX);
+  REQUIRE(yield[g.id_of("D")] == INT_MAX);
+
+  grammar h = {
+    {"S", "(", "L", "N", "S", ")"},
+    {"S", "N"},
+    {"S", "(", "S", "S", ")"},
+    {"N", "n"},
+    {"L", "l", "L"},
+    {"L", "l", "l"}
+  };
+  yield = compute_min_yield(h);
+  REQUIRE(yield[h.id_of("N")] == 1);
+  REQUIRE(yield[h.id_of("L")] == 2);
+  REQUIRE(yield[h.id_of("S")] == 1);
+}
+
+TEST_CASE("Grammars read from text intern like the ones built in code") {
+  grammar built = {
+    {"Statement", "if_keyword", "Expression", "then", "Statement"},
+    {"Statement", "Expression", ";"},
+    {"Expression", "Expression", "+", "a_rather_long_identifier_name"},
+    {"Expression", "a_rather_long_identifier_name"},
+    {"Statement"},
+    {"Expression", "Expression", "+", "a_rather_long_identifier_name"}
+  };
+  // Tabs, carriage returns, blank lines, runs of spaces and no newline at
+  // the end.
+  string text =
+    "Statement if_keyword Expression then Statement\r\n"
+    "\n"
+    "  Statement\tExpression   ;\n"
+    "Expression Expression + a_rather_long_identifier_name\n"
+    " \t \r\n"
+    "Expression a_rather_long_identifier_name\n"
+    "Statement\n"
+    "Expression Expression + a_rather_long_identifier_name";
+  auto parsed = parse_grammar(text.data(), text.data() + text.size());
+  stringstream in(text);
+  auto read = read_grammar(in);
+
+  for (auto g : {&parsed, &read}) {
+    REQUIRE(g->size() == built.size());
+    REQUIRE(g->symbol_count() == built.symbol_count());
+    REQUIRE(g->nonterminal_count() == built.nonterminal_count());
+    for (symbol_id x = 0; x < symbol_id(built.symbol_count()); ++x) {
+      REQUIRE(g->name_of(x) == built.name_of(x));
+    }
+    for (int p = 0; p < built.size(); ++p) {
+      REQUIRE((*g)[p] == built[p]);
+      REQUIRE(g->lhs_id(p) == built.lhs_id(p));
+      auto a = g->rhs_ids(p), b = built.rhs_ids(p);
+      REQUIRE(vector<symbol_id>(a.begin(), a.end()) == vector<symbol_id>(b.begin(), b.end()));
+    }
+    // The duplicate maps back to the first.
+    REQUIRE(g->index_of(built[5]) == 2);
+    REQUIRE(g->index_of(built[4]) == 4);
+    REQUIRE(g->index_of(production{"Statement", "then"}) == -1);
+    REQUIRE(g->index_of(production{"Statement", "nowhere"}) == -1);
+    auto statements = g->productions_from_nonterminal("Statement");
+    REQUIRE(statements.size() == 3);
+    REQUIRE(statements[0] == built[0]);
+    REQUIRE(statements[2] == built[4]);
+    vector<production> expressions;
+    for (auto& p : g->productions_from_nonterminal("Expression")) { expressions.push_back(p); }
+    REQUIRE(expressions == vector<production>({built[2], built[3], built[5]}));
+  }
+
+  // And from a mapped file.
+  char path[] = "/tmp/test_first_XXXXXX";
+  int fd = mkstemp(path);
+  REQUIRE(fd >= 0);
+  close(fd);
+  ofstream(path) << text;
+  {
+    mapped_file file(path);
+    REQUIRE(file);
+    REQUIRE(file.size() == text.size());
+    auto mapped = parse_grammar(file.begin(), file.end());
+    REQUIRE(mapped.all_productions() == built.all_productions());
+  }
+  remove(path);
+  REQUIRE(!mapped_file(path));
+}
+
+TEST_CASE("Synthetic grammars have the shape they were asked for") {
+  synthetic_options options;
+  options.nonterminals = 300;
+  options.chain_depth = 4;
+  options.nullable = 0;
+  options.left_recursion = 1;
+  auto g = synthetic_grammar(options);
+  REQUIRE(g.nonterminal_count() == 300);
+  REQUIRE(g.terminal_count() <= options.terminals);
+
+  // Every nonterminal derives something and can be reached from N0.
+  auto yields = compute_min_yield(g);
+  auto nullable = compute_nullable(g);
+  vector<bool> reached(g.nonterminal_count(), false);
+  vector<symbol_id> work = {0};
+  reached[0] = true;
+  while (work.size()) {
+    auto A = work.back();
+    work.pop_back();
+    for (auto p : g.production_indices(A)) {
+      for (auto x : g.rhs_ids(p)) {
+        if (g.is_nonterminal(x) && !reached[x]) {
+          reached[x] = true;
+          work.push_back(x);
+        }
+      }
+    }
+  }
+  int units = 0;
+  for (symbol_id A = 0; A < symbol_id(g.nonterminal_count()); ++A) {
+    REQUIRE(g.name_of(A) == "N" + to_string(A));
+    REQUIRE(yields[A] < INT_MAX);
+    REQUIRE(reached[A]);
+    // No empty alternatives, and a left recursive one each.
+    REQUIRE(!nullable[A]);
+    bool left_recursive = false;
+    for (auto p : g.production_indices(A)) {
+      auto rhs = g.rhs_ids(p);
+      left_recursive = left_recursive || rhs[0] == A;
+      units += rhs.size() == 1 && rhs[0] == A + 1;
+    }
+    REQUIRE(left_recursive);
+  }
+  // Ladders of 4: three unit productions each.
+  REQUIRE(units >= 300 / 4 * 3);
+
+  // Every production is found where it is, bar duplicates.
+  for (int p = 0; p < g.size(); ++p) {
+    auto i = g.index_of(g[p]);
+    REQUIRE(i <= p);
+    REQUIRE(g[i] == g[p]);
+  }
+
+  // The same seed, the same grammar; and nullable ones when asked.
+  REQUIRE(synthetic_grammar(options).all_productions() == g.all_productions());
+  options.seed = 2;
+  REQUIRE(!(synthetic_grammar(options).all_productions() == g.all_productions()));
+  options.nullable = 1;
+  auto all_nullable = compute_nullable(synthetic_grammar(options));
+  REQUIRE(count(all_nullable.begin(), all_nullable.begin() + 300, true) == 300);
+}
+
+TEST_CASE("Reducing drops unproductive and then unreachable symbols") {
+  grammar g = {
+    {"S", "A", "B"},
+    {"S", "C"},
+    {"A", "a"},
+    {"B", "b", "B"},
+    {"C", "c", "D"},
+    {"D", "d"},
+    {"E", "e"},
+    {"C", "F"},
+    {"F", "F", "f"}
+  };
+  auto r = reduce(g);
+  REQUIRE(!r.productive[g.id_of("B")]);
+  REQUIRE(!r.productive[g.id_of("F")]);
+  REQUIRE(r.productive[g.id_of("A")]);
+  // A is only reachable through S -> A B, which is useless.
+  REQUIRE(!r.reachable[g.id_of("A")]);
+  REQUIRE(!r.reachable[g.id_of("E")]);
+  REQUIRE(r.original == vector<int>{1, 4, 5});
+  // S's first production went, but S is still the start symbol.
+  REQUIRE(r.g.start_symbol() == "S");
+  REQUIRE(r.g.all_terminals() == set<symbol>{"c", "d"});
+  for (int i = 0; i < r.g.size(); ++i) {
+    REQUIRE(r.g[i] == g[r.original[i]]);
+  }
+  REQUIRE(!r.empty_language());
+
+  grammar empty = {
+    {"S", "S", "a"},
+    {"S", "B", "S"},
+    {"B", "b"}
+  };
+  auto e = reduce(empty);
+  REQUIRE(e.empty_language());
+  REQUIRE(e.g.size() == 1);
+  REQUIRE(e.g.start_symbol() == "S");
+  REQUIRE(!e.reachable[0]);
+  REQUIRE(e.productive[empty.id_of("B")]);
+}
+
+TEST_CASE("Reducing agrees with the textbook fixpoints on synthetic grammars") {
+  synthetic_options options;
+  options.nonterminals = 400;
+  auto useful = synthetic_grammar(options);
+  // Dead weight: nonterminals D<i> referring to each other and to N<j>, a
+  // third of them with no way out, and N<j> alternatives that use them.
+  mt19937_64 rng(5);
+  sequence<production> prods = useful.all_productions();
+  for (int i = 0; i < 200; ++i) {
+    auto D = "D" + to_string(i);
+    auto other = "D" + to_string(rng() % 200);
+    if (i % 3) { prods.emplace_back(D, sequence<symbol>{"t" + to_string(rng() % 10), "N" + to_string(rng() % 400)}); }
+    prods.emplace_back(D, sequence<symbol>{other, D});
+    if (i % 2) { prods.emplace_back("N" + to_string(rng() % 400), sequence<symbol>{"x", other}); }
+  }
+  grammar g(prods);
+  auto r = reduce(g);
+
+  vector<bool> productive(g.symbol_count(), false), reachable(g.symbol_count(), false);
+  for (int t = 0; t < g.terminal_count(); ++t) { productive[g.terminal_id(t)] = true; }
+  auto all_productive = [&](int i) {
+    auto rhs = g.rhs_ids(i);
+    return all_of(rhs.begin(), rhs.end(), [&](symbol_id s) { return bool(productive[s]); });
+  };
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (int i = 0; i < g.size(); ++i) {
+      if (!productive[g.lhs_id(i)] && all_productive(i)) { productive[g.lhs_id(i)] = changed = true; }
+    }
+  }
+  reachable[0] = true;
+  for (bool changed = true; changed; ) {
+    changed = false;
+    for (int i = 0; i < g.size(); ++i) {
+      if (!reachable[g.lhs_id(i)] || !all_productive(i)) { continue; }
+      for (auto s : g.rhs_ids(i)) {
+        if (!reachable[s]) { reachable[s] = changed = true; }
+      }
+    }
+  }
+  REQUIRE(r.productive == productive);
+  REQUIRE(r.reachable == reachable);
+  REQUIRE(r.nullable == compute_nullable(g));
+
+  // All of the synthetic grammar stays, some of the dead weight goes, and
+  // what's left is already reduced.
+  REQUIRE(count_if(r.original.begin(), r.original.end(),
+                   [&](int i) { return i < useful.size(); }) == useful.size());
+  REQUIRE(r.g.size() < g.size());
+  for (int i = 0; i < r.g.size(); ++i) {
+    REQUIRE(r.g[i] == g[r.original[i]]);
+  }
+  auto again = reduce(r.g);
+  REQUIRE(again.original.size() == size_t(r.g.size()));
+}
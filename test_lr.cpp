@@ -0,0 +1,362 @@
+#include "catch.hpp"
+
+#include <map>
+#include <set>
+#include <random>
+#include <thread>
+#include <algorithm>
+
+#include "cfg.h"
+#include "lr0.h"
+#include "lalr.h"
+#include "lr1.h"
+#include "lr_table.h"
+#include "first.h"
+
+using namespace std;
+using namespace cfg;
+
+// The textbook canonical collection, straight from the dragon book.
+set<set<item>> canonical_collection(const grammar& g) {
+  set<set<item>> C{compute_closure({{0, 0}}, g)};
+  bool workDone = true;
+  while (workDone) {
+    workDone = false;
+    for (auto&& I : C) {
+      for (auto&& X : g.all_symbols()) {
+        auto J = compute_goto(I, X, g);
+        if (J.size() && C.insert(J).second) { workDone = true; }
+      }
+    }
+  }
+  return C;
+}
+
+const grammar expression = {
+  {"E", "E", "+", "T"},
+  {"E", "T"},
+  {"T", "T", "*", "F"},
+  {"T", "F"},
+  {"F", "(", "E", ")"},
+  {"F", "id"}
+};
+
+TEST_CASE("Dragon book expression grammar LR(0) automaton") {
+  auto g = augment(expression);
+  REQUIRE(g.start_symbol() == "E'");
+  lr0_automaton a(g);
+  // Figure 4.31 in the 2nd edition has I0 through I11.
+  REQUIRE(a.state_count() == 12);
+
+  set<set<item>> states;
+  for (int s = 0; s < a.state_count(); ++s) {
+    auto c = a.closure(s);
+    states.insert(set<item>(c.begin(), c.end()));
+    for (auto&& e : a.transitions(s)) {
+      REQUIRE(a.accessing_symbol(e.second) == e.first);
+      REQUIRE(a.transition(s, e.first) == e.second);
+      auto J = compute_goto(set<item>(c.begin(), c.end()), g.name_of(e.first), g);
+      auto t = a.closure(e.second);
+      REQUIRE(J == set<item>(t.begin(), t.end()));
+    }
+  }
+  REQUIRE(states == canonical_collection(g));
+}
+
+TEST_CASE("Augmenting avoids existing names") {
+  grammar g = {{"S", "S'", "x"}, {"S'", "y"}};
+  auto a = augment(g);
+  REQUIRE(a.start_symbol() == "S''");
+  REQUIRE(a.size() == g.size() + 1);
+  REQUIRE(a[1] == g[0]);
+}
+
+TEST_CASE("LALR(1) handles the dragon book's non-SLR grammar") {
+  // Example 4.48 in the 2nd edition: not SLR(1), but LALR(1).
+  grammar g = {
+    {"S", "L", "=", "R"},
+    {"S", "R"},
+    {"L", "*", "R"},
+    {"L", "id"},
+    {"R", "L"}
+  };
+  auto augmented = augment(g);
+  lr0_automaton a(augmented);
+  auto table = build_lalr_table(g, a);
+  REQUIRE(table.conflicts().empty());
+
+  // In the state after L, we only reduce R -> L at the end of input.
+  int after_L = a.transition(0, augmented.id_of("L"));
+  int end = table.terminal_columns() - 1;
+  REQUIRE(table.action(after_L, end) == lr_action{lr_action::reduce, 4});
+  REQUIRE(table.action(after_L, g.terminal_index(g.id_of("="))).kind == lr_action::shift);
+
+  int after_S = a.transition(0, augmented.id_of("S"));
+  REQUIRE(table.action(after_S, end).kind == lr_action::accept);
+  REQUIRE(table.go_to(0, g.id_of("S")) == after_S);
+}
+
+TEST_CASE("LALR(1) reports conflicts in ambiguous grammars") {
+  grammar g = {
+    {"S", "S", "+", "S"},
+    {"S", "S", "*", "S"},
+    {"S", "n"}
+  };
+  auto augmented = augment(g);
+  lr0_automaton a(augmented);
+  auto table = build_lalr_table(g, a);
+  // Both operators, after both S + S and S * S.
+  REQUIRE(table.conflicts().size() == 4);
+  for (auto&& c : table.conflicts()) {
+    REQUIRE(c.is_shift_reduce());
+    // yacc's rule: shifting wins.
+    REQUIRE(c.actions[0].kind == lr_action::shift);
+    REQUIRE(table.action(c.state, c.terminal) == c.actions[0]);
+  }
+}
+
+TEST_CASE("LALR(1) nullable productions get lookaheads through reads") {
+  grammar g = {
+    {"S", "A", "B", "c"},
+    {"A", "a"},
+    {"A"},
+    {"B", "b"},
+    {"B"}
+  };
+  auto augmented = augment(g);
+  lr0_automaton a(augmented);
+  auto table = build_lalr_table(g, a);
+  REQUIRE(table.conflicts().empty());
+  // In the initial state, A -> . is reduced on b or c (through B's reads).
+  for (auto t : {"b", "c"}) {
+    REQUIRE(table.action(0, g.terminal_index(g.id_of(t))) == lr_action{lr_action::reduce, 2});
+  }
+  REQUIRE(table.action(0, g.terminal_index(g.id_of("a"))).kind == lr_action::shift);
+}
+
+TEST_CASE("Pager's LR(1) keeps LALR's states when it can") {
+  grammar g = {
+    {"E", "E", "+", "T"},
+    {"E", "T"},
+    {"T", "T", "*", "F"},
+    {"T", "F"},
+    {"F", "(", "E", ")"},
+    {"F", "id"}
+  };
+  auto augmented = augment(g);
+  lr1_automaton a(augmented);
+  REQUIRE(a.state_count() == 12);
+  auto table = build_lr1_table(g, a);
+  REQUIRE(table.conflicts().empty());
+
+  lr0_automaton lr0(augmented);
+  auto lalr = build_lalr_table(g, lr0);
+  // Same numbering, since both are breadth first from the start state.
+  for (int s = 0; s < 12; ++s) {
+    for (int t = 0; t < table.terminal_columns(); ++t) {
+      REQUIRE(table.action(s, t) == lalr.action(s, t));
+    }
+  }
+}
+
+TEST_CASE("Pager's LR(1) splits states where LALR has reduce/reduce conflicts") {
+  // LR(1) but not LALR(1): merging the two states after "a e" and "b e"
+  // makes E -> e and F -> e both reduce on c and d.
+  grammar g = {
+    {"S", "a", "E", "c"},
+    {"S", "a", "F", "d"},
+    {"S", "b", "F", "c"},
+    {"S", "b", "E", "d"},
+    {"E", "e"},
+    {"F", "e"}
+  };
+  auto augmented = augment(g);
+  lr0_automaton lr0(augmented);
+  auto lalr = build_lalr_table(g, lr0);
+  REQUIRE(lalr.conflicts().size() == 2);
+  REQUIRE(!lalr.conflicts()[0].is_shift_reduce());
+
+  lr1_automaton a(augmented);
+  auto table = build_lr1_table(g, a);
+  REQUIRE(table.conflicts().empty());
+  REQUIRE(a.state_count() == lr0.state_count() + 1);
+
+  int after_ae = a.transition(a.transition(0, augmented.id_of("a")), augmented.id_of("e"));
+  REQUIRE(table.action(after_ae, g.terminal_index(g.id_of("c"))) == lr_action{lr_action::reduce, 4});
+  REQUIRE(table.action(after_ae, g.terminal_index(g.id_of("d"))) == lr_action{lr_action::reduce, 5});
+}
+
+TEST_CASE("Pager's LR(1) automaton can be queried from several threads") {
+  grammar g = {
+    {"S", "A", "B", "c"},
+    {"A", "a", "A"},
+    {"A"},
+    {"B", "b"},
+    {"B"}
+  };
+  auto augmented = augment(g);
+  lr1_automaton a(augmented);
+  vector<decltype(a.reductions(0))> expected;
+  for (int s = 0; s < a.state_count(); ++s) { expected.push_back(a.reductions(s)); }
+
+  vector<thread> threads;
+  vector<int> mismatches(4);
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&, i]() {
+      for (int n = 0; n < 200; ++n) {
+        for (int s = 0; s < a.state_count(); ++s) {
+          mismatches[i] += a.reductions(s) != expected[s];
+        }
+      }
+    });
+  }
+  for (auto&& t : threads) { t.join(); }
+  for (auto m : mismatches) { REQUIRE(m == 0); }
+}
+
+// The other textbook construction: canonical LR(1) items, an LR(0) item and
+// a lookahead (a terminal index, or end_of_input).
+typedef pair<item, int> lr1_item;
+
+set<lr1_item> lr1_closure(set<lr1_item> I, const grammar& g, const first_sets& F) {
+  vector<lr1_item> work(I.begin(), I.end());
+  while (work.size()) {
+    auto it = work.back();
+    work.pop_back();
+    auto rhs = g.rhs_ids(it.first.production_id);
+    int dot = it.first.dot_index;
+    if (dot == int(rhs.size()) || !g.is_nonterminal(rhs[dot])) { continue; }
+    // FIRST(beta a) for [A -> alpha . B beta, a].
+    set<int> lookaheads;
+    int k = dot + 1;
+    for (; k < int(rhs.size()); ++k) {
+      for (int t = 0; t <= end_of_input(g); ++t) {
+        if (F.first.test(rhs[k], t)) { lookaheads.insert(t); }
+      }
+      if (!F.nullable[rhs[k]]) { break; }
+    }
+    if (k == int(rhs.size())) { lookaheads.insert(it.second); }
+    for (auto i : g.production_indices(rhs[dot])) {
+      for (auto t : lookaheads) {
+        lr1_item added{{i, 0}, t};
+        if (I.insert(added).second) { work.push_back(added); }
+      }
+    }
+  }
+  return I;
+}
+
+// The lookaheads of every reduction of the canonical LR(1) states, merged
+// by their LR(0) cores (whole closures, so no kernel bookkeeping).
+map<set<item>, map<int, set<int>>> canonical_lr1_merged(const grammar& g) {
+  auto F = compute_first_sets(g);
+  auto core = [](const set<lr1_item>& I) {
+    set<item> c;
+    for (auto&& it : I) { c.insert(it.first); }
+    return c;
+  };
+
+  set<set<lr1_item>> C;
+  vector<set<lr1_item>> work{lr1_closure({{{0, 0}, end_of_input(g)}}, g, F)};
+  C.insert(work[0]);
+  while (work.size()) {
+    auto I = work.back();
+    work.pop_back();
+    map<symbol_id, set<lr1_item>> gotos;
+    for (auto&& it : I) {
+      auto rhs = g.rhs_ids(it.first.production_id);
+      int dot = it.first.dot_index;
+      if (dot < int(rhs.size())) {
+        gotos[rhs[dot]].insert({{it.first.production_id, dot + 1}, it.second});
+      }
+    }
+    for (auto&& e : gotos) {
+      auto J = lr1_closure(e.second, g, F);
+      if (C.insert(J).second) { work.push_back(J); }
+    }
+  }
+
+  map<set<item>, map<int, set<int>>> merged;
+  for (auto&& I : C) {
+    auto& reductions = merged[core(I)];
+    for (auto&& it : I) {
+      if (it.first.dot_index == g.rhs_size(it.first.production_id)) {
+        reductions[it.first.production_id].insert(it.second);
+      }
+    }
+  }
+  return merged;
+}
+
+set<int> row_set(const bits::word* row, int columns) {
+  set<int> ret;
+  for (int t = 0; t < columns; ++t) {
+    if (bits::test(row, t)) { ret.insert(t); }
+  }
+  return ret;
+}
+
+// A few nonterminals out of S, A, B and C, each with some alternatives of
+// up to three of them and the terminals a, b and c, empty ones included.
+grammar random_grammar(mt19937_64& rng) {
+  const char* const names[] = {"S", "A", "B", "C", "a", "b", "c"};
+  int nonterminals = 1 + rng() % 4;
+  sequence<production> prods;
+  for (int A = 0; A < nonterminals; ++A) {
+    int alternatives = 1 + rng() % 3;
+    for (int i = 0; i < alternatives; ++i) {
+      sequence<symbol> rhs;
+      int length = rng() % 4;
+      // The first only has nonterminals from before A, so everything
+      // derives some terminal string: canonical LR(1) has no items after an
+      // unproductive symbol (there's no lookahead to give them), LR(0) does.
+      int choices = i == 0 ? A : nonterminals;
+      for (int k = 0; k < length; ++k) {
+        int s = rng() % (choices + 3);
+        rhs.push_back(names[s < choices ? s : 4 + s - choices]);
+      }
+      prods.emplace_back(names[A], rhs);
+    }
+  }
+  return grammar(prods);
+}
+
+TEST_CASE("LALR(1) and Pager's lookaheads are canonical LR(1)'s merged by core on random grammars") {
+  mt19937_64 rng(11);
+  int compared = 0;
+  for (int n = 0; n < 3000; ++n) {
+    auto g = augment(random_grammar(rng));
+    auto merged = canonical_lr1_merged(g);
+    int columns = end_of_input(g) + 1;
+
+    lr0_automaton lr0(g);
+    REQUIRE(size_t(lr0.state_count()) == merged.size());
+    auto cores = [&](const vector<item>& c) { return set<item>(c.begin(), c.end()); };
+    auto lalr = compute_lalr_lookaheads(lr0);
+    // LALR leaves out [S' -> S .], which is where we accept.
+    size_t reductions = 0;
+    for (auto&& m : merged) { reductions += m.second.size() - m.second.count(0); }
+    REQUIRE(lalr.reductions.size() == reductions);
+    for (size_t r = 0; r < lalr.reductions.size(); ++r) {
+      auto& reduction = lalr.reductions[r];
+      auto& expected = merged.at(cores(lr0.closure(reduction.first)));
+      REQUIRE(row_set(lalr.LA.row(r), columns) == expected.at(reduction.second));
+      ++compared;
+    }
+
+    // Pager may keep several states with the same core, but between them
+    // they've got the same lookaheads.
+    lr1_automaton lr1(g);
+    map<set<item>, map<int, set<int>>> pager;
+    for (int s = 0; s < lr1.state_count(); ++s) {
+      auto k = lr1.kernel(s);
+      auto& reductions = pager[compute_closure(set<item>(k.begin(), k.end()), g)];
+      for (auto&& r : lr1.reductions(s)) {
+        auto L = row_set(r.second.data(), columns);
+        reductions[r.first].insert(L.begin(), L.end());
+      }
+    }
+    REQUIRE(pager == merged);
+  }
+  REQUIRE(compared > 2000);
+}
@@ -0,0 +1,1143 @@
+#include "catch.hpp"
+
+#include <map>
+#include <set>
+#include <random>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+#include "cfg.h"
+#include "first.h"
+#include "ll1.h"
+#include "lr0.h"
+#include "lalr.h"
+#include "lr_table.h"
+#include "lr_parser.h"
+#include "earley.h"
+#include "glr.h"
+#include "sppf.h"
+#include "cyk.h"
+#include "count.h"
+#include "compiled.h"
+#include "parse_tree.h"
+#include "mapped_file.h"
+#include "left_recursion.h"
+#include "cfg1_to_cfg.h"
+
+// Made by parsergen from inputs/ (see the Makefile).
+#include "generated/calc_rd.h"
+#include "generated/calc_lr.h"
+#include "generated/arith_lr.h"
+
+using namespace std;
+using namespace cfg;
+
+// The expression grammar with the left recursion taken out.
+const grammar ll_expression = {
+  {"E", "T", "E'"},
+  {"E'", "+", "T", "E'"},
+  {"E'"},
+  {"T", "F", "T'"},
+  {"T'", "*", "F", "T'"},
+  {"T'"},
+  {"F", "(", "E", ")"},
+  {"F", "id"}
+};
+
+vector<symbol_id> tokens_of(const grammar& g, const string& s) {
+  vector<symbol_id> tokens;
+  stringstream in(s);
+  REQUIRE(read_tokens(g, in, tokens));
+  return tokens;
+}
+
+span<symbol_id> all_of(const vector<symbol_id>& v) {
+  return {v.data(), v.data() + v.size()};
+}
+
+TEST_CASE("LL(1) table comes from PREDICT") {
+  auto& g = ll_expression;
+  ll1_parser parser(g);
+  REQUIRE(parser.conflicts().empty());
+  int end = parser.terminal_columns() - 1;
+  auto E_ = g.id_of("E'");
+  REQUIRE(parser.predict(E_, g.terminal_index(g.id_of("+"))) == 1);
+  REQUIRE(parser.predict(E_, g.terminal_index(g.id_of(")"))) == 2);
+  REQUIRE(parser.predict(E_, end) == 2);
+  REQUIRE(parser.predict(E_, g.terminal_index(g.id_of("id"))) == -1);
+}
+
+TEST_CASE("LL(1) parser gives leftmost derivations and trees") {
+  auto& g = ll_expression;
+  grammar_analysis A(g);
+  ll1_parser parser(A);
+  auto input = tokens_of(g, "id + id * id");
+
+  REQUIRE(parser.recognize(all_of(input)));
+  vector<int> derivation;
+  REQUIRE(parser.parse(all_of(input), derivation));
+  REQUIRE(derivation == vector<int>({0, 3, 7, 5, 1, 3, 7, 4, 7, 5, 2}));
+
+  auto tree = parser.parse(all_of(input));
+  REQUIRE(!tree.has_undeveloped());
+  REQUIRE(tree.leaf_count() == 5);
+  stringstream leaves;
+  tree.print_leaves(leaves);
+  REQUIRE(leaves.str() == "id + id * id ");
+}
+
+TEST_CASE("LL(1) parser reports where it failed") {
+  auto& g = ll_expression;
+  ll1_parser parser(g);
+  size_t error_at = 0;
+  auto input = tokens_of(g, "id + * id");
+  REQUIRE(!parser.recognize(all_of(input), &error_at));
+  REQUIRE(error_at == 2);
+
+  input = tokens_of(g, "( id");
+  REQUIRE(!parser.recognize(all_of(input), &error_at));
+  REQUIRE(error_at == 2);
+
+  input = tokens_of(g, "id id");
+  REQUIRE(!parser.recognize(all_of(input), &error_at));
+  REQUIRE(error_at == 1);
+
+  // Nonterminals aren't tokens.
+  input = {g.id_of("id"), g.id_of("E")};
+  REQUIRE(!parser.recognize(all_of(input), &error_at));
+  REQUIRE(error_at == 1);
+
+  stringstream bad_input("id - id");
+  vector<symbol_id> tokens;
+  string bad;
+  REQUIRE(!read_tokens(g, bad_input, tokens, &bad));
+  REQUIRE(bad == "-");
+}
+
+TEST_CASE("LL(1) conflicts are recorded and the first production kept") {
+  grammar g = {
+    {"S", "a", "b"},
+    {"S", "a", "c"},
+    {"S", "d"}
+  };
+  ll1_parser parser(g);
+  REQUIRE(parser.conflicts().size() == 1);
+  auto& c = parser.conflicts()[0];
+  REQUIRE(c.nonterminal == g.id_of("S"));
+  REQUIRE(c.terminal == g.terminal_index(g.id_of("a")));
+  REQUIRE(c.productions == vector<int>({0, 1}));
+  REQUIRE(parser.predict(g.id_of("S"), c.terminal) == 0);
+}
+
+TEST_CASE("LL(1) parsing with conflicts fails rather than looping on left recursion") {
+  grammar arith = {
+    {"S", "S", "+", "S"},
+    {"S", "n"}
+  };
+  ll1_parser parser(arith);
+  REQUIRE(parser.conflicts().size());
+  auto input = tokens_of(arith, "n + n");
+  size_t error_at = 99;
+  REQUIRE(!parser.recognize(all_of(input), &error_at));
+  REQUIRE(error_at == 0);
+  vector<int> derivation;
+  REQUIRE(!parser.parse(all_of(input), derivation));
+  REQUIRE(!parser.parse(all_of(input)).is_fully_developed());
+
+  // Hidden behind a nullable A, and a second time round after matching.
+  grammar hidden = {
+    {"T", "a", "S"},
+    {"S", "A", "S", "x"},
+    {"S", "y"},
+    {"A"}
+  };
+  ll1_parser hidden_parser(hidden);
+  REQUIRE(hidden_parser.conflicts().size());
+  input = tokens_of(hidden, "a y x");
+  REQUIRE(!hidden_parser.recognize(all_of(input), &error_at));
+  REQUIRE(error_at == 1);
+
+  // The table's still good for what the kept productions can parse.
+  grammar g = {
+    {"S", "a", "b"},
+    {"S", "a", "c"},
+    {"S", "d"}
+  };
+  ll1_parser kept(g);
+  input = tokens_of(g, "a b");
+  REQUIRE(kept.parse(all_of(input), derivation));
+  REQUIRE(derivation == vector<int>{0});
+  input = tokens_of(g, "a c");
+  REQUIRE(!kept.recognize(all_of(input)));
+}
+
+const grammar lr_expression = {
+  {"E", "E", "+", "T"},
+  {"E", "T"},
+  {"T", "T", "*", "F"},
+  {"T", "F"},
+  {"F", "(", "E", ")"},
+  {"F", "id"}
+};
+
+TEST_CASE("Packed LR tables agree with the dense ones") {
+  auto& g = lr_expression;
+  auto augmented = augment(g);
+  lr0_automaton a(augmented);
+  auto table = build_lalr_table(g, a);
+  lr_parser parser(table);
+  REQUIRE(parser.table_bytes() < parser.dense_bytes());
+
+  for (int s = 0; s < table.state_count(); ++s) {
+    for (int t = 0; t < table.terminal_columns(); ++t) {
+      auto& dense = table.action(s, t);
+      auto packed = parser.action(s, t);
+      switch (dense.kind) {
+        case lr_action::shift: REQUIRE(packed == dense.value + 1); break;
+        case lr_action::reduce: REQUIRE(packed == -(dense.value + 1)); break;
+        case lr_action::accept: REQUIRE(packed == lr_parser::accept_code); break;
+        // Or a default reduction.
+        case lr_action::error: REQUIRE(packed <= 0); break;
+      }
+    }
+    for (int A = 0; A < g.nonterminal_count(); ++A) {
+      if (table.go_to(s, A) >= 0) {
+        REQUIRE(parser.go_to(s, A) == table.go_to(s, A));
+      }
+    }
+  }
+}
+
+TEST_CASE("LR parser reduces in reverse rightmost order") {
+  auto& g = lr_expression;
+  auto augmented = augment(g);
+  lr0_automaton a(augmented);
+  auto table = build_lalr_table(g, a);
+  lr_parser parser(table);
+  auto input = tokens_of(g, "id + id * id");
+
+  REQUIRE(parser.recognize(all_of(input)));
+  vector<int> reductions;
+  REQUIRE(parser.parse(all_of(input), reductions));
+  REQUIRE(reductions == vector<int>({5, 3, 1, 5, 3, 5, 2, 0}));
+
+  auto tree = parser.parse(all_of(input));
+  REQUIRE(!tree.has_undeveloped());
+  stringstream leaves;
+  tree.print_leaves(leaves);
+  REQUIRE(leaves.str() == "id + id * id ");
+
+  // The same tree as the leftmost derivation gives.
+  stringstream from_reductions, from_leftmost;
+  from_reductions << tree;
+  from_leftmost << parse_tree(g, {0, 1, 3, 5, 2, 3, 5, 5});
+  REQUIRE(from_reductions.str() == from_leftmost.str());
+}
+
+TEST_CASE("LR parser runs user actions") {
+  auto& g = lr_expression;
+  auto augmented = augment(g);
+  lr0_automaton a(augmented);
+  lr_parser parser(build_lalr_table(g, a));
+
+  auto input = tokens_of(g, "( id + id ) * id + id");
+  // Every id is worth 2.
+  int result = 0;
+  bool ok = parser.parse(all_of(input),
+    [](size_t) { return 2; },
+    [](int p, int* rhs) {
+      switch (p) {
+        case 0: return rhs[0] + rhs[2];
+        case 2: return rhs[0] * rhs[2];
+        case 4: return rhs[1];
+        default: return rhs[0];
+      }
+    }, result);
+  REQUIRE(ok);
+  REQUIRE(result == 10);
+}
+
+TEST_CASE("LR parser reports where it failed") {
+  auto& g = lr_expression;
+  auto augmented = augment(g);
+  lr0_automaton a(augmented);
+  lr_parser parser(build_lalr_table(g, a));
+  size_t error_at = 0;
+
+  auto input = tokens_of(g, "id + * id");
+  REQUIRE(!parser.recognize(all_of(input), &error_at));
+  REQUIRE(error_at == 2);
+
+  input = tokens_of(g, "( id");
+  REQUIRE(!parser.recognize(all_of(input), &error_at));
+  REQUIRE(error_at == 2);
+
+  input = tokens_of(g, "id id");
+  REQUIRE(!parser.recognize(all_of(input), &error_at));
+  REQUIRE(error_at == 1);
+
+  input = {};
+  REQUIRE(!parser.recognize(all_of(input), &error_at));
+  REQUIRE(error_at == 0);
+}
+
+TEST_CASE("LR parser doesn't take a token past the terminals as the end") {
+  grammar g = {
+    {"S", "a"}
+  };
+  auto augmented = augment(g);
+  lr0_automaton a(augmented);
+  lr_parser parser(build_lalr_table(g, a));
+  vector<symbol_id> input = {g.id_of("a")};
+  REQUIRE(parser.recognize(all_of(input)));
+
+  size_t error_at = 0;
+  input.push_back(symbol_id(g.symbol_count()));
+  REQUIRE(!parser.recognize(all_of(input), &error_at));
+  REQUIRE(error_at == 1);
+  input = {symbol_id(g.symbol_count())};
+  REQUIRE(!parser.recognize(all_of(input), &error_at));
+  REQUIRE(error_at == 0);
+}
+
+// Parse, and check the tree's leaves are the input again.
+TEST_CASE("Parse trees read back what they print") {
+  auto& g = ll_expression;
+  parse_tree tree(g, {0, 3, 6, 0, 3, 7, 5, 1, 3, 7, 5, 2, 5, 2});
+  REQUIRE(tree.size() == 19);
+  REQUIRE(tree.leaf_count() == 5);
+  REQUIRE(!tree.has_undeveloped());
+  stringstream printed;
+  printed << tree;
+
+  parse_tree again(g, printed);
+  stringstream reprinted, leaves;
+  reprinted << again;
+  REQUIRE(reprinted.str() == printed.str());
+  again.print_leaves(leaves);
+  REQUIRE(leaves.str() == "( id + id ) ");
+  // The epsilon nodes come back developed.
+  REQUIRE(!again.has_undeveloped());
+
+  // No production E -> T, so that's not a tree of g.
+  stringstream bad("E\n  T\n    F\n      id\n");
+  parse_tree not_a_tree(g, bad);
+  REQUIRE(not_a_tree.size() == 1);
+  REQUIRE(not_a_tree.undeveloped_symbol() == "E");
+}
+
+TEST_CASE("Path copied trees match deep copied ones and leave the old ones alone") {
+  auto& g = ll_expression;
+  vector<int> derivation = {0, 3, 6, 0, 3, 7, 5, 1, 3, 7, 5, 2, 5, 2};
+  // parse_trees can't be assigned, so every step goes on the end.
+  vector<parse_tree> deep{parse_tree(g)}, path{parse_tree(g, parse_tree::copy_mode::path)};
+  vector<string> printed;
+  for (auto p : derivation) {
+    deep.push_back(deep.back().apply_production(p));
+    path.push_back(path.back().apply_production(p));
+    stringstream a, b;
+    a << deep.back();
+    b << path.back();
+    REQUIRE(a.str() == b.str());
+    REQUIRE(path.back().size() == deep.back().size());
+    printed.push_back(b.str());
+  }
+  REQUIRE(!path.back().has_undeveloped());
+  for (size_t i = 0; i < printed.size(); ++i) {
+    stringstream again;
+    again << path[i + 1];
+    REQUIRE(again.str() == printed[i]);
+  }
+
+  // Two ways to develop the same tree don't get in each other's way.
+  parse_tree start(g, parse_tree::copy_mode::path);
+  auto E = start.apply_production(0).apply_production(3);
+  auto parens = E.apply_production(6), id = E.apply_production(7);
+  stringstream a, b;
+  parens.print_leaves(a);
+  id.print_leaves(b);
+  REQUIRE(a.str() == "( E ) T' E' ");
+  REQUIRE(b.str() == "id T' E' ");
+
+  // A compacted copy is the same tree, and carries on the same way.
+  auto alone = parens.compact();
+  REQUIRE(alone.size() == parens.size());
+  REQUIRE(alone.undeveloped_symbol() == "E");
+  stringstream c, d;
+  parens.apply_production(0).print_leaves(c);
+  alone.apply_production(0).print_leaves(d);
+  REQUIRE(c.str() == d.str());
+}
+
+TEST_CASE("Parse trees keep track of their undeveloped leaves and counts") {
+  auto& g = ll_expression;
+  for (auto mode : {parse_tree::copy_mode::deep, parse_tree::copy_mode::path}) {
+    vector<parse_tree> trees{parse_tree(g, mode)};
+    for (auto p : {0, 3, 7}) { trees.push_back(trees.back().apply_production(p)); }
+    REQUIRE(trees[0].size() == 1);
+    REQUIRE(trees[0].undeveloped_symbol() == "E");
+    REQUIRE(trees[3].size() == 6);
+    REQUIRE(trees[3].leaf_count() == 1);
+    REQUIRE(trees[3].undeveloped_symbol() == "T'");
+
+    trees.push_back(trees.back().apply_production(5));
+    REQUIRE(trees.back().undeveloped_symbol() == "E'");
+    trees.push_back(trees.back().apply_production(1));
+    REQUIRE(trees.back().size() == 9);
+    REQUIRE(trees.back().leaf_count() == 2);
+    REQUIRE(trees.back().undeveloped_symbol() == "T");
+    // Still where it was.
+    REQUIRE(trees[3].undeveloped_symbol() == "T'");
+  }
+
+  // Read in, the undeveloped leaves can be anywhere. The T's and E' under
+  // an epsilon marker are developed, the way they print.
+  stringstream in("E\n  T\n    F\n      id\n    T'\n      ε\n  E'\n    +\n    T\n      F\n      T'\n        ε\n    E'\n      ε\n");
+  parse_tree read(g, in);
+  REQUIRE(read.size() == 11);
+  REQUIRE(read.leaf_count() == 2);
+  REQUIRE(read.undeveloped_symbol() == "F");
+  auto next = read.apply_production(6);
+  REQUIRE(next.size() == 14);
+  REQUIRE(next.leaf_count() == 4);
+  REQUIRE(next.undeveloped_symbol() == "E");
+  stringstream leaves;
+  next.print_leaves(leaves);
+  REQUIRE(leaves.str() == "id + ( E ) ");
+
+  // Without the marker a nonterminal leaf is undeveloped, even one with an
+  // epsilon production. And the marker only goes under a nonterminal that
+  // has one.
+  stringstream unmarked("E\n  T\n    F\n      id\n    T'\n  E'\n");
+  parse_tree partial(g, unmarked);
+  REQUIRE(partial.size() == 6);
+  REQUIRE(partial.undeveloped_symbol() == "T'");
+  stringstream no_epsilon("E\n  T\n    F\n      ε\n    T'\n  E'\n");
+  REQUIRE(parse_tree(g, no_epsilon).size() == 1);
+}
+
+void require_earley_parse(const earley_parser& parser, const string& s) {
+  auto input = tokens_of(parser.g, s);
+  REQUIRE(parser.recognize(all_of(input)));
+  auto tree = parser.parse(all_of(input));
+  REQUIRE(!tree.has_undeveloped());
+  stringstream leaves;
+  tree.print_leaves(leaves);
+  REQUIRE(leaves.str() == (s.empty() ? s : s + " "));
+}
+
+TEST_CASE("Earley parses ambiguous left recursive grammars") {
+  grammar arithmetic = {
+    {"S", "S", "+", "S"},
+    {"S", "S", "*", "S"},
+    {"S", "(", "S", ")"},
+    {"S", "n"}
+  };
+  for (bool leo : {true, false}) {
+    earley_parser parser(arithmetic, leo);
+    require_earley_parse(parser, "n");
+    require_earley_parse(parser, "n + n * n + ( n * n )");
+
+    size_t error_at = 0;
+    auto input = tokens_of(arithmetic, "n + * n");
+    REQUIRE(!parser.recognize(all_of(input), &error_at));
+    REQUIRE(error_at == 2);
+    input = tokens_of(arithmetic, "n + ( n");
+    REQUIRE(!parser.recognize(all_of(input), &error_at));
+    REQUIRE(error_at == 4);
+    input = {};
+    REQUIRE(!parser.recognize(all_of(input), &error_at));
+    REQUIRE(error_at == 0);
+  }
+}
+
+TEST_CASE("Earley handles nullable nonterminals") {
+  // Aycock and Horspool's troublesome example.
+  grammar g = {
+    {"S", "A", "A", "A", "A"},
+    {"A", "a"},
+    {"A", "E"},
+    {"E"}
+  };
+  earley_parser parser(g);
+  for (auto s : {"", "a", "a a", "a a a a"}) {
+    require_earley_parse(parser, s);
+  }
+  auto input = tokens_of(g, "a a a a a");
+  REQUIRE(!parser.recognize(all_of(input)));
+}
+
+TEST_CASE("Earley with Leo is linear on right recursion") {
+  grammar g = {
+    {"S", "a", "S"},
+    {"S", "A"},
+    {"A", "b", "A"},
+    {"A"}
+  };
+  earley_parser leo(g), plain(g, false);
+  auto items = [&](const earley_parser& p, int n) {
+    vector<symbol_id> input(n, g.id_of("a"));
+    input.push_back(g.id_of("b"));
+    auto c = p.chart(all_of(input));
+    REQUIRE(c.accepted);
+    return c.size();
+  };
+  // Doubling the input doubles the chart with Leo, and quadruples it
+  // without.
+  REQUIRE(items(leo, 2000) < 2 * items(leo, 1000) + 20);
+  REQUIRE(items(plain, 2000) > 3 * items(plain, 1000));
+
+  string s;
+  for (int i = 0; i < 50; ++i) { s += "a "; }
+  s += "b b";
+  require_earley_parse(leo, s);
+  vector<int> derivation;
+  auto input = tokens_of(g, s);
+  REQUIRE(leo.parse(all_of(input), derivation));
+  REQUIRE(derivation.size() == 54);
+}
+
+TEST_CASE("GLR packs every parse of an ambiguous sentence") {
+  grammar g = {
+    {"S", "S", "+", "S"},
+    {"S", "n"}
+  };
+  auto augmented = augment(g);
+  lr0_automaton a(augmented);
+  auto table = build_lalr_table(g, a);
+  REQUIRE(table.conflicts().size() == 1);
+  glr_parser parser(table);
+
+  // The Catalan numbers: 1, 1, 2, 5, 14, 42, ...
+  vector<uint64_t> catalan = {1, 1, 2, 5, 14, 42, 132, 429};
+  string s = "n";
+  for (size_t operators = 0; operators < catalan.size(); ++operators) {
+    auto input = tokens_of(g, s);
+    auto forest = parser.parse(all_of(input));
+    REQUIRE(forest.root >= 0);
+    REQUIRE(forest.count_trees() == catalan[operators]);
+
+    // Each tree, once, and all of them different.
+    set<vector<int>> trees;
+    sppf_trees all(forest);
+    vector<int> derivation;
+    while (all.next(derivation)) {
+      auto tree = parse_tree(g, derivation);
+      REQUIRE(!tree.has_undeveloped());
+      stringstream leaves;
+      tree.print_leaves(leaves);
+      REQUIRE(leaves.str() == s + " ");
+      REQUIRE(trees.insert(derivation).second);
+    }
+    REQUIRE(trees.size() == catalan[operators]);
+    s += " + n";
+  }
+
+  // 30 operators have about 3.8e15 trees; the forest doesn't mind.
+  for (int i = 0; i < 22; ++i) { s += " + n"; }
+  auto input = tokens_of(g, s);
+  auto forest = parser.parse(all_of(input));
+  REQUIRE(forest.count_trees() == 3814986502092304ull);
+  REQUIRE(forest.node_count() < 2000);
+}
+
+TEST_CASE("GLR handles epsilon rules and hidden left recursion") {
+  // S -> A S b hides its left recursion behind the nullable A.
+  grammar g = {
+    {"S", "A", "S", "b"},
+    {"S", "x"},
+    {"A"}
+  };
+  auto augmented = augment(g);
+  lr0_automaton a(augmented);
+  glr_parser parser(build_lalr_table(g, a));
+  for (auto s : {"x", "x b", "x b b b"}) {
+    auto input = tokens_of(g, s);
+    auto forest = parser.parse(all_of(input));
+    REQUIRE(forest.root >= 0);
+    REQUIRE(forest.count_trees() == 1);
+  }
+  size_t error_at = 0;
+  auto input = tokens_of(g, "x b x");
+  REQUIRE(!parser.recognize(all_of(input), &error_at));
+  REQUIRE(error_at == 2);
+  input = {};
+  REQUIRE(!parser.recognize(all_of(input), &error_at));
+  REQUIRE(error_at == 0);
+}
+
+TEST_CASE("CNF conversion leaves only binary and terminal rules") {
+  grammar g = {
+    {"S", "A", "A", "A", "A"},
+    {"A", "a"},
+    {"A", "E"},
+    {"A", "(", "S", ")"},
+    {"E"}
+  };
+  cnf_grammar cnf(g);
+  REQUIRE(cnf.accepts_empty());
+  int N = cnf.nonterminal_count();
+  REQUIRE(N > g.nonterminal_count());
+  for (auto& r : cnf.binary_rules()) {
+    REQUIRE(r.lhs < symbol_id(N));
+    REQUIRE(r.left < symbol_id(N));
+    REQUIRE(r.right < symbol_id(N));
+  }
+  REQUIRE(cnf.terminal_rules().width() == N);
+  // A, S and the two fresh nonterminals for the tails of A A A A can all
+  // be just a; ( and ) get one each to stand in for them.
+  auto& T = cnf.terminal_rules();
+  REQUIRE(T.count(g.terminal_index(g.id_of("a"))) == 4);
+  REQUIRE(T.count(g.terminal_index(g.id_of("("))) == 1);
+
+  // It reads back in as a grammar.
+  stringstream text;
+  text << cnf;
+  auto again = read_grammar(text);
+  REQUIRE(again.start_symbol() == "S");
+  for (auto& p : again.prods) {
+    REQUIRE(p.rhs.size() <= 2);
+    if (p.rhs.size() == 1) { REQUIRE(again.is_terminal(p.rhs[0])); }
+    if (p.rhs.size() == 2) { REQUIRE(again.is_nonterminal(p.rhs[0])); }
+    if (p.rhs.empty()) { REQUIRE(p.lhs == "S"); }
+  }
+}
+
+TEST_CASE("CYK agrees with Earley") {
+  grammar g = {
+    {"S", "A", "A", "A", "A"},
+    {"A", "a"},
+    {"A", "E"},
+    {"A", "(", "S", ")"},
+    {"E"}
+  };
+  cyk_parser cyk(g);
+  earley_parser earley(g);
+  for (auto s : {"", "a", "( )", "a ( a a ) a", "( ( a a a a ) )", "a a a a a",
+                 "( a", "a ) (", "( a a a a a )"}) {
+    auto input = tokens_of(g, s);
+    REQUIRE(cyk.recognize(all_of(input)) == earley.recognize(all_of(input)));
+  }
+}
+
+TEST_CASE("CYK chart has every nonterminal of every span") {
+  grammar regex = {
+    {"R", "R", "|", "R"},
+    {"R", "R", ".", "R"},
+    {"R", "R", "*"},
+    {"R", "(", "R", ")"},
+    {"R", "a"}
+  };
+  cyk_parser parser(regex);
+  auto input = tokens_of(regex, "a | ( a . a ) *");
+  REQUIRE(parser.recognize(all_of(input)));
+  auto chart = parser.chart(all_of(input));
+  REQUIRE(chart.length() == 8);
+  auto R = regex.id_of("R");
+  REQUIRE(chart.derives(R, 0, 8));
+  REQUIRE(chart.derives(R, 2, 8));
+  REQUIRE(chart.derives(R, 2, 7));
+  REQUIRE(chart.derives(R, 3, 6));
+  REQUIRE(!chart.derives(R, 2, 6));
+  REQUIRE(!chart.derives(R, 0, 2));
+  REQUIRE(!chart.derives(R, 1, 3));
+
+  input = tokens_of(regex, "a | | a");
+  REQUIRE(!parser.recognize(all_of(input)));
+  input = {};
+  REQUIRE(!parser.recognize(all_of(input)));
+}
+
+TEST_CASE("Derivation counts are the Catalan numbers for S -> S + S | n") {
+  grammar g = {
+    {"S", "S", "+", "S"},
+    {"S", "n"}
+  };
+  derivation_counter counter(g, 201);
+  REQUIRE(counter.finite());
+  vector<uint64_t> catalan = {1, 1, 2, 5, 14, 42, 132, 429};
+  for (size_t k = 0; k < catalan.size(); ++k) {
+    REQUIRE(counter.count(2*k + 1) == bigint(catalan[k]));
+    REQUIRE(counter.count(2*k).is_zero());
+  }
+  REQUIRE(counter.count(g.id_of("n"), 1) == bigint(1));
+  // The same as GLR's forest for 30 operators, and then a lot more.
+  REQUIRE(counter.count(61) == bigint(3814986502092304ull));
+  REQUIRE(counter.count(201).to_string() == "896519947090131496687170070074100632420837521538745909320");
+}
+
+TEST_CASE("Derivation counts match enumerating the trees") {
+  // Epsilon rules, a unit rule, hidden left recursion and an ambiguous
+  // empty A.
+  grammar g = {
+    {"S", "E", "S", "a"},
+    {"S", "b"},
+    {"S", "A"},
+    {"A", "E", "b"},
+    {"A", "a", "A"},
+    {"A"},
+    {"E"},
+    {"E", "a"}
+  };
+  const int L = 7;
+  derivation_counter counter(g, L);
+  REQUIRE(counter.finite());
+
+  // Every tree with at most L leaves, the way print_parse_trees finds them.
+  auto yield = compute_min_yield(g);
+  vector<uint64_t> trees(L + 1, 0);
+  vector<pair<parse_tree, int>> stack;
+  stack.push_back({parse_tree(g), yield[0]});
+  while (stack.size()) {
+    auto t = stack.back();
+    stack.pop_back();
+    if (!t.first.has_undeveloped()) {
+      ++trees[t.first.leaf_count()];
+      continue;
+    }
+    auto A = g.id_of(t.first.undeveloped_symbol());
+    for (auto p : g.production_indices(A)) {
+      int least = t.second - yield[A];
+      for (auto x : g.rhs_ids(p)) { least += yield[x]; }
+      if (least <= L) { stack.push_back({t.first.apply_production(p), least}); }
+    }
+  }
+  for (int n = 0; n <= L; ++n) {
+    REQUIRE(counter.count(n) == bigint(trees[n]));
+  }
+  REQUIRE(trees[L] > 100);
+}
+
+TEST_CASE("Derivation counts know when there are infinitely many trees") {
+  grammar loop = {
+    {"S", "S"},
+    {"S", "a"}
+  };
+  REQUIRE(!derivation_counter(loop, 3).finite());
+  // Through nullable symbols too.
+  grammar hidden = {
+    {"S", "E", "T"},
+    {"T", "S", "E"},
+    {"S", "a"},
+    {"E"}
+  };
+  REQUIRE(!derivation_counter(hidden, 3).finite());
+  // But not when the loop can't derive anything.
+  grammar dead = {
+    {"S", "a"},
+    {"S", "a", "D"},
+    {"D", "D"}
+  };
+  derivation_counter counter(dead, 3);
+  REQUIRE(counter.finite());
+  REQUIRE(counter.count(1) == bigint(1));
+}
+
+TEST_CASE("The empty grammar has no trees to count") {
+  stringstream nothing;
+  auto g = read_grammar(nothing);
+  REQUIRE(g.size() == 0);
+  derivation_counter counter(g, 3);
+  REQUIRE(counter.finite());
+  mt19937_64 rng(1);
+  for (int n = 0; n <= 3; ++n) {
+    REQUIRE(counter.count(n).is_zero());
+    REQUIRE(counter.sample(n, rng).empty());
+  }
+}
+
+TEST_CASE("Sampled derivations are uniform") {
+  grammar g = {
+    {"S", "S", "+", "S"},
+    {"S", "n"}
+  };
+  derivation_counter counter(g, 201);
+  mt19937_64 rng(42);
+  REQUIRE(counter.sample(6, rng).empty());
+
+  // 3 operators have 5 trees.
+  map<vector<int>, int> seen;
+  for (int i = 0; i < 5000; ++i) {
+    auto derivation = counter.sample(7, rng);
+    parse_tree tree(g, derivation);
+    REQUIRE(tree.is_fully_developed());
+    REQUIRE(tree.leaf_count() == 7);
+    ++seen[derivation];
+  }
+  REQUIRE(seen.size() == 5);
+  for (auto& s : seen) {
+    REQUIRE(s.second > 850);
+    REQUIRE(s.second < 1150);
+  }
+
+  for (int i = 0; i < 10; ++i) {
+    parse_tree tree(g, counter.sample(201, rng));
+    REQUIRE(tree.is_fully_developed());
+    REQUIRE(tree.leaf_count() == 201);
+  }
+}
+
+TEST_CASE("Compiled grammars read back everything that went in") {
+  auto g = ll_expression;
+  stringstream out;
+  REQUIRE(write_compiled_grammar(out, g, 12345));
+  string bytes = out.str();
+  // Mapped files are page aligned; a vector of words is at least 8 byte aligned.
+  vector<uint64_t> buffer((bytes.size() + 7) / 8);
+  memcpy(buffer.data(), bytes.data(), bytes.size());
+  const char* first = reinterpret_cast<const char*>(buffer.data());
+  compiled_grammar c(first, first + bytes.size());
+  REQUIRE(c);
+  REQUIRE(c.source_hash() == 12345);
+
+  REQUIRE(c.size() == g.size());
+  REQUIRE(c.symbol_count() == g.symbol_count());
+  REQUIRE(c.nonterminal_count() == g.nonterminal_count());
+  for (symbol_id x = 0; x < symbol_id(g.symbol_count()); ++x) {
+    auto name = c.name_of(x);
+    REQUIRE(string(name.begin(), name.end()) == g.name_of(x));
+    REQUIRE(c.id_of(g.name_of(x)) == x);
+  }
+  REQUIRE(c.id_of("nothing") == no_symbol);
+  for (int p = 0; p < g.size(); ++p) {
+    REQUIRE(c.lhs_id(p) == g.lhs_id(p));
+    auto a = c.rhs_ids(p), b = g.rhs_ids(p);
+    REQUIRE(vector<symbol_id>(a.begin(), a.end()) == vector<symbol_id>(b.begin(), b.end()));
+  }
+  REQUIRE(c.to_grammar().all_productions() == g.all_productions());
+
+  grammar_analysis A(g);
+  int words = c.set_words();
+  for (symbol_id x = 0; x < symbol_id(g.symbol_count()); ++x) {
+    REQUIRE(c.nullable(x) == A.nullable()[x]);
+    REQUIRE(equal(c.first(x), c.first(x) + words, A.first().first.row(x)));
+    REQUIRE(equal(c.follow(x), c.follow(x) + words, A.follow().row(x)));
+  }
+  for (int p = 0; p < g.size(); ++p) {
+    REQUIRE(equal(c.predict(p), c.predict(p) + words, A.predict().row(p)));
+  }
+
+  ll1_parser ll1(A);
+  REQUIRE(!c.ll1_conflicts());
+  for (symbol_id B = 0; B < symbol_id(g.nonterminal_count()); ++B) {
+    for (int t = 0; t <= g.terminal_count(); ++t) { REQUIRE(c.ll1_predict(B, t) == ll1.predict(B, t)); }
+  }
+  auto augmented = augment(g);
+  lr0_automaton a(augmented);
+  auto table = build_lalr_table(g, a);
+  lr_parser lr(table);
+  REQUIRE(c.lr_state_count() == table.state_count());
+  REQUIRE(!c.lr_conflicts());
+  for (int state = 0; state < table.state_count(); ++state) {
+    for (int t = 0; t <= g.terminal_count(); ++t) { REQUIRE(c.lr_action(state, t) == lr.action(state, t)); }
+    for (symbol_id B = 0; B < symbol_id(g.nonterminal_count()); ++B) {
+      REQUIRE(c.lr_goto(state, B) == lr.go_to(state, B));
+    }
+  }
+
+  for (auto s : {"id", "id + id * ( id + id )", "( id", "id id", "", "+"}) {
+    auto input = tokens_of(g, s);
+    size_t ll1_at = 0, lr_at = 0, c_ll1_at = 0, c_lr_at = 0;
+    bool ok = ll1.recognize(all_of(input), &ll1_at);
+    REQUIRE(c.ll1_recognize(all_of(input), &c_ll1_at) == ok);
+    REQUIRE(c.lr_recognize(all_of(input), &c_lr_at) == ok);
+    REQUIRE(lr.recognize(all_of(input), &lr_at) == ok);
+    if (!ok) {
+      REQUIRE(c_ll1_at == ll1_at);
+      REQUIRE(c_lr_at == lr_at);
+    }
+  }
+  // A token past the terminals isn't the end of input.
+  auto input = tokens_of(g, "id");
+  input.push_back(symbol_id(g.symbol_count()));
+  size_t error_at = 0;
+  REQUIRE(!c.lr_recognize(all_of(input), &error_at));
+  REQUIRE(error_at == 1);
+  REQUIRE(!c.ll1_recognize(all_of(input), &error_at));
+  REQUIRE(error_at == 1);
+}
+
+TEST_CASE("Compiled grammars from elsewhere don't load") {
+  grammar g = {
+    {"S", "S", "+", "S"},
+    {"S", "n"}
+  };
+  stringstream out;
+  REQUIRE(write_compiled_grammar(out, g, 1));
+  string bytes = out.str();
+  vector<uint64_t> buffer((bytes.size() + 7) / 8);
+  auto load = [&](const string& b) {
+    memcpy(buffer.data(), b.data(), b.size());
+    const char* first = reinterpret_cast<const char*>(buffer.data());
+    return bool(compiled_grammar(first, first + b.size()));
+  };
+  REQUIRE(load(bytes));
+  {
+    // It isn't LL(1), and the left recursion fails the LL(1) parse
+    // rather than growing the stack forever.
+    const char* first = reinterpret_cast<const char*>(buffer.data());
+    compiled_grammar c(first, first + bytes.size());
+    REQUIRE(c.ll1_conflicts());
+    auto input = tokens_of(g, "n + n");
+    size_t error_at = 99;
+    REQUIRE(!c.ll1_recognize(all_of(input), &error_at));
+    REQUIRE(error_at == 0);
+  }
+  REQUIRE(!load(bytes.substr(0, bytes.size() - 8)));
+  REQUIRE(!load(bytes.substr(0, 16)));
+  string other = bytes;
+  other[0] = 'x';
+  REQUIRE(!load(other));
+  // The version comes right after the magic.
+  other = bytes;
+  ++other[8];
+  REQUIRE(!load(other));
+
+  // Anything else wrong in there either doesn't load or is still safe
+  // to look up everything in: with ASan this finds reads out of bounds.
+  auto use = [&](const string& b) {
+    memcpy(buffer.data(), b.data(), b.size());
+    const char* first = reinterpret_cast<const char*>(buffer.data());
+    compiled_grammar c(first, first + b.size());
+    if (!c) { return false; }
+    size_t total = c.to_grammar().size();
+    for (symbol_id x = 0; x < symbol_id(c.symbol_count()); ++x) {
+      auto name = c.name_of(x);
+      total += c.id_of(name.begin(), name.size()) == x;
+    }
+    total += c.id_of("nothing") == no_symbol;
+    for (symbol_id A = 0; A < symbol_id(c.nonterminal_count()); ++A) {
+      for (auto p : c.production_indices(A)) { total += c.rhs_size(p); }
+      for (int t = 0; t <= c.terminal_count(); ++t) { total += c.ll1_predict(A, t); }
+      for (int s = 0; s < c.lr_state_count(); ++s) { total += c.lr_goto(s, A); }
+    }
+    for (int s = 0; s < c.lr_state_count(); ++s) {
+      for (int t = 0; t <= c.terminal_count(); ++t) { total += c.lr_action(s, t); }
+    }
+    // Whatever the tables say, a token past the terminals is never the end.
+    vector<symbol_id> input = {symbol_id(c.symbol_count())};
+    REQUIRE(!c.lr_recognize(all_of(input)));
+    REQUIRE(!c.ll1_recognize(all_of(input)));
+    return total != 0;
+  };
+  int loaded = 0;
+  for (size_t i = 0; i + 4 <= bytes.size(); i += 4) {
+    for (uint32_t value : {0x7fffffffu, 0xffffffffu, 1000u}) {
+      string corrupt = bytes;
+      memcpy(&corrupt[i], &value, 4);
+      loaded += use(corrupt);
+    }
+  }
+  // The bit set rows and padding don't matter to anything.
+  REQUIRE(loaded > 0);
+
+  stringstream again;
+  write_compiled_grammar(again, g, 1);
+  REQUIRE(again.str() == bytes);
+  string text = "S S + S\nS n\n", changed = "S S + S\nS m\n";
+  REQUIRE(content_hash(text.data(), text.data() + text.size())
+          != content_hash(changed.data(), changed.data() + changed.size()));
+}
+
+// The grammar in one of the files in inputs/.
+grammar input_grammar(const char* path) {
+  mapped_file file(path);
+  REQUIRE(file);
+  return parse_grammar(file.begin(), file.end());
+}
+
+// What the generated parsers take: terminal indices.
+vector<int> indices_of(const grammar& g, const vector<symbol_id>& tokens) {
+  vector<int> indices;
+  for (auto x : tokens) {
+    indices.push_back(g.terminal_index(x));
+  }
+  return indices;
+}
+
+TEST_CASE("Generated parsers agree with the table-driven ones") {
+  auto calc = input_grammar("inputs/calc.cfg");
+  auto arith = input_grammar("inputs/arith.cfg");
+  REQUIRE(calc_rd::terminal_count == calc.terminal_count());
+  REQUIRE(calc_lr::production_count == calc.size());
+  for (int t = 0; t < calc.terminal_count(); ++t) {
+    REQUIRE(calc_lr::terminal_names[t] == calc.name_of(calc.nonterminal_count() + t));
+  }
+  for (int p = 0; p < calc.size(); ++p) {
+    REQUIRE(calc_rd::rule_lhs[p] == int(calc.lhs_id(p)));
+    REQUIRE(calc_rd::rule_length[p] == calc.rhs_size(p));
+  }
+
+  grammar_analysis A(calc);
+  ll1_parser ll1(A);
+  auto augmented = augment(calc);
+  lr0_automaton a(augmented);
+  lr_parser lr(build_lalr_table(calc, a));
+  auto arith_augmented = augment(arith);
+  lr0_automaton arith_a(arith_augmented);
+  lr_parser arith_lr_parser(build_lalr_table(arith, arith_a));
+
+  // Every parser says the same about input, down to the derivation or
+  // where it failed.
+  auto agree = [&](const vector<symbol_id>& input, const vector<int>& indices) {
+    vector<int> expected, derivation;
+    size_t expected_at = 0, error_at = 0;
+    bool ok = ll1.parse(all_of(input), expected, &expected_at);
+    REQUIRE(calc_rd::parse(indices.data(), indices.size(),
+                           [&](int p) { derivation.push_back(p); }, &error_at) == ok);
+    if (ok) { REQUIRE(derivation == expected); }
+    else { REQUIRE(error_at == expected_at); }
+
+    expected.clear();
+    derivation.clear();
+    ok = lr.parse(all_of(input), expected, &expected_at);
+    REQUIRE(calc_lr::parse(indices.data(), indices.size(),
+                           [&](int p) { derivation.push_back(p); }, &error_at) == ok);
+    if (ok) { REQUIRE(derivation == expected); }
+    else { REQUIRE(error_at == expected_at); }
+  };
+
+  auto program = tokens_of(calc, "read id id := ( id * id ) / number write id * ( id / number ) $$");
+  agree(program, indices_of(calc, program));
+  REQUIRE(calc_rd::recognize(indices_of(calc, program).data(), program.size()));
+
+  // Sentences drawn at random, then broken by changing a token.
+  derivation_counter counter(calc, 25);
+  mt19937_64 rng(7);
+  for (int i = 0; i < 200; ++i) {
+    int n = 2 + i % 24;
+    auto derivation = counter.sample(n, rng);
+    if (derivation.empty()) { continue; }
+    stringstream leaves;
+    parse_tree(calc, derivation).print_leaves(leaves);
+    auto input = tokens_of(calc, leaves.str());
+    agree(input, indices_of(calc, input));
+    input[rng() % input.size()] = calc.nonterminal_count() + rng() % calc.terminal_count();
+    agree(input, indices_of(calc, input));
+    input.pop_back();
+    agree(input, indices_of(calc, input));
+  }
+
+  // Anything that isn't a terminal index is an error where it is.
+  auto indices = indices_of(calc, program);
+  indices[3] = -1;
+  size_t error_at = 0;
+  REQUIRE(!calc_rd::recognize(indices.data(), indices.size(), &error_at));
+  REQUIRE(error_at == 3);
+  indices[3] = calc_rd::terminal_count;
+  REQUIRE(!calc_lr::recognize(indices.data(), indices.size(), &error_at));
+  REQUIRE(error_at == 3);
+
+  // Conflicts go the way the table has them.
+  auto sum = tokens_of(arith, "n + n * n - n");
+  vector<int> expected, reductions;
+  REQUIRE(arith_lr_parser.parse(all_of(sum), expected));
+  auto sum_indices = indices_of(arith, sum);
+  REQUIRE(arith_lr::parse(sum_indices.data(), sum_indices.size(),
+                          [&](int p) { reductions.push_back(p); }));
+  REQUIRE(reductions == expected);
+}
+
+TEST_CASE("Taking out left recursion keeps the start symbol and the language") {
+  // Immediate left recursion in E and T, and indirect through A -> B a,
+  // B -> A b.
+  grammar g = {
+    {"S", "E"},
+    {"S", "A"},
+    {"E", "E", "+", "T"},
+    {"E", "T"},
+    {"T", "T", "*", "n"},
+    {"T", "n"},
+    {"A", "B", "a"},
+    {"A", "c"},
+    {"B", "A", "b"},
+    {"B", "d"}
+  };
+  auto g2 = remove_left_recursion(g);
+  REQUIRE(g2.name_of(0) == "S");
+  for (int i = 0; i < g2.size(); ++i) {
+    REQUIRE((g2.rhs_size(i) == 0 || g2.rhs_ids(i)[0] != g2.lhs_id(i)));
+  }
+  // The new nonterminals don't clash with ones already there.
+  grammar primed = {
+    {"E", "E", "+", "n"},
+    {"E", "n"},
+    {"E0", "x"}
+  };
+  auto primed2 = remove_left_recursion(primed);
+  REQUIRE(primed2.nonterminal_count() == 3);
+  REQUIRE(primed2.production_indices(primed2.id_of("E0")).size() == 1);
+
+  // Sentences of g and broken ones, which Earley has to say the same about
+  // with either grammar.
+  earley_parser before(g), after(g2);
+  derivation_counter counter(g, 15);
+  mt19937_64 rng(3);
+  for (int i = 0; i < 200; ++i) {
+    auto derivation = counter.sample(1 + i % 15, rng);
+    if (derivation.empty()) { continue; }
+    stringstream leaves;
+    parse_tree(g, derivation).print_leaves(leaves);
+    auto input = tokens_of(g, leaves.str());
+    if (rng() % 2) {
+      input[rng() % input.size()] = g.nonterminal_count() + rng() % g.terminal_count();
+    }
+    stringstream text;
+    for (auto x : input) { text << g.name_of(x) << " "; }
+    auto input2 = tokens_of(g2, text.str());
+    REQUIRE(after.recognize(all_of(input2)) == before.recognize(all_of(input)));
+  }
+
+  // A nonterminal whose every alternative is left recursive derives
+  // nothing, and still mustn't after: not as the start, and not by turning
+  // into a terminal.
+  grammar only_recursive_start = {
+    {"S", "S", "a"},
+    {"B", "b"}
+  };
+  grammar only_recursive_inner = {
+    {"S", "S", "a"},
+    {"S", "T"},
+    {"T", "T", "b"},
+    {"T", "T"}
+  };
+  for (auto h : {&only_recursive_start, &only_recursive_inner}) {
+    auto h2 = remove_left_recursion(*h);
+    REQUIRE(h2.name_of(0) == "S");
+    REQUIRE(h2.nonterminal_count() >= h->nonterminal_count());
+    for (symbol_id A = 0; A < symbol_id(h->nonterminal_count()); ++A) {
+      REQUIRE(h2.is_nonterminal(h->name_of(A)));
+    }
+    for (int i = 0; i < h2.size(); ++i) {
+      REQUIRE((h2.rhs_size(i) == 0 || h2.rhs_ids(i)[0] != h2.lhs_id(i)));
+    }
+    earley_parser parser(h2);
+    for (auto s : {"", "a", "a a", "b", "b a"}) {
+      auto input = tokens_of(h2, s);
+      REQUIRE(!parser.recognize(all_of(input)));
+    }
+  }
+}
+
+TEST_CASE("Grammars in the corpus accept their samples") {
+  for (auto name : {"ansi_c", "java", "json", "sql"}) {
+    string path = string("inputs/") + name;
+    ifstream cfg1(path + ".cfg1");
+    auto g = cfg1 ? parse_cfg1_file(cfg1) : input_grammar((path + ".cfg").c_str());
+    ifstream in(path + ".in");
+    vector<symbol_id> tokens;
+    REQUIRE(read_tokens(g, in, tokens));
+    auto augmented = augment(g);
+    lr0_automaton a(augmented);
+    lr_parser lr(build_lalr_table(g, a));
+    REQUIRE(lr.recognize(all_of(tokens)));
+  }
+  // The empty productions cfg1 makes for a * are empty.
+  stringstream text("list => item *\n");
+  auto g = parse_cfg1_file(text);
+  REQUIRE(g.size() == 3);
+  REQUIRE(g.rhs_size(g.production_indices(g.id_of("item_star_seq"))[1]) == 0);
+}
@@ -0,0 +1,73 @@
+#include "catch.hpp"
+
+#include <thread>
+#include <vector>
+#include <memory>
+#include <sstream>
+
+#include "stats.h"
+
+// Built with -DCFG_STATS whatever the rest of the build is (see the
+// Makefile). The names are the tests' own, so nothing else touches them.
+
+using namespace std;
+using namespace cfg;
+
+void counted_phase(int allocations) {
+  CFG_PHASE("test.phase");
+  vector<unique_ptr<int>> v;
+  v.reserve(allocations);
+  for (int i = 0; i < allocations; ++i) { v.emplace_back(new int(i)); }
+}
+
+TEST_CASE("Counters add up") {
+  for (int i = 0; i < 3; ++i) { CFG_COUNT("test.count"); }
+  CFG_ADD("test.add", 40);
+  CFG_ADD("test.add", 2);
+  REQUIRE(stats::counter("test.count").load() == 3);
+  REQUIRE(stats::counter("test.add").load() == 42);
+  REQUIRE(stats::counter("test.never").load() == 0);
+
+  // From other threads too.
+  vector<thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([]() {
+      for (int i = 0; i < 1000; ++i) { CFG_COUNT("test.threads"); }
+    });
+  }
+  for (auto& t : threads) { t.join(); }
+  REQUIRE(stats::counter("test.threads").load() == 4000);
+}
+
+TEST_CASE("Phases count their own thread's allocations") {
+  counted_phase(100);
+  counted_phase(50);
+  auto& t = stats::totals("test.phase");
+  REQUIRE(t.calls.load() == 2);
+  // The ints and the two vectors.
+  REQUIRE(t.allocations.load() == 152);
+  REQUIRE(t.allocated_bytes.load() >= 150 * sizeof(int) + 150 * sizeof(unique_ptr<int>));
+
+  // Another thread allocating all through a phase doesn't count in it.
+  {
+    CFG_PHASE("test.quiet");
+    thread busy(counted_phase, 10000);
+    busy.join();
+  }
+  REQUIRE(stats::totals("test.phase").allocations.load() == 152 + 10001);
+  REQUIRE(stats::totals("test.quiet").allocations.load() < 100);
+}
+
+TEST_CASE("Stats come out as JSON") {
+  CFG_ADD("test.json \"quoted\"", 7);
+  { CFG_PHASE("test.json_phase"); }
+  stringstream out;
+  stats::write_json(out);
+  auto json = out.str();
+  REQUIRE(json.find("{\"counters\": {") == 0);
+  REQUIRE(json.find("\n  \"test.json \\\"quoted\\\"\": 7") != string::npos);
+  REQUIRE(json.find("\n \"phases\": {") != string::npos);
+  REQUIRE(json.find("\n  \"test.json_phase\": {\"calls\": 1, \"ms\": ") != string::npos);
+  REQUIRE(json.find("\"allocations\": 0, \"allocated_bytes\": 0}") != string::npos);
+  REQUIRE(json.substr(json.size() - 3) == "}}\n");
+}